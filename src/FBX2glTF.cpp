@@ -9,6 +9,7 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <unordered_map>
 #include <vector>
 
@@ -17,8 +18,10 @@
 #include "FBX2glTF.h"
 #include "fbx/Fbx2Raw.hpp"
 #include "gltf/Raw2Gltf.hpp"
+#include "utils/Archive_Writer.hpp"
 #include "utils/File_Utils.hpp"
 #include "utils/String_Utils.hpp"
+#include "utils/Texture_Cache.hpp"
 
 bool verboseOutput = false;
 
@@ -57,6 +60,40 @@ int main(int argc, char* argv[]) {
 
   app.add_flag("-b,--binary", gltfOptions.outputBinary, "Output a single binary format .glb file.");
 
+  app.add_option(
+         "--archive",
+         [&](std::vector<std::string> choices) -> bool {
+           for (const std::string choice : choices) {
+             if (choice == "zip") {
+               gltfOptions.archiveOutput = ArchiveOutputOptions::ZIP;
+             } else if (choice == "tar") {
+               gltfOptions.archiveOutput = ArchiveOutputOptions::TAR;
+             } else {
+               fmt::printf("Unknown --archive: %s\n", choice);
+               throw CLI::RuntimeError(1);
+             }
+           }
+           return true;
+         },
+         "Write the .gltf, its buffer and textures straight into one archive; '-o -' for stdout.")
+      ->type_name("(zip|tar)");
+
+  app.add_option(
+      "--shared-assets",
+      gltfOptions.sharedAssetsDir,
+      "Write images into this folder named by their content hash, skipping any already there, "
+      "and reference them relative to the .gltf; lets many models share one copy.");
+
+  app.add_flag(
+      "--shared-buffers",
+      gltfOptions.sharedBuffers,
+      "Write the .bin buffer into the --shared-assets folder by content hash as well.");
+
+  app.add_flag(
+      "--coalesce-buffer-views",
+      gltfOptions.coalesceBufferViews,
+      "Share one buffer view between all vertex attributes, and one between all indices.");
+
   app.add_option(
          "--long-indices",
          [&](std::vector<std::string> choices) -> bool {
@@ -77,6 +114,23 @@ int main(int argc, char* argv[]) {
          "Whether to use 32-bit indices.")
       ->type_name("(never|auto|always)");
 
+  app.add_option(
+         "--transparent-sort-views",
+         [&](std::vector<std::string> choices) -> bool {
+           for (const std::string choice : choices) {
+             if (choice == "0" || choice == "6" || choice == "14" || choice == "26") {
+               gltfOptions.transparentSortViews = std::stoi(choice);
+             } else {
+               fmt::printf("Unknown --transparent-sort-views: %s\n", choice);
+               throw CLI::RuntimeError(1);
+             }
+           }
+           return true;
+         },
+         "Also store the triangles of transparent primitives sorted back to front for this many "
+         "view directions: the axes, then the cube corners, then the cube edges.")
+      ->type_name("(0|6|14|26)");
+
   app.add_option(
          "--compute-normals",
          [&](std::vector<std::string> choices) -> bool {
@@ -119,6 +173,54 @@ int main(int argc, char* argv[]) {
          "Select baked animation framerate.")
       ->type_name("(bake24|bake30|bake60)");
 
+  app.add_option(
+         "--anim-rotations",
+         [&](std::vector<std::string> choices) -> bool {
+           for (const std::string choice : choices) {
+             if (choice == "float") {
+               gltfOptions.animationRotationPrecision = AnimationPrecisionOptions::FLOAT;
+             } else if (choice == "short") {
+               gltfOptions.animationRotationPrecision = AnimationPrecisionOptions::SHORT;
+             } else if (choice == "byte") {
+               gltfOptions.animationRotationPrecision = AnimationPrecisionOptions::BYTE;
+             } else {
+               fmt::printf("Unknown --anim-rotations: %s\n", choice);
+               throw CLI::RuntimeError(1);
+             }
+           }
+           return true;
+         },
+         "Write animated rotations as floats, or as normalized 16-bit or 8-bit integers.")
+      ->type_name("(float|short|byte)");
+
+  app.add_option(
+         "--anim-weights",
+         [&](std::vector<std::string> choices) -> bool {
+           for (const std::string choice : choices) {
+             if (choice == "float") {
+               gltfOptions.animationWeightPrecision = AnimationPrecisionOptions::FLOAT;
+             } else if (choice == "short") {
+               gltfOptions.animationWeightPrecision = AnimationPrecisionOptions::SHORT;
+             } else if (choice == "byte") {
+               gltfOptions.animationWeightPrecision = AnimationPrecisionOptions::BYTE;
+             } else {
+               fmt::printf("Unknown --anim-weights: %s\n", choice);
+               throw CLI::RuntimeError(1);
+             }
+           }
+           return true;
+         },
+         "Write animated blend shape weights as floats, or as normalized unsigned 16-bit or 8-bit "
+         "integers.")
+      ->type_name("(float|short|byte)");
+
+  app.add_option(
+         "--anim-bake-jobs",
+         gltfOptions.animationBakeJobs,
+         "Bake animation stacks in this many forked worker processes (Linux only).",
+         true)
+      ->check(CLI::Range(1, 256));
+
   const auto opt_flip_u = app.add_flag("--flip-u", "Flip all U texture coordinates.");
   const auto opt_no_flip_u = app.add_flag("--no-flip-u", "Don't flip U texture coordinates.");
   const auto opt_flip_v = app.add_flag("--flip-v", "Flip all V texture coordinates.");
@@ -161,6 +263,11 @@ int main(int argc, char* argv[]) {
       gltfOptions.useBlendShapeTangents,
       "Include blend shape tangents, if reported present by the FBX SDK.");
 
+  app.add_flag(
+      "--blend-shape-bake-static",
+      gltfOptions.bakeStaticBlendShapes,
+      "Fold blend shapes that are never animated into the base mesh at their default weight.");
+
   app.add_option(
       "--normalize-weights",
       gltfOptions.normalizeSkinningWeights,
@@ -174,6 +281,245 @@ int main(int argc, char* argv[]) {
          true)
       ->check(CLI::Range(0, 512));
 
+  app.add_flag(
+      "--unskin-rigid-meshes",
+      gltfOptions.unskinRigidMeshes,
+      "Convert meshes skinned entirely to one joint into static meshes parented to that joint.");
+
+  app.add_option(
+         "--include-nodes",
+         [&](std::vector<std::string> patterns) -> bool {
+           gltfOptions.includeNodes.insert(
+               gltfOptions.includeNodes.end(), patterns.begin(), patterns.end());
+           return true;
+         },
+         "Export only the nodes at these paths, e.g. \"/Vehicles/Truck*\", and everything below "
+         "them. Paths start at the scene root; '*' and '?' match within one path segment.")
+      ->type_name("PATH")
+      ->group("Selection");
+
+  app.add_option(
+         "--exclude-nodes",
+         [&](std::vector<std::string> patterns) -> bool {
+           gltfOptions.excludeNodes.insert(
+               gltfOptions.excludeNodes.end(), patterns.begin(), patterns.end());
+           return true;
+         },
+         "Leave out the nodes at these paths, and everything below them.")
+      ->type_name("PATH")
+      ->group("Selection");
+
+  app.add_option(
+         "--tessellation-tolerance",
+         gltfOptions.tessellationTolerance,
+         "Tessellate NURBS and patch surfaces finely enough to stay within this many metres of "
+         "them; 0 leaves it to the FBX SDK.",
+         true)
+      ->check(CLI::Range(0.0f, 1e6f))
+      ->group("Tessellation");
+
+  app.add_option(
+         "--tessellation-max-edge",
+         gltfOptions.tessellationMaxEdge,
+         "Tessellate NURBS and patch surfaces into edges no longer than this, in metres.",
+         true)
+      ->check(CLI::Range(0.0f, 1e6f))
+      ->group("Tessellation");
+
+  app.add_option(
+         "--tessellation-max-triangles",
+         gltfOptions.tessellationMaxTriangles,
+         "Tessellate no NURBS or patch surface into more triangles than this, whatever the other "
+         "limits ask for.",
+         true)
+      ->check(CLI::Range(0, 100000000))
+      ->group("Tessellation");
+
+  app.add_option(
+         "--collision",
+         [&](std::vector<std::string> choices) -> bool {
+           for (const std::string choice : choices) {
+             if (choice == "none") {
+               gltfOptions.collision.shape = CollisionShapeOption::NONE;
+             } else if (choice == "hull") {
+               gltfOptions.collision.shape = CollisionShapeOption::CONVEX_HULL;
+             } else if (choice == "decomposition") {
+               gltfOptions.collision.shape = CollisionShapeOption::CONVEX_DECOMPOSITION;
+             } else if (choice == "mesh") {
+               gltfOptions.collision.shape = CollisionShapeOption::TRIANGLE_MESH;
+             } else {
+               fmt::printf("Unknown --collision shape: %s\n", choice);
+               throw CLI::RuntimeError(1);
+             }
+           }
+           return true;
+         },
+         "Collision shape for meshes whose nodes' 'collision' user property doesn't choose one.")
+      ->type_name("(none|hull|decomposition|mesh)")
+      ->group("Collision");
+
+  app.add_flag(
+         "--collision-per-subtree",
+         gltfOptions.collision.perSubtree,
+         "Merge each top-level subtree, or one with a 'collision' property, into a single shape.")
+      ->group("Collision");
+
+  app.add_option(
+         "--collision-hull-vertices",
+         gltfOptions.collision.maxHullVertices,
+         "The most vertices a convex hull may have.",
+         true)
+      ->check(CLI::Range(4, 4096))
+      ->group("Collision");
+
+  app.add_option(
+         "--collision-max-hulls",
+         gltfOptions.collision.maxHulls,
+         "The most convex hulls a decomposition may use.",
+         true)
+      ->check(CLI::Range(1, 256))
+      ->group("Collision");
+
+  app.add_option(
+         "--collision-concavity",
+         gltfOptions.collision.concavity,
+         "Keep splitting a decomposition while a split shrinks a hull by more than this fraction.",
+         true)
+      ->check(CLI::Range(0.0f, 1.0f))
+      ->group("Collision");
+
+  app.add_option(
+         "--collision-mesh-resolution",
+         gltfOptions.collision.meshResolution,
+         "Simplify collision meshes on a grid of this many cells along their longest side.",
+         true)
+      ->check(CLI::Range(1, 1024))
+      ->group("Collision");
+
+  app.add_flag(
+         "--node-bounds",
+         gltfOptions.nodeBounds,
+         "Write world- and local-space boxes and spheres around each node's subtree, over every "
+         "animation frame, into the node's extras.")
+      ->group("Visibility");
+
+  app.add_flag(
+         "--occluders",
+         gltfOptions.generateOccluders,
+         "Build box occluders inside large, closed, static meshes, for software occlusion culling.")
+      ->group("Visibility");
+
+  app.add_option(
+         "--occluder-min-size",
+         gltfOptions.occluderMinSize,
+         "Only meshes at least this big across, in metres, get an occluder.",
+         true)
+      ->check(CLI::Range(0.0f, 1e6f))
+      ->group("Visibility");
+
+  app.add_option(
+         "--occluder-triangles",
+         gltfOptions.occluderTriangles,
+         "The most triangles an occluder may have; each box takes twelve.",
+         true)
+      ->check(CLI::Range(12, 1200))
+      ->group("Visibility");
+
+  app.add_flag(
+         "--impostors",
+         gltfOptions.bakeImpostors,
+         "Render large static meshes from all around into octahedral impostor atlases, and add a "
+         "textured quad as the last MSFT_lod level of their nodes.")
+      ->group("Visibility");
+
+  app.add_option(
+         "--impostor-min-size",
+         gltfOptions.impostorMinSize,
+         "Only meshes at least this big across, in metres, get an impostor.",
+         true)
+      ->check(CLI::Range(0.0f, 1e6f))
+      ->group("Visibility");
+
+  app.add_option(
+         "--impostor-frames",
+         gltfOptions.impostorFrames,
+         "The number of views along each side of an impostor atlas.",
+         true)
+      ->check(CLI::Range(2, 32))
+      ->group("Visibility");
+
+  app.add_option(
+         "--impostor-frame-size",
+         gltfOptions.impostorFrameSize,
+         "The size, in pixels, of each view in an impostor atlas.",
+         true)
+      ->check(CLI::Range(16, 2048))
+      ->group("Visibility");
+
+  app.add_option(
+         "--prune-size",
+         gltfOptions.pruneSize,
+         "Remove static meshes whose bounding box diagonal is shorter than this, in metres.",
+         true)
+      ->check(CLI::Range(0.0f, 1e6f))
+      ->group("Visibility");
+
+  app.add_option(
+         "--prune-angle",
+         gltfOptions.pruneAngle,
+         "Remove static meshes that span less than this many degrees seen from --prune-distance.",
+         true)
+      ->check(CLI::Range(0.0f, 180.0f))
+      ->group("Visibility");
+
+  app.add_option(
+         "--prune-distance",
+         gltfOptions.pruneDistance,
+         "The viewing distance, in metres, that --prune-angle is measured at.",
+         true)
+      ->check(CLI::Range(0.001f, 1e6f))
+      ->group("Visibility");
+
+  app.add_flag(
+         "--remove-hidden-surfaces",
+         gltfOptions.removeHiddenSurfaces,
+         "Remove static triangles that can't be seen from any of the visibility viewpoints.")
+      ->group("Visibility");
+
+  app.add_option(
+         "--visibility-viewpoints",
+         [&](std::vector<std::string> values) -> bool {
+           if (values.size() % 3 != 0) {
+             fmt::printf("--visibility-viewpoints takes x, y and z for each viewpoint.\n");
+             throw CLI::RuntimeError(1);
+           }
+           for (size_t ii = 0; ii < values.size(); ii += 3) {
+             gltfOptions.visibilityViewpoints.emplace_back(
+                 std::stof(values[ii]), std::stof(values[ii + 1]), std::stof(values[ii + 2]));
+           }
+           return true;
+         },
+         "World-space points, in metres, to look for hidden surfaces from; replaces the sphere.")
+      ->type_size(-1)
+      ->type_name("X Y Z ...")
+      ->group("Visibility");
+
+  app.add_option(
+         "--visibility-sphere-viewpoints",
+         gltfOptions.visibilitySphereViewpoints,
+         "How many viewpoints to spread over a sphere around the scene.",
+         true)
+      ->check(CLI::Range(1, 4096))
+      ->group("Visibility");
+
+  app.add_option(
+         "--visibility-threshold",
+         gltfOptions.visibilityThreshold,
+         "Remove triangles seen by no more than this fraction of the rays cast at them.",
+         true)
+      ->check(CLI::Range(0.0f, 1.0f))
+      ->group("Visibility");
+
   app.add_option(
          "-k,--keep-attribute",
          [&](std::vector<std::string> attributes) -> bool {
@@ -263,6 +609,61 @@ int main(int argc, char* argv[]) {
          "--fbx-temp-dir", gltfOptions.fbxTempDir, "Temporary directory to be used by FBX SDK.")
       ->check(CLI::ExistingDirectory);
 
+  app.add_option(
+         "--texture-cache",
+         gltfOptions.textureCacheDir,
+         "Folder to cache processed textures in, for reuse across conversions.")
+      ->group("Textures");
+
+  app.add_option(
+         "--texture-cache-size",
+         gltfOptions.textureCacheMaxMB,
+         "Megabytes the texture cache may grow to before evicting old entries.",
+         true)
+      ->check(CLI::Range(1, 1 << 20))
+      ->group("Textures");
+
+  app.add_flag(
+         "--optimize-png",
+         gltfOptions.optimizePngs,
+         "Losslessly re-encode copied and merged PNG textures as compactly as possible.")
+      ->group("Textures");
+
+  app.add_flag(
+         "--fold-uniform-textures",
+         gltfOptions.foldUniformTextures,
+         "Replace textures that are a single colour throughout with material factors.")
+      ->group("Textures");
+
+  app.add_option(
+         "--uniform-texture-tolerance",
+         gltfOptions.uniformTextureTolerance,
+         "How much, in 8-bit steps, pixels may differ in a texture that's folded into a factor.",
+         true)
+      ->check(CLI::Range(0, 255))
+      ->group("Textures");
+
+  app.add_flag(
+         "--crop-textures",
+         gltfOptions.cropTextures,
+         "Crop textures to the region that their meshes' UVs cover, remapping the UVs to match.")
+      ->group("Textures");
+
+  app.add_option(
+         "--crop-texture-padding",
+         gltfOptions.cropTexturePadding,
+         "Texels of margin to keep around the used region of a cropped texture.",
+         true)
+      ->check(CLI::Range(0, 1024))
+      ->group("Textures");
+
+  app.add_option(
+         "--texel-density",
+         gltfOptions.texelDensity,
+         "Downsample textures with more texels per metre of surface than this; report outliers.")
+      ->check(CLI::Range(0.0f, 1e6f))
+      ->group("Textures");
+
   CLI11_PARSE(app, argc, argv);
 
   bool do_flip_u = false;
@@ -307,9 +708,14 @@ int main(int argc, char* argv[]) {
     fmt::printf("Note: Ignoring --embed; it's meaningless with --binary.\n");
   }
 
+  // the basename of the .fbx, or for a compressed model.fbx.gz, that of the .fbx within
+  std::string inputBase = FileUtils::GetFileBase(inputPath);
+  if (StringUtils::ToLower(FileUtils::GetFileSuffix(inputBase).value_or("")) == "fbx") {
+    inputBase = FileUtils::GetFileBase(inputBase);
+  }
   if (outputPath.empty()) {
     // if -o is not given, default to the basename of the .fbx
-    outputPath = "./" + FileUtils::GetFileBase(inputPath);
+    outputPath = "./" + inputBase;
   }
   // the output folder in .gltf mode, not used for .glb
   std::string outputFolder;
@@ -323,7 +729,32 @@ int main(int argc, char* argv[]) {
     gltfOptions.outputBinary = true;
   }
 
-  if (gltfOptions.outputBinary) {
+  if (gltfOptions.archiveOutput != ArchiveOutputOptions::NONE && gltfOptions.outputBinary) {
+    fmt::printf("Note: Ignoring --archive; it's meaningless with --binary.\n");
+    gltfOptions.archiveOutput = ArchiveOutputOptions::NONE;
+  }
+
+  // with --archive, the .gltf and everything it references go into a single archive file
+  std::string archivePath;
+  std::string archiveModelName;
+  if (gltfOptions.archiveOutput != ArchiveOutputOptions::NONE) {
+    const std::string archiveSuffix =
+        (gltfOptions.archiveOutput == ArchiveOutputOptions::ZIP) ? "zip" : "tar";
+    if (outputPath == "-") {
+      archivePath = outputPath;
+      archiveModelName = inputBase + ".gltf";
+    } else {
+      // add the archive suffix to output path, unless it already ends in exactly that
+      archivePath = (suffix.has_value() && suffix.value() == archiveSuffix)
+          ? outputPath
+          : outputPath + "." + archiveSuffix;
+      archiveModelName = FileUtils::GetFileBase(archivePath) + ".gltf";
+      if (!FileUtils::CreatePath(archivePath.c_str())) {
+        fmt::fprintf(stderr, "ERROR: Failed to create folder for: %s'\n", archivePath.c_str());
+        return 1;
+      }
+    }
+  } else if (gltfOptions.outputBinary) {
     // add .glb to output path, unless it already ends in exactly that
     outputFolder = FileUtils::getFolder(outputPath) + "/";
     if (suffix.has_value() && suffix.value() == "glb") {
@@ -340,11 +771,52 @@ int main(int argc, char* argv[]) {
     outputFolder = fmt::format("{}_out/", outputPath.c_str());
     modelPath = outputFolder + FileUtils::GetFileName(outputPath) + ".gltf";
   }
-  if (!FileUtils::CreatePath(modelPath.c_str())) {
+  if (archivePath.empty() && !FileUtils::CreatePath(modelPath.c_str())) {
     fmt::fprintf(stderr, "ERROR: Failed to create folder: %s'\n", outputFolder.c_str());
     return 1;
   }
 
+  if (!gltfOptions.sharedAssetsDir.empty() &&
+      (!archivePath.empty() || gltfOptions.embedResources)) {
+    fmt::printf("Note: Ignoring --shared-assets; it's meaningless with --archive or --embed.\n");
+    gltfOptions.sharedAssetsDir.clear();
+  }
+  if (gltfOptions.sharedBuffers && gltfOptions.sharedAssetsDir.empty()) {
+    fmt::printf("Note: Ignoring --shared-buffers; it needs --shared-assets.\n");
+    gltfOptions.sharedBuffers = false;
+  }
+  if (!gltfOptions.sharedAssetsDir.empty() &&
+      !FileUtils::FolderExists(gltfOptions.sharedAssetsDir) &&
+      !FileUtils::MakeDir(gltfOptions.sharedAssetsDir)) {
+    fmt::fprintf(
+        stderr, "ERROR: Failed to create folder: %s\n", gltfOptions.sharedAssetsDir.c_str());
+    return 1;
+  }
+
+  // open any archive before we print anything else, in case it takes over stdout
+  std::unique_ptr<ArchiveWriter> archive;
+  if (!archivePath.empty()) {
+    archive.reset(new ArchiveWriter(
+        (gltfOptions.archiveOutput == ArchiveOutputOptions::ZIP) ? ArchiveWriter::ZIP
+                                                                 : ArchiveWriter::TAR,
+        archivePath));
+    if (!archive->IsOpen()) {
+      fmt::fprintf(stderr, "ERROR:: Couldn't open archive for writing: %s\n", archivePath);
+      return 1;
+    }
+  }
+
+  // report on and trim the texture cache however we leave
+  struct TextureCacheScope {
+    ~TextureCacheScope() {
+      TextureCache::Shutdown();
+    }
+  } textureCacheScope;
+  if (!gltfOptions.textureCacheDir.empty()) {
+    TextureCache::Configure(
+        gltfOptions.textureCacheDir, (uint64_t)gltfOptions.textureCacheMaxMB * 1024 * 1024);
+  }
+
   ModelData* data_render_model = nullptr;
   RawModel raw;
 
@@ -359,8 +831,147 @@ int main(int argc, char* argv[]) {
   if (!texturesTransforms.empty()) {
     raw.TransformTextures(texturesTransforms);
   }
+  if (gltfOptions.foldUniformTextures) {
+    const int foldedCount = raw.FoldUniformTextures(gltfOptions.uniformTextureTolerance / 255.0f);
+    if (verboseOutput) {
+      fmt::printf(
+          "Folded %d single-colour texture references into material factors.\n", foldedCount);
+    }
+  }
   raw.Condense(gltfOptions.maxSkinningWeights, gltfOptions.normalizeSkinningWeights);
+  if (gltfOptions.unskinRigidMeshes) {
+    const int unskinnedCount = raw.UnskinRigidSurfaces();
+    if (verboseOutput) {
+      fmt::printf("Converted %d rigidly skinned meshes to static meshes.\n", unskinnedCount);
+    }
+  }
+  if (gltfOptions.bakeStaticBlendShapes) {
+    const int bakedCount = raw.BakeStaticBlendChannels();
+    if (verboseOutput) {
+      fmt::printf("Baked %d unanimated blend shapes into base meshes.\n", bakedCount);
+    }
+  }
   raw.TransformGeometry(gltfOptions.computeNormals);
+  if (gltfOptions.pruneSize > 0.0f || gltfOptions.pruneAngle > 0.0f) {
+    const RawPruneReport report = raw.PruneSmallDetails(
+        gltfOptions.pruneSize,
+        gltfOptions.pruneAngle * (float)M_PI / 180.0f,
+        gltfOptions.pruneDistance);
+    if (verboseOutput) {
+      if (gltfOptions.pruneSize > 0.0f) {
+        fmt::printf(
+            "Pruned %d meshes (%lu triangles) smaller than %g m.\n",
+            report.nodesBySize,
+            report.trianglesBySize,
+            gltfOptions.pruneSize);
+      }
+      if (gltfOptions.pruneAngle > 0.0f) {
+        fmt::printf(
+            "Pruned %d meshes (%lu triangles) spanning less than %g degrees at %g m.\n",
+            report.nodesByAngle,
+            report.trianglesByAngle,
+            gltfOptions.pruneAngle,
+            gltfOptions.pruneDistance);
+      }
+      if (report.nodesDeleted > 0) {
+        fmt::printf("Deleted %d nodes left empty by pruning.\n", report.nodesDeleted);
+      }
+    }
+  }
+  // nodes can ask for collision shapes through user properties, even if no default is set
+  const int collisionShapeCount = raw.GenerateCollisionShapes(gltfOptions.collision);
+  if (verboseOutput && collisionShapeCount > 0) {
+    fmt::printf("Generated %d collision shapes.\n", collisionShapeCount);
+  }
+  if (gltfOptions.generateOccluders) {
+    const int occluderCount =
+        raw.GenerateOccluders(gltfOptions.occluderMinSize, gltfOptions.occluderTriangles);
+    if (verboseOutput) {
+      fmt::printf("Generated %d occluders.\n", occluderCount);
+    }
+  }
+  if (gltfOptions.removeHiddenSurfaces) {
+    const int removedCount = raw.RemoveHiddenTriangles(
+        gltfOptions.visibilityViewpoints,
+        gltfOptions.visibilitySphereViewpoints,
+        gltfOptions.visibilityThreshold);
+    if (verboseOutput) {
+      fmt::printf("Removed %d hidden triangles.\n", removedCount);
+    }
+  }
+
+  // cropped and resized textures are written to a scratch folder that's removed however we leave
+  struct ScratchFolderScope {
+    std::string path;
+    ~ScratchFolderScope() {
+      boost::system::error_code ec;
+      if (!path.empty()) {
+        boost::filesystem::remove_all(path, ec);
+      }
+    }
+  } textureScratchFolder;
+  if (gltfOptions.cropTextures || gltfOptions.texelDensity > 0 || gltfOptions.bakeImpostors) {
+    boost::system::error_code ec;
+    const boost::filesystem::path folder = boost::filesystem::temp_directory_path(ec) /
+        boost::filesystem::unique_path("fbx2gltf-textures-%%%%-%%%%-%%%%");
+    if (!ec && boost::filesystem::create_directories(folder, ec)) {
+      textureScratchFolder.path = folder.string();
+    } else {
+      fmt::printf("Warning: Couldn't create a scratch folder for processed textures.\n");
+    }
+  }
+  if (gltfOptions.cropTextures && !textureScratchFolder.path.empty()) {
+    const int croppedCount =
+        raw.CropTexturesToUvs(textureScratchFolder.path, gltfOptions.cropTexturePadding);
+    if (verboseOutput) {
+      fmt::printf("Cropped %d textures to the regions their UVs cover.\n", croppedCount);
+    }
+  }
+  if (gltfOptions.texelDensity > 0 && !textureScratchFolder.path.empty()) {
+    const int resizedCount =
+        raw.ResizeTexturesToDensity(textureScratchFolder.path, gltfOptions.texelDensity);
+    if (verboseOutput) {
+      fmt::printf(
+          "Downsampled %d textures to about %g texels per metre.\n",
+          resizedCount,
+          gltfOptions.texelDensity);
+    }
+  }
+  if (gltfOptions.bakeImpostors && !textureScratchFolder.path.empty()) {
+    const int bakedCount = raw.BakeImpostors(
+        textureScratchFolder.path,
+        gltfOptions.impostorMinSize,
+        gltfOptions.impostorFrames,
+        gltfOptions.impostorFrameSize);
+    if (verboseOutput) {
+      fmt::printf("Baked impostors for %d meshes.\n", bakedCount);
+    }
+  }
+
+  if (archive) {
+    // textures are added as they're encountered; the JSON and its buffer come last
+    std::ostringstream jsonStream;
+    data_render_model = Raw2Gltf(jsonStream, "", raw, gltfOptions, archive.get());
+    if (data_render_model == nullptr) {
+      return 1;
+    }
+    const std::string jsonText = jsonStream.str();
+    archive->AddFile(archiveModelName, std::vector<uint8_t>(jsonText.begin(), jsonText.end()));
+    if (!gltfOptions.embedResources && !data_render_model->binary->empty()) {
+      archive->AddFile(extBufferFilename, std::vector<uint8_t>(*data_render_model->binary));
+    }
+    delete data_render_model;
+
+    if (!archive->Close()) {
+      fmt::fprintf(stderr, "ERROR:: Failed to write archive: %s\n", archivePath);
+      return 1;
+    }
+    fmt::printf(
+        "Wrote %lu bytes of glTF archive to %s.\n",
+        (unsigned long)archive->GetBytesWritten(),
+        archivePath);
+    return 0;
+  }
 
   std::ofstream outStream; // note: auto-flushes in destructor
   const auto streamStart = outStream.tellp();
@@ -371,6 +982,9 @@ int main(int argc, char* argv[]) {
     return 1;
   }
   data_render_model = Raw2Gltf(outStream, outputFolder, raw, gltfOptions);
+  if (data_render_model == nullptr) {
+    return 1;
+  }
 
   if (gltfOptions.outputBinary) {
     fmt::printf(
@@ -394,24 +1008,12 @@ int main(int argc, char* argv[]) {
 
   assert(!outputFolder.empty());
 
-  const std::string binaryPath = outputFolder + extBufferFilename;
-  FILE* fp = fopen(binaryPath.c_str(), "wb");
-  if (fp == nullptr) {
-    fmt::fprintf(stderr, "ERROR:: Couldn't open file '%s' for writing.\n", binaryPath);
-    return 1;
-  }
-
-  if (data_render_model->binary->empty() == false) {
-    const unsigned char* binaryData = &(*data_render_model->binary)[0];
-    unsigned long binarySize = data_render_model->binary->size();
-    if (fwrite(binaryData, binarySize, 1, fp) != 1) {
-      fmt::fprintf(
-          stderr, "ERROR: Failed to write %lu bytes to file '%s'.\n", binarySize, binaryPath);
-      fclose(fp);
-      return 1;
-    }
-    fclose(fp);
-    fmt::printf("Wrote %lu bytes of binary data to %s.\n", binarySize, binaryPath);
+  // the binary data was streamed to disk while the model was being built
+  if (data_render_model->streamedBinaryBytes > 0) {
+    fmt::printf(
+        "Wrote %lu bytes of binary data to %s.\n",
+        (unsigned long)data_render_model->streamedBinaryBytes,
+        outputFolder + extBufferFilename);
   }
 
   delete data_render_model;
@@ -10,6 +10,7 @@
 
 #include <climits>
 #include <string>
+#include <vector>
 
 #if defined(_WIN32)
 // Tell Windows not to define min() and max() macros
@@ -68,12 +69,47 @@ enum class UseLongIndicesOptions {
   ALWAYS, // only ever use 32-bit indices
 };
 
+enum class ArchiveOutputOptions {
+  NONE, // write .gltf output as loose files in a folder
+  ZIP, // write the .gltf and everything it references into a zip archive
+  TAR, // write the .gltf and everything it references into a tar archive
+};
+
 enum class AnimationFramerateOptions {
   BAKE24, // bake animations at 24 fps
   BAKE30, // bake animations at 30 fps
   BAKE60, // bake animations at 60 fps
 };
 
+enum class AnimationPrecisionOptions {
+  FLOAT, // write animation outputs as 32-bit floats
+  SHORT, // write them as normalized 16-bit integers
+  BYTE, // write them as normalized 8-bit integers
+};
+
+enum class CollisionShapeOption {
+  NONE, // no collision shape
+  CONVEX_HULL, // one convex hull
+  CONVEX_DECOMPOSITION, // a handful of convex hulls that together follow a concave shape
+  TRIANGLE_MESH, // a simplified copy of the triangles
+};
+
+/** How to build the collision shapes that are written out beside the render meshes. */
+struct CollisionOptions {
+  /** The shape for nodes whose 'collision' user property (or their ancestors') doesn't say. */
+  CollisionShapeOption shape = CollisionShapeOption::NONE;
+  /** Whether to merge each subtree into one shape, rather than give each mesh its own. */
+  bool perSubtree = false;
+  /** The most vertices any one convex hull may have. */
+  int maxHullVertices = 64;
+  /** The most hulls a convex decomposition may use. */
+  int maxHulls = 8;
+  /** Pieces are split further only if that shrinks their hull volume by more than this fraction. */
+  float concavity = 0.05f;
+  /** Triangle meshes are simplified on a grid of this many cells along their longest side. */
+  int meshResolution = 32;
+};
+
 /**
  * User-supplied options that dictate the nature of the glTF being generated.
  */
@@ -92,6 +128,16 @@ struct GltfOptions {
 
   bool separateTextures{true};
 
+  /**
+   * Whether to pack all vertex attributes into a single ARRAY_BUFFER buffer view, all indices
+   * into a single ELEMENT_ARRAY_BUFFER view, and all other plain accessors into one more view,
+   * rather than giving every accessor a buffer view of its own.
+   */
+  bool coalesceBufferViews{false};
+
+  /** Whether to stream all non-binary output into a single archive, rather than a folder. */
+  ArchiveOutputOptions archiveOutput = ArchiveOutputOptions::NONE;
+
   /** Whether and how to use KHR_draco_mesh_compression to minimize static geometry size. */
   struct {
     bool enabled = false;
@@ -103,6 +149,9 @@ struct GltfOptions {
     int quantBitsGeneric = 8;
   } draco;
 
+  /** Whether to write the bounds of each node's subtree, over all animation, into its extras. */
+  bool nodeBounds{false};
+
   /** Whether to include FBX User Properties as 'extras' metadata in glTF nodes. */
   bool enableUserProperties{true};
 
@@ -120,17 +169,91 @@ struct GltfOptions {
   bool useBlendShapeNormals{false};
   /** Whether to include blend shape tangents, if present according to the SDK. */
   bool useBlendShapeTangents{false};
+  /** Whether to fold blend shapes that no animation drives into the base mesh. */
+  bool bakeStaticBlendShapes{false};
+  /** Node path patterns to export, with their subtrees; all nodes if empty. */
+  std::vector<std::string> includeNodes;
+  /** Node path patterns to leave out, with their subtrees. */
+  std::vector<std::string> excludeNodes;
+  /** How far (metres) tessellated NURBS and patch surfaces may stray from the true surface. */
+  float tessellationTolerance{0.0f};
+  /** The longest edge (metres) tessellated NURBS and patch surfaces may have. */
+  float tessellationMaxEdge{0.0f};
+  /** The most triangles any one NURBS or patch surface may be tessellated into. */
+  int tessellationMaxTriangles{0};
   /** Whether to normalized skinning weights. */
   bool normalizeSkinningWeights{true};
   /** Maximum number of bone influences per vertex. */
   int maxSkinningWeights{8};
+  /** Whether to turn meshes rigidly skinned to a single joint into static children of it. */
+  bool unskinRigidMeshes{false};
+  /** Collision shapes to generate, emitted as unreferenced meshes named in node extras. */
+  CollisionOptions collision;
+  /** Whether to build conservative box occluders for large, closed, static meshes. */
+  bool generateOccluders{false};
+  /** Meshes whose bounding box diagonal is shorter than this (metres) get no occluder. */
+  float occluderMinSize{2.0f};
+  /** The most triangles (twelve per box) an occluder may have. */
+  int occluderTriangles{12};
+  /** Whether to bake octahedral impostors to stand in for large static meshes far away. */
+  bool bakeImpostors{false};
+  /** Meshes whose bounding box diagonal is shorter than this (metres) get no impostor. */
+  float impostorMinSize{10.0f};
+  /** The number of views along each side of the impostor atlas. */
+  int impostorFrames{8};
+  /** The width and height, in pixels, of each impostor view. */
+  int impostorFrameSize{128};
+  /** Meshes whose world-space bounding box diagonal is shorter than this (metres) are pruned. */
+  float pruneSize{0.0f};
+  /** Meshes that subtend less than this angle (degrees) at the prune distance are pruned. */
+  float pruneAngle{0.0f};
+  /** The viewing distance (metres) for the prune angle. */
+  float pruneDistance{10.0f};
+  /** Whether to remove static triangles that can't be seen from outside (or the viewpoints). */
+  bool removeHiddenSurfaces{false};
+  /** World-space points to look for hidden surfaces from; if empty, a sphere around the scene. */
+  std::vector<Vec3f> visibilityViewpoints;
+  /** How many points on that sphere to look from. */
+  int visibilitySphereViewpoints{64};
+  /** Triangles seen by no more than this fraction of the rays cast at them are removed. */
+  float visibilityThreshold{0.0f};
   /** When to compute vertex normals from geometry. */
   ComputeNormalsOption computeNormals = ComputeNormalsOption::BROKEN;
   /** When to use 32-bit indices. */
   UseLongIndicesOptions useLongIndices = UseLongIndicesOptions::AUTO;
+  /** How many view directions (6, 14 or 26) to presort transparent primitives for; 0 for none. */
+  int transparentSortViews{0};
   /** Select baked animation framerate. */
   AnimationFramerateOptions animationFramerate = AnimationFramerateOptions::BAKE30;
+  /** How many worker processes to bake animation stacks in; only honoured on Linux. */
+  int animationBakeJobs{1};
+  /** How to store animated rotations. */
+  AnimationPrecisionOptions animationRotationPrecision = AnimationPrecisionOptions::FLOAT;
+  /** How to store animated morph target weights; channels with weights outside [0, 1] stay float. */
+  AnimationPrecisionOptions animationWeightPrecision = AnimationPrecisionOptions::FLOAT;
+
+  /** Folder to write images into, named by content hash and shared between conversions. */
+  std::string sharedAssetsDir;
+  /** Whether to write the .bin buffer into the shared folder by content hash too. */
+  bool sharedBuffers{false};
 
   /** Temporary directory used by FBX SDK. */
   std::string fbxTempDir;
+
+  /** Folder for the cross-run cache of processed textures; no caching if empty. */
+  std::string textureCacheDir;
+  /** Size in megabytes beyond which least recently used cache entries are evicted. */
+  int textureCacheMaxMB{1024};
+  /** Whether to re-encode PNG textures in their smallest lossless form. */
+  bool optimizePngs{false};
+  /** Whether to replace single-colour textures with the equivalent material factors. */
+  bool foldUniformTextures{false};
+  /** How far, in 8-bit steps, pixels may stray from each other in a "single-colour" texture. */
+  int uniformTextureTolerance{2};
+  /** Whether to crop textures down to the region their UVs actually cover. */
+  bool cropTextures{false};
+  /** Margin, in texels, to leave around the covered region when cropping. */
+  int cropTexturePadding{8};
+  /** Texels per metre to downsample textures towards; disabled if zero. */
+  float texelDensity{0.0f};
 };
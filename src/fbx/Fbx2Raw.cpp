@@ -14,20 +14,32 @@
 #include <cstdint>
 #include <cstdio>
 #include <fstream>
+#include <functional>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
 #include "FBX2glTF.h"
 
 #include "raw/RawModel.hpp"
+#include "utils/Archive_Utils.hpp"
 #include "utils/File_Utils.hpp"
+#include "utils/Parallel_Utils.hpp"
 #include "utils/String_Utils.hpp"
 
 #include "FbxBlendShapesAccess.hpp"
 #include "FbxLayerElementAccess.hpp"
+#include "FbxMemoryStream.hpp"
 #include "FbxSkinningAccess.hpp"
 #include "materials/RoughnessMetallicMaterials.hpp"
 #include "materials/TraditionalMaterials.hpp"
@@ -125,6 +137,8 @@ static void ReadMesh(
     FbxScene* pScene,
     FbxNode* pNode,
     const std::map<const FbxTexture*, FbxString>& textureLocations) {
+  const bool tessellated =
+      pNode->GetNodeAttribute()->GetAttributeType() != FbxNodeAttribute::eMesh;
   FbxGeometryConverter meshConverter(pScene->GetFbxManager());
   meshConverter.Triangulate(pNode->GetNodeAttribute(), true);
   FbxMesh* pMesh = pNode->GetMesh();
@@ -146,6 +160,9 @@ static void ReadMesh(
 
   const char* meshName = (pNode->GetName()[0] != '\0') ? pNode->GetName() : pMesh->GetName();
   const int rawSurfaceIndex = raw.AddSurface(meshName, surfaceId);
+  if (tessellated && verboseOutput) {
+    fmt::printf("Tessellated %s into %d triangles.\n", meshName, pMesh->GetPolygonCount());
+  }
 
   const FbxVector4* controlPoints = pMesh->GetControlPoints();
   const FbxLayerElementAccess<FbxVector4> normalLayer(
@@ -602,14 +619,129 @@ static void ReadNodeProperty(RawModel& raw, FbxNode* pNode, FbxProperty& prop) {
   }
 }
 
+// The nodes picked out by --include-nodes and --exclude-nodes, by unique id. Only the 'selected'
+// ones have their meshes, cameras and lights read; 'kept' also holds their ancestors and the joints
+// that skin them, which make it into the hierarchy and the animations as bare transforms.
+struct NodeSelection {
+  std::unordered_set<FbxUInt64> selected;
+  std::unordered_set<FbxUInt64> kept;
+};
+
+static std::vector<std::string> SplitNodePath(const std::string& path) {
+  std::vector<std::string> segments;
+  size_t start = 0;
+  while (start < path.length()) {
+    size_t end = path.find('/', start);
+    if (end == std::string::npos) {
+      end = path.length();
+    }
+    if (end > start) {
+      segments.push_back(path.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+  return segments;
+}
+
+// a pattern matches a node when its segments glob-match the start of the node's path, so that a
+// match selects the whole subtree beneath it
+static bool MatchesNodePattern(
+    const std::vector<std::string>& pattern,
+    const std::vector<std::string>& path) {
+  if (pattern.size() > path.size()) {
+    return false;
+  }
+  for (size_t ii = 0; ii < pattern.size(); ii++) {
+    if (!StringUtils::MatchGlob(pattern[ii], path[ii])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Match the node paths against the include and exclude patterns. Paths are the node names from the
+ * scene root down, e.g. "/Vehicles/Truck"; the root itself is "/".
+ */
+static void SelectNodes(FbxScene* pScene, const GltfOptions& options, NodeSelection& selection) {
+  std::vector<std::vector<std::string>> includes, excludes;
+  for (const std::string& pattern : options.includeNodes) {
+    includes.push_back(SplitNodePath(pattern));
+  }
+  for (const std::string& pattern : options.excludeNodes) {
+    excludes.push_back(SplitNodePath(pattern));
+  }
+
+  std::vector<FbxNode*> selectedNodes;
+  std::vector<std::string> path;
+  std::function<void(FbxNode*)> visit = [&](FbxNode* pNode) {
+    for (const auto& pattern : excludes) {
+      if (MatchesNodePattern(pattern, path)) {
+        return; // and so is everything beneath it
+      }
+    }
+    bool included = includes.empty();
+    for (size_t ii = 0; ii < includes.size() && !included; ii++) {
+      included = MatchesNodePattern(includes[ii], path);
+    }
+    if (included) {
+      selection.selected.insert(pNode->GetUniqueID());
+      selectedNodes.push_back(pNode);
+    }
+    for (int child = 0; child < pNode->GetChildCount(); child++) {
+      path.push_back(pNode->GetChild(child)->GetName());
+      visit(pNode->GetChild(child));
+      path.pop_back();
+    }
+  };
+  visit(pScene->GetRootNode());
+
+  const auto keep = [&](FbxNode* pNode) {
+    while (pNode != nullptr && selection.kept.insert(pNode->GetUniqueID()).second) {
+      pNode = pNode->GetParent();
+    }
+  };
+  keep(pScene->GetRootNode());
+  for (FbxNode* pNode : selectedNodes) {
+    keep(pNode);
+    FbxGeometry* pGeometry = pNode->GetGeometry();
+    if (pGeometry == nullptr) {
+      continue;
+    }
+    for (int deformerIx = 0; deformerIx < pGeometry->GetDeformerCount(FbxDeformer::eSkin);
+         deformerIx++) {
+      FbxSkin* pSkin =
+          static_cast<FbxSkin*>(pGeometry->GetDeformer(deformerIx, FbxDeformer::eSkin));
+      for (int clusterIx = 0; clusterIx < pSkin->GetClusterCount(); clusterIx++) {
+        keep(pSkin->GetCluster(clusterIx)->GetLink());
+      }
+    }
+  }
+
+  if (verboseOutput) {
+    fmt::printf(
+        "Selected %d of %d nodes, keeping %d.\n",
+        selection.selected.size(),
+        pScene->GetNodeCount(),
+        selection.kept.size());
+  }
+  if (selection.selected.empty()) {
+    fmt::printf("Warning: the node selection matches nothing.\n");
+  }
+}
+
 static void ReadNodeAttributes(
     RawModel& raw,
     FbxScene* pScene,
     FbxNode* pNode,
-    const std::map<const FbxTexture*, FbxString>& textureLocations) {
+    const std::map<const FbxTexture*, FbxString>& textureLocations,
+    const NodeSelection* selection) {
   if (!pNode->GetVisibility()) {
     return;
   }
+  if (selection != nullptr && selection->kept.count(pNode->GetUniqueID()) == 0) {
+    return;
+  }
 
   // Only support non-animated user defined properties for now
   FbxProperty objectProperty = pNode->GetFirstProperty();
@@ -622,6 +754,9 @@ static void ReadNodeAttributes(
   }
 
   FbxNodeAttribute* pNodeAttribute = pNode->GetNodeAttribute();
+  if (selection != nullptr && selection->selected.count(pNode->GetUniqueID()) == 0) {
+    pNodeAttribute = nullptr; // only here to hold up a selected node or skin one
+  }
   if (pNodeAttribute != nullptr) {
     const FbxNodeAttribute::EType attributeType = pNodeAttribute->GetAttributeType();
     switch (attributeType) {
@@ -661,7 +796,7 @@ static void ReadNodeAttributes(
   }
 
   for (int child = 0; child < pNode->GetChildCount(); child++) {
-    ReadNodeAttributes(raw, pScene, pNode->GetChild(child), textureLocations);
+    ReadNodeAttributes(raw, pScene, pNode->GetChild(child), textureLocations, selection);
   }
 }
 
@@ -689,8 +824,12 @@ static void ReadNodeHierarchy(
     FbxNode* pNode,
     const long parentId,
     const std::string& path,
-    int extraSkinIx) {
+    int extraSkinIx,
+    const NodeSelection* selection) {
   const FbxUInt64 nodeId = pNode->GetUniqueID();
+  if (selection != nullptr && selection->kept.count(nodeId) == 0) {
+    return;
+  }
   const char* nodeName = pNode->GetName();
   FbxSkeleton *skel = pNode->GetSkeleton();
   if (skel == nullptr) {
@@ -754,248 +893,464 @@ static void ReadNodeHierarchy(
     raw.SetRootNode(nodeId);
   }
   for (int child = 0; child < pNode->GetChildCount(); child++) {
-    ReadNodeHierarchy(raw, pScene, pNode->GetChild(child), nodeId, newPath, extraSkinIx);
+    ReadNodeHierarchy(
+        raw, pScene, pNode->GetChild(child), nodeId, newPath, extraSkinIx, selection);
   }
 }
 
-static void ReadAnimations(RawModel& raw, FbxScene* pScene, const GltfOptions& options) {
-  FbxTime::EMode eMode = FbxTime::eFrames24;
+static FbxTime::EMode GetAnimationTimeMode(const GltfOptions& options) {
   switch (options.animationFramerate) {
     case AnimationFramerateOptions::BAKE24:
-      eMode = FbxTime::eFrames24;
-      break;
+      return FbxTime::eFrames24;
     case AnimationFramerateOptions::BAKE30:
-      eMode = FbxTime::eFrames30;
-      break;
+      return FbxTime::eFrames30;
     case AnimationFramerateOptions::BAKE60:
-      eMode = FbxTime::eFrames60;
-      break;
+      return FbxTime::eFrames60;
   }
-  const double epsilon = 1e-5f;
+  return FbxTime::eFrames24;
+}
 
-  const int animationCount = pScene->GetSrcObjectCount<FbxAnimStack>();
-  for (size_t animIx = 0; animIx < animationCount; animIx++) {
-    FbxAnimStack* pAnimStack = pScene->GetSrcObject<FbxAnimStack>(animIx);
-    FbxString animStackName = pAnimStack->GetName();
-
-    pScene->SetCurrentAnimationStack(pAnimStack);
-
-    /**
-     * Individual animations are often concatenated on the timeline, and the
-     * only certain way to identify precisely what interval they occupy is to
-     * depth-traverse the entire animation stack, and examine the actual keys.
-     *
-     * There is a deprecated concept of an "animation take" which is meant to
-     * provide precisely this time interval information, but the data is not
-     * actually derived by the SDK from source-of-truth data structures, but
-     * rather provided directly by the FBX exporter, and not sanity checked.
-     *
-     * Some exporters calculate it correctly. Others do not. In any case, we
-     * now ignore it completely.
-     */
-    FbxLongLong firstFrameIndex = -1;
-    FbxLongLong lastFrameIndex = -1;
-    for (int layerIx = 0; layerIx < pAnimStack->GetMemberCount(); layerIx++) {
-      FbxAnimLayer* layer = pAnimStack->GetMember<FbxAnimLayer>(layerIx);
-      for (int nodeIx = 0; nodeIx < layer->GetMemberCount(); nodeIx++) {
-        auto* node = layer->GetMember<FbxAnimCurveNode>(nodeIx);
-        FbxTimeSpan nodeTimeSpan;
-        // Multiple curves per curve node is not even supported by the SDK.
-        for (int curveIx = 0; curveIx < node->GetCurveCount(0); curveIx++) {
-          FbxAnimCurve* curve = node->GetCurve(0U, curveIx);
-          if (curve == nullptr) {
-            continue;
-          }
-          // simply take the interval as first key to last key
-          int firstKeyIndex = 0;
-          int lastKeyIndex = std::max(firstKeyIndex, curve->KeyGetCount() - 1);
-          FbxLongLong firstCurveFrame = curve->KeyGetTime(firstKeyIndex).GetFrameCount(eMode);
-          FbxLongLong lastCurveFrame = curve->KeyGetTime(lastKeyIndex).GetFrameCount(eMode);
-
-          // the final interval is the union of all node curve intervals
-          if (firstFrameIndex == -1 || firstCurveFrame < firstFrameIndex) {
-            firstFrameIndex = firstCurveFrame;
-          }
-          if (lastFrameIndex == -1 || lastCurveFrame > lastFrameIndex) {
-            lastFrameIndex = lastCurveFrame;
-          }
+static void GetAnimationFrameRange(
+    FbxAnimStack* pAnimStack,
+    const FbxTime::EMode eMode,
+    FbxLongLong& firstFrameIndex,
+    FbxLongLong& lastFrameIndex) {
+  /**
+   * Individual animations are often concatenated on the timeline, and the
+   * only certain way to identify precisely what interval they occupy is to
+   * depth-traverse the entire animation stack, and examine the actual keys.
+   *
+   * There is a deprecated concept of an "animation take" which is meant to
+   * provide precisely this time interval information, but the data is not
+   * actually derived by the SDK from source-of-truth data structures, but
+   * rather provided directly by the FBX exporter, and not sanity checked.
+   *
+   * Some exporters calculate it correctly. Others do not. In any case, we
+   * now ignore it completely.
+   */
+  firstFrameIndex = -1;
+  lastFrameIndex = -1;
+  for (int layerIx = 0; layerIx < pAnimStack->GetMemberCount(); layerIx++) {
+    FbxAnimLayer* layer = pAnimStack->GetMember<FbxAnimLayer>(layerIx);
+    for (int nodeIx = 0; nodeIx < layer->GetMemberCount(); nodeIx++) {
+      auto* node = layer->GetMember<FbxAnimCurveNode>(nodeIx);
+      FbxTimeSpan nodeTimeSpan;
+      // Multiple curves per curve node is not even supported by the SDK.
+      for (int curveIx = 0; curveIx < node->GetCurveCount(0); curveIx++) {
+        FbxAnimCurve* curve = node->GetCurve(0U, curveIx);
+        if (curve == nullptr) {
+          continue;
+        }
+        // simply take the interval as first key to last key
+        int firstKeyIndex = 0;
+        int lastKeyIndex = std::max(firstKeyIndex, curve->KeyGetCount() - 1);
+        FbxLongLong firstCurveFrame = curve->KeyGetTime(firstKeyIndex).GetFrameCount(eMode);
+        FbxLongLong lastCurveFrame = curve->KeyGetTime(lastKeyIndex).GetFrameCount(eMode);
+
+        // the final interval is the union of all node curve intervals
+        if (firstFrameIndex == -1 || firstCurveFrame < firstFrameIndex) {
+          firstFrameIndex = firstCurveFrame;
+        }
+        if (lastFrameIndex == -1 || lastCurveFrame > lastFrameIndex) {
+          lastFrameIndex = lastCurveFrame;
         }
       }
     }
-    RawAnimation animation;
-    animation.name = animStackName;
+  }
+}
 
-    fmt::printf(
-        "Animation %s: [%lu - %lu]\n", std::string(animStackName), firstFrameIndex, lastFrameIndex);
+static size_t GetAnimationSizeInBytes(const RawAnimation& animation) {
+  size_t totalSizeInBytes = 0;
+  for (const RawChannel& channel : animation.channels) {
+    totalSizeInBytes += channel.translations.size() * sizeof(channel.translations[0]) +
+        channel.rotations.size() * sizeof(channel.rotations[0]) +
+        channel.scales.size() * sizeof(channel.scales[0]) +
+        channel.weights.size() * sizeof(channel.weights[0]);
+  }
+  return totalSizeInBytes;
+}
 
-    if (verboseOutput) {
-      fmt::printf("animation %zu: %s (%d%%)", animIx, (const char*)animStackName, 0);
+/**
+ * Bake the given animation stack into a RawAnimation. This selects the stack as the scene's
+ * current one, so stacks can only be baked one at a time per process.
+ */
+static RawAnimation ReadAnimationStack(
+    const RawModel& raw,
+    FbxScene* pScene,
+    const size_t animIx,
+    const FbxTime::EMode eMode,
+    const bool reportProgress) {
+  const double epsilon = 1e-5f;
+
+  FbxAnimStack* pAnimStack = pScene->GetSrcObject<FbxAnimStack>(animIx);
+  FbxString animStackName = pAnimStack->GetName();
+
+  pScene->SetCurrentAnimationStack(pAnimStack);
+
+  FbxLongLong firstFrameIndex, lastFrameIndex;
+  GetAnimationFrameRange(pAnimStack, eMode, firstFrameIndex, lastFrameIndex);
+
+  RawAnimation animation;
+  animation.name = animStackName;
+
+  if (verboseOutput && reportProgress) {
+    fmt::printf("animation %zu: %s (%d%%)", animIx, (const char*)animStackName, 0);
+  }
+
+  for (FbxLongLong frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++) {
+    FbxTime pTime;
+    // first frame is always at t = 0.0
+    pTime.SetFrame(frameIndex - firstFrameIndex, eMode);
+    animation.times.emplace_back((float)pTime.GetSecondDouble());
+  }
+
+  const int nodeCount = pScene->GetNodeCount();
+  for (int nodeIndex = 0; nodeIndex < nodeCount; nodeIndex++) {
+    FbxNode* pNode = pScene->GetNode(nodeIndex);
+    if (raw.GetNodeById(pNode->GetUniqueID()) < 0) {
+      continue; // left out of the node selection
     }
+    const FbxAMatrix baseTransform = pNode->EvaluateLocalTransform();
+    const FbxVector4 baseTranslation = baseTransform.GetT();
+    const FbxQuaternion baseRotation = baseTransform.GetQ();
+    const FbxVector4 baseScaling = computeLocalScale(pNode);
+    bool hasTranslation = false;
+    bool hasRotation = false;
+    bool hasScale = false;
+    bool hasMorphs = false;
+
+    RawChannel channel;
+    channel.nodeIndex = raw.GetNodeById(pNode->GetUniqueID());
 
     for (FbxLongLong frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++) {
       FbxTime pTime;
-      // first frame is always at t = 0.0
-      pTime.SetFrame(frameIndex - firstFrameIndex, eMode);
-      animation.times.emplace_back((float)pTime.GetSecondDouble());
+      pTime.SetFrame(frameIndex, eMode);
+
+      const FbxAMatrix localTransform = pNode->EvaluateLocalTransform(pTime);
+      const FbxVector4 localTranslation = localTransform.GetT();
+      const FbxQuaternion localRotation = localTransform.GetQ();
+      const FbxVector4 localScale = computeLocalScale(pNode, pTime);
+
+      hasTranslation |=
+          (fabs(localTranslation[0] - baseTranslation[0]) > epsilon ||
+           fabs(localTranslation[1] - baseTranslation[1]) > epsilon ||
+           fabs(localTranslation[2] - baseTranslation[2]) > epsilon);
+      hasRotation |=
+          (fabs(localRotation[0] - baseRotation[0]) > epsilon ||
+           fabs(localRotation[1] - baseRotation[1]) > epsilon ||
+           fabs(localRotation[2] - baseRotation[2]) > epsilon ||
+           fabs(localRotation[3] - baseRotation[3]) > epsilon);
+      hasScale |=
+          (fabs(localScale[0] - baseScaling[0]) > epsilon ||
+           fabs(localScale[1] - baseScaling[1]) > epsilon ||
+           fabs(localScale[2] - baseScaling[2]) > epsilon);
+
+      channel.translations.push_back(toVec3f(localTranslation) * scaleFactor);
+      channel.rotations.push_back(toQuatf(localRotation));
+      channel.scales.push_back(toVec3f(localScale));
     }
 
-    size_t totalSizeInBytes = 0;
-
-    const int nodeCount = pScene->GetNodeCount();
-    for (int nodeIndex = 0; nodeIndex < nodeCount; nodeIndex++) {
-      FbxNode* pNode = pScene->GetNode(nodeIndex);
-      const FbxAMatrix baseTransform = pNode->EvaluateLocalTransform();
-      const FbxVector4 baseTranslation = baseTransform.GetT();
-      const FbxQuaternion baseRotation = baseTransform.GetQ();
-      const FbxVector4 baseScaling = computeLocalScale(pNode);
-      bool hasTranslation = false;
-      bool hasRotation = false;
-      bool hasScale = false;
-      bool hasMorphs = false;
-
-      RawChannel channel;
-      channel.nodeIndex = raw.GetNodeById(pNode->GetUniqueID());
+    std::vector<FbxAnimCurve*> shapeAnimCurves;
+    FbxNodeAttribute* nodeAttr = pNode->GetNodeAttribute();
+    // a node kept only for the sake of the selection has no mesh, and weights need one
+    if (nodeAttr != nullptr && nodeAttr->GetAttributeType() == FbxNodeAttribute::EType::eMesh &&
+        raw.GetNode(channel.nodeIndex).surfaceId != 0) {
+      // it's inelegant to recreate this same access class multiple times, but it's also dirt
+      // cheap...
+      FbxBlendShapesAccess blendShapes(static_cast<FbxMesh*>(nodeAttr));
 
       for (FbxLongLong frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++) {
         FbxTime pTime;
         pTime.SetFrame(frameIndex, eMode);
 
-        const FbxAMatrix localTransform = pNode->EvaluateLocalTransform(pTime);
-        const FbxVector4 localTranslation = localTransform.GetT();
-        const FbxQuaternion localRotation = localTransform.GetQ();
-        const FbxVector4 localScale = computeLocalScale(pNode, pTime);
-
-        hasTranslation |=
-            (fabs(localTranslation[0] - baseTranslation[0]) > epsilon ||
-             fabs(localTranslation[1] - baseTranslation[1]) > epsilon ||
-             fabs(localTranslation[2] - baseTranslation[2]) > epsilon);
-        hasRotation |=
-            (fabs(localRotation[0] - baseRotation[0]) > epsilon ||
-             fabs(localRotation[1] - baseRotation[1]) > epsilon ||
-             fabs(localRotation[2] - baseRotation[2]) > epsilon ||
-             fabs(localRotation[3] - baseRotation[3]) > epsilon);
-        hasScale |=
-            (fabs(localScale[0] - baseScaling[0]) > epsilon ||
-             fabs(localScale[1] - baseScaling[1]) > epsilon ||
-             fabs(localScale[2] - baseScaling[2]) > epsilon);
-
-        channel.translations.push_back(toVec3f(localTranslation) * scaleFactor);
-        channel.rotations.push_back(toQuatf(localRotation));
-        channel.scales.push_back(toVec3f(localScale));
-      }
+        for (size_t channelIx = 0; channelIx < blendShapes.GetChannelCount(); channelIx++) {
+          FbxAnimCurve* curve = blendShapes.GetAnimation(channelIx, animIx);
+          float influence = (curve != nullptr) ? curve->Evaluate(pTime) : 0; // 0-100
 
-      std::vector<FbxAnimCurve*> shapeAnimCurves;
-      FbxNodeAttribute* nodeAttr = pNode->GetNodeAttribute();
-      if (nodeAttr != nullptr && nodeAttr->GetAttributeType() == FbxNodeAttribute::EType::eMesh) {
-        // it's inelegant to recreate this same access class multiple times, but it's also dirt
-        // cheap...
-        FbxBlendShapesAccess blendShapes(static_cast<FbxMesh*>(nodeAttr));
-
-        for (FbxLongLong frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++) {
-          FbxTime pTime;
-          pTime.SetFrame(frameIndex, eMode);
-
-          for (size_t channelIx = 0; channelIx < blendShapes.GetChannelCount(); channelIx++) {
-            FbxAnimCurve* curve = blendShapes.GetAnimation(channelIx, animIx);
-            float influence = (curve != nullptr) ? curve->Evaluate(pTime) : 0; // 0-100
-
-            int targetCount = static_cast<int>(blendShapes.GetTargetShapeCount(channelIx));
-
-            // the target shape 'fullWeight' values are a strictly ascending list of floats
-            // (between 0 and 100), forming a sequence of intervals -- this convenience function
-            // figures out if 'p' lays between some certain target fullWeights, and if so where
-            // (from 0 to 1).
-            auto findInInterval = [&](const double p, const int n) {
-              if (n >= targetCount) {
-                // p is certainly completely left of this interval
+          int targetCount = static_cast<int>(blendShapes.GetTargetShapeCount(channelIx));
+
+          // the target shape 'fullWeight' values are a strictly ascending list of floats
+          // (between 0 and 100), forming a sequence of intervals -- this convenience function
+          // figures out if 'p' lays between some certain target fullWeights, and if so where
+          // (from 0 to 1).
+          auto findInInterval = [&](const double p, const int n) {
+            if (n >= targetCount) {
+              // p is certainly completely left of this interval
+              return NAN;
+            }
+            double leftWeight = 0;
+            if (n >= 0) {
+              leftWeight = blendShapes.GetTargetShape(channelIx, n).fullWeight;
+              if (p < leftWeight) {
                 return NAN;
               }
-              double leftWeight = 0;
-              if (n >= 0) {
-                leftWeight = blendShapes.GetTargetShape(channelIx, n).fullWeight;
-                if (p < leftWeight) {
-                  return NAN;
-                }
-                // the first interval implicitly includes all lesser influence values
-              }
-              double rightWeight = blendShapes.GetTargetShape(channelIx, n + 1).fullWeight;
-              if (p > rightWeight && n + 1 < targetCount - 1) {
-                return NAN;
-                // the last interval implicitly includes all greater influence values
+              // the first interval implicitly includes all lesser influence values
+            }
+            double rightWeight = blendShapes.GetTargetShape(channelIx, n + 1).fullWeight;
+            if (p > rightWeight && n + 1 < targetCount - 1) {
+              return NAN;
+              // the last interval implicitly includes all greater influence values
+            }
+            // transform p linearly such that [leftWeight, rightWeight] => [0, 1]
+            return static_cast<float>((p - leftWeight) / (rightWeight - leftWeight));
+          };
+
+          for (int targetIx = 0; targetIx < targetCount; targetIx++) {
+            if (curve) {
+              float result = findInInterval(influence, targetIx - 1);
+              if (!std::isnan(result)) {
+                // we're transitioning into targetIx
+                channel.weights.push_back(result);
+                hasMorphs = true;
+                continue;
               }
-              // transform p linearly such that [leftWeight, rightWeight] => [0, 1]
-              return static_cast<float>((p - leftWeight) / (rightWeight - leftWeight));
-            };
-
-            for (int targetIx = 0; targetIx < targetCount; targetIx++) {
-              if (curve) {
-                float result = findInInterval(influence, targetIx - 1);
+              if (targetIx != targetCount - 1) {
+                result = findInInterval(influence, targetIx);
                 if (!std::isnan(result)) {
-                  // we're transitioning into targetIx
-                  channel.weights.push_back(result);
+                  // we're transitioning AWAY from targetIx
+                  channel.weights.push_back(1.0f - result);
                   hasMorphs = true;
                   continue;
                 }
-                if (targetIx != targetCount - 1) {
-                  result = findInInterval(influence, targetIx);
-                  if (!std::isnan(result)) {
-                    // we're transitioning AWAY from targetIx
-                    channel.weights.push_back(1.0f - result);
-                    hasMorphs = true;
-                    continue;
-                  }
-                }
               }
-
-              // this is here because we have to fill in a weight for every channelIx/targetIx
-              // permutation, regardless of whether or not they participate in this animation.
-              channel.weights.push_back(0.0f);
             }
+
+            // this is here because we have to fill in a weight for every channelIx/targetIx
+            // permutation, regardless of whether or not they participate in this animation.
+            channel.weights.push_back(0.0f);
           }
         }
       }
+    }
 
-      if (hasTranslation || hasRotation || hasScale || hasMorphs) {
-        if (!hasTranslation) {
-          channel.translations.clear();
-        }
-        if (!hasRotation) {
-          channel.rotations.clear();
-        }
-        if (!hasScale) {
-          channel.scales.clear();
-        }
-        if (!hasMorphs) {
-          channel.weights.clear();
-        }
+    if (hasTranslation || hasRotation || hasScale || hasMorphs) {
+      if (!hasTranslation) {
+        channel.translations.clear();
+      }
+      if (!hasRotation) {
+        channel.rotations.clear();
+      }
+      if (!hasScale) {
+        channel.scales.clear();
+      }
+      if (!hasMorphs) {
+        channel.weights.clear();
+      }
+
+      animation.channels.emplace_back(channel);
+    }
+
+    if (verboseOutput && reportProgress) {
+      fmt::printf(
+          "\ranimation %d: %s (%d%%)",
+          animIx,
+          (const char*)animStackName,
+          nodeIndex * 100 / nodeCount);
+    }
+  }
+
+  return animation;
+}
+
+static void ReportAnimation(const RawAnimation& animation, const size_t animIx) {
+  if (verboseOutput) {
+    fmt::printf(
+        "\ranimation %d: %s (%d channels, %3.1f MB)\n",
+        animIx,
+        animation.name.c_str(),
+        (int)animation.channels.size(),
+        (float)GetAnimationSizeInBytes(animation) * 1e-6f);
+  }
+}
+
+static void PrintAnimationFrameRange(
+    FbxScene* pScene,
+    const size_t animIx,
+    const FbxTime::EMode eMode) {
+  FbxAnimStack* pAnimStack = pScene->GetSrcObject<FbxAnimStack>(animIx);
+  FbxLongLong firstFrameIndex, lastFrameIndex;
+  GetAnimationFrameRange(pAnimStack, eMode, firstFrameIndex, lastFrameIndex);
+  fmt::printf(
+      "Animation %s: [%lu - %lu]\n",
+      std::string(pAnimStack->GetName()),
+      firstFrameIndex,
+      lastFrameIndex);
+}
+
+#ifdef __linux__
+template <typename T>
+static bool WriteValues(FILE* fp, const T* values, size_t count) {
+  const uint64_t count64 = count;
+  return fwrite(&count64, sizeof(count64), 1, fp) == 1 &&
+      (count == 0 || fwrite(values, sizeof(T), count, fp) == count);
+}
 
-        animation.channels.emplace_back(channel);
+template <typename T>
+static bool ReadValues(FILE* fp, std::vector<T>& values) {
+  uint64_t count64;
+  if (fread(&count64, sizeof(count64), 1, fp) != 1) {
+    return false;
+  }
+  values.resize(count64);
+  return count64 == 0 || fread(values.data(), sizeof(T), count64, fp) == count64;
+}
+
+static bool WriteAnimation(FILE* fp, const uint64_t animIx, const RawAnimation& animation) {
+  bool ok = fwrite(&animIx, sizeof(animIx), 1, fp) == 1 &&
+      WriteValues(fp, animation.name.data(), animation.name.size()) &&
+      WriteValues(fp, animation.times.data(), animation.times.size());
+
+  const uint64_t channelCount = animation.channels.size();
+  ok = ok && fwrite(&channelCount, sizeof(channelCount), 1, fp) == 1;
+  for (const RawChannel& channel : animation.channels) {
+    // mathfu types may be padded, so go through plain floats
+    std::vector<float> translations, rotations, scales;
+    for (const Vec3f& t : channel.translations) {
+      translations.insert(translations.end(), {t.x, t.y, t.z});
+    }
+    for (const Quatf& r : channel.rotations) {
+      rotations.insert(rotations.end(), {r.vector().x, r.vector().y, r.vector().z, r.scalar()});
+    }
+    for (const Vec3f& s : channel.scales) {
+      scales.insert(scales.end(), {s.x, s.y, s.z});
+    }
+    const int32_t nodeIndex = channel.nodeIndex;
+    ok = ok && fwrite(&nodeIndex, sizeof(nodeIndex), 1, fp) == 1 &&
+        WriteValues(fp, translations.data(), translations.size()) &&
+        WriteValues(fp, rotations.data(), rotations.size()) &&
+        WriteValues(fp, scales.data(), scales.size()) &&
+        WriteValues(fp, channel.weights.data(), channel.weights.size());
+  }
+  return ok;
+}
 
-        totalSizeInBytes += channel.translations.size() * sizeof(channel.translations[0]) +
-            channel.rotations.size() * sizeof(channel.rotations[0]) +
-            channel.scales.size() * sizeof(channel.scales[0]) +
-            channel.weights.size() * sizeof(channel.weights[0]);
+static bool ReadAnimation(FILE* fp, uint64_t& animIx, RawAnimation& animation) {
+  std::vector<char> name;
+  uint64_t channelCount;
+  if (fread(&animIx, sizeof(animIx), 1, fp) != 1 || !ReadValues(fp, name) ||
+      !ReadValues(fp, animation.times) ||
+      fread(&channelCount, sizeof(channelCount), 1, fp) != 1) {
+    return false;
+  }
+  animation.name.assign(name.begin(), name.end());
+  animation.channels.resize(channelCount);
+  for (RawChannel& channel : animation.channels) {
+    int32_t nodeIndex;
+    std::vector<float> translations, rotations, scales;
+    if (fread(&nodeIndex, sizeof(nodeIndex), 1, fp) != 1 || !ReadValues(fp, translations) ||
+        !ReadValues(fp, rotations) || !ReadValues(fp, scales) ||
+        !ReadValues(fp, channel.weights)) {
+      return false;
+    }
+    channel.nodeIndex = nodeIndex;
+    for (size_t ii = 0; ii + 2 < translations.size(); ii += 3) {
+      channel.translations.emplace_back(translations[ii], translations[ii + 1], translations[ii + 2]);
+    }
+    for (size_t ii = 0; ii + 3 < rotations.size(); ii += 4) {
+      channel.rotations.emplace_back(
+          rotations[ii + 3], rotations[ii], rotations[ii + 1], rotations[ii + 2]);
+    }
+    for (size_t ii = 0; ii + 2 < scales.size(); ii += 3) {
+      channel.scales.emplace_back(scales[ii], scales[ii + 1], scales[ii + 2]);
+    }
+  }
+  return true;
+}
+
+/**
+ * The FBX SDK can't be driven from multiple threads, but a forked copy of the whole process can
+ * happily bake stacks of its own. Each worker inherits the converted scene copy-on-write, bakes
+ * every n:th stack, and streams the results back through an unlinked temporary file, which the
+ * parent reads back into 'animations' by stack index. Whatever a worker failed to deliver is
+ * left unmarked in 'baked', for the caller to bake itself.
+ */
+static void ReadAnimationStacksForked(
+    const RawModel& raw,
+    FbxScene* pScene,
+    const FbxTime::EMode eMode,
+    const int jobCount,
+    std::vector<RawAnimation>& animations,
+    std::vector<bool>& baked) {
+  struct Worker {
+    pid_t pid;
+    FILE* results;
+  };
+  std::vector<Worker> workers;
+
+  // anything still buffered would otherwise be printed again by every worker
+  fflush(stdout);
+  fflush(stderr);
+
+  for (int jobIx = 0; jobIx < jobCount; jobIx++) {
+    FILE* results = tmpfile();
+    if (results == nullptr) {
+      fmt::printf("Warning: Couldn't create temporary file for animation worker %d.\n", jobIx);
+      break;
+    }
+    const pid_t pid = fork();
+    if (pid < 0) {
+      fmt::printf("Warning: Couldn't fork animation worker %d.\n", jobIx);
+      fclose(results);
+      break;
+    }
+    if (pid == 0) {
+      // worker: bake our share, then leave without running any of the parent's teardown
+      bool ok = true;
+      for (size_t animIx = jobIx; ok && animIx < animations.size(); animIx += jobCount) {
+        ok = WriteAnimation(results, animIx, ReadAnimationStack(raw, pScene, animIx, eMode, false));
       }
+      ok = (fflush(results) == 0) && ok;
+      _exit(ok ? 0 : 1);
+    }
+    workers.push_back({pid, results});
+  }
 
-      if (verboseOutput) {
-        fmt::printf(
-            "\ranimation %d: %s (%d%%)",
-            animIx,
-            (const char*)animStackName,
-            nodeIndex * 100 / nodeCount);
+  for (const Worker& worker : workers) {
+    int status = 0;
+    while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fmt::printf("Warning: Animation worker %d failed; baking its stacks serially.\n", worker.pid);
+    } else {
+      rewind(worker.results);
+      uint64_t animIx;
+      RawAnimation animation;
+      while (ReadAnimation(worker.results, animIx, animation)) {
+        if (animIx < animations.size()) {
+          animations[animIx] = std::move(animation);
+          baked[animIx] = true;
+        }
+        animation = RawAnimation();
       }
     }
+    fclose(worker.results);
+  }
+}
+#endif
 
-    raw.AddAnimation(animation);
+static void ReadAnimations(RawModel& raw, FbxScene* pScene, const GltfOptions& options) {
+  const FbxTime::EMode eMode = GetAnimationTimeMode(options);
+  const int animationCount = pScene->GetSrcObjectCount<FbxAnimStack>();
 
+  std::vector<RawAnimation> animations(animationCount);
+  std::vector<bool> baked(animationCount, false);
+#ifdef __linux__
+  const int jobCount = std::min(options.animationBakeJobs, animationCount);
+  if (jobCount > 1) {
     if (verboseOutput) {
-      fmt::printf(
-          "\ranimation %d: %s (%d channels, %3.1f MB)\n",
-          animIx,
-          (const char*)animStackName,
-          (int)animation.channels.size(),
-          (float)totalSizeInBytes * 1e-6f);
+      fmt::printf("Baking %d animations in %d worker processes...\n", animationCount, jobCount);
     }
+    ReadAnimationStacksForked(raw, pScene, eMode, jobCount, animations, baked);
+  }
+#endif
+
+  for (size_t animIx = 0; animIx < animationCount; animIx++) {
+    PrintAnimationFrameRange(pScene, animIx, eMode);
+    if (!baked[animIx]) {
+      animations[animIx] = ReadAnimationStack(raw, pScene, animIx, eMode, true);
+    }
+    ReportAnimation(animations[animIx], animIx);
+    raw.AddAnimation(animations[animIx]);
   }
 }
 
@@ -1077,12 +1432,39 @@ static std::string FindFbxTexture(
     This function takes a texture file name stored in the FBX, which may be an absolute
     path on the author's computer such as "C:\MyProject\TextureName.psd", and matches
     it to a list of existing texture files in the same directory as the FBX file.
+
+    With a node selection, only the textures the selected nodes' materials use are looked for.
 */
 static void FindFbxTextures(
     FbxScene* pScene,
     const std::string& fbxFileName,
     const std::set<std::string>& extensions,
-    std::map<const FbxTexture*, FbxString>& textureLocations) {
+    std::map<const FbxTexture*, FbxString>& textureLocations,
+    const NodeSelection* selection) {
+  std::set<const FbxObject*> selectedMaterials;
+  if (selection != nullptr) {
+    for (int nodeIx = 0; nodeIx < pScene->GetNodeCount(); nodeIx++) {
+      FbxNode* pNode = pScene->GetNode(nodeIx);
+      if (selection->selected.count(pNode->GetUniqueID()) == 0) {
+        continue;
+      }
+      for (int ii = 0; ii < pNode->GetSrcObjectCount<FbxSurfaceMaterial>(); ii++) {
+        selectedMaterials.insert(pNode->GetSrcObject<FbxSurfaceMaterial>(ii));
+      }
+    }
+  }
+  // textures hang off material properties, possibly through a layered texture
+  std::function<bool(FbxObject*)> isSelected = [&](FbxObject* pTexture) {
+    for (int ii = 0; ii < pTexture->GetDstPropertyCount(); ii++) {
+      FbxObject* pOwner = pTexture->GetDstProperty(ii).GetFbxObject();
+      if (selectedMaterials.count(pOwner) > 0 ||
+          (FbxCast<FbxTexture>(pOwner) != nullptr && pOwner != pTexture && isSelected(pOwner))) {
+        return true;
+      }
+    }
+    return false;
+  };
+
   // figure out what folder the FBX file is in,
   const auto& fbxFolder = FileUtils::getFolder(fbxFileName);
   std::vector<std::string> folders{
@@ -1093,11 +1475,18 @@ static void FindFbxTextures(
       // then finally our working directory
       FileUtils::GetCurrentFolder(),
   };
+  // an FBX that came out of a zip bundle looks for its textures in the bundle before anywhere else
+  const bool isZipBundle = ArchiveUtils::IsZipFile(fbxFileName);
+  if (isZipBundle) {
+    folders.insert(folders.begin(), fbxFileName);
+  }
 
   // List the contents of each of these folders (if they exist)
   std::vector<std::vector<std::string>> folderContents;
   for (const auto& folder : folders) {
-    if (FileUtils::FolderExists(folder)) {
+    if (isZipBundle && folder == fbxFileName) {
+      folderContents.push_back(ArchiveUtils::ListZipEntries(folder, extensions));
+    } else if (FileUtils::FolderExists(folder)) {
       folderContents.push_back(FileUtils::ListFolderFiles(folder, extensions));
     } else {
       folderContents.push_back({});
@@ -1106,8 +1495,8 @@ static void FindFbxTextures(
 
   // Try to match the FBX texture names with the actual files on disk.
   for (int i = 0; i < pScene->GetTextureCount(); i++) {
-    const FbxFileTexture* pFileTexture = FbxCast<FbxFileTexture>(pScene->GetTexture(i));
-    if (pFileTexture != nullptr) {
+    FbxFileTexture* pFileTexture = FbxCast<FbxFileTexture>(pScene->GetTexture(i));
+    if (pFileTexture != nullptr && (selection == nullptr || isSelected(pFileTexture))) {
       const std::string fileLocation =
           FindFbxTexture(pFileTexture->GetFileName(), folders, folderContents);
       // always extend the mapping (even for files we didn't find)
@@ -1122,6 +1511,208 @@ static void FindFbxTextures(
   }
 }
 
+// The control net of a NURBS surface or patch, with U varying fastest, in scene units.
+struct ControlNet {
+  std::string name;
+  int uCount;
+  int vCount;
+  int uDegree;
+  int vDegree;
+  std::vector<Vec3f> points;
+};
+
+struct TessellationSteps {
+  int u;
+  int v;
+  long triangles; // an estimate
+};
+
+/*
+    Pick how many steps to tessellate each leg of a control net into, along U and V separately: so
+    that chords stray no further than 'tolerance' from the surface, edges are no longer than
+    'maxEdge', and (overriding both) there are no more than 'maxTriangles'; zero disables each. The
+    control polygon bounds the surface, so its second differences bound the curvature: a chord
+    across 1/n of a leg strays about bend / 8n^2 from the curve.
+*/
+static TessellationSteps EstimateTessellationSteps(
+    const ControlNet& net,
+    const float tolerance,
+    const float maxEdge,
+    const int maxTriangles) {
+  float bend[2] = {0.0f, 0.0f}, leg[2] = {0.0f, 0.0f};
+  auto at = [&](int u, int v) -> const Vec3f& { return net.points[v * net.uCount + u]; };
+  for (int v = 0; v < net.vCount; v++) {
+    for (int u = 0; u < net.uCount; u++) {
+      if (u + 1 < net.uCount) {
+        leg[0] = std::max(leg[0], (at(u + 1, v) - at(u, v)).Length());
+      }
+      if (u + 2 < net.uCount) {
+        bend[0] = std::max(bend[0], (at(u + 2, v) - at(u + 1, v) * 2.0f + at(u, v)).Length());
+      }
+      if (v + 1 < net.vCount) {
+        leg[1] = std::max(leg[1], (at(u, v + 1) - at(u, v)).Length());
+      }
+      if (v + 2 < net.vCount) {
+        bend[1] = std::max(bend[1], (at(u, v + 2) - at(u, v + 1) * 2.0f + at(u, v)).Length());
+      }
+    }
+  }
+
+  const int degrees[2] = {net.uDegree, net.vDegree};
+  int steps[2];
+  for (int axis = 0; axis < 2; axis++) {
+    steps[axis] = 1;
+    // a linear direction is its control polygon, which has no chordal error
+    if (tolerance > 0.0f && degrees[axis] > 1) {
+      steps[axis] = std::max(steps[axis], (int)ceilf(sqrtf(bend[axis] / (8.0f * tolerance))));
+    }
+    if (maxEdge > 0.0f) {
+      steps[axis] = std::max(steps[axis], (int)ceilf(leg[axis] / maxEdge));
+    }
+  }
+  const long legs = (long)std::max(1, net.uCount - 1) * std::max(1, net.vCount - 1);
+  long triangles = 2 * legs * steps[0] * steps[1];
+  if (maxTriangles > 0 && triangles > maxTriangles) {
+    const float shrink = sqrtf((float)maxTriangles / (float)triangles);
+    for (int& step : steps) {
+      step = std::max(1, (int)floorf(step * shrink));
+    }
+    triangles = 2 * legs * steps[0] * steps[1];
+  }
+  return {steps[0], steps[1], triangles};
+}
+
+/*
+    Set the tessellation steps of every NURBS surface and patch in the scene, which the SDK
+    otherwise picks without regard to the shape, from the tessellation options. The estimates are
+    computed in parallel. Must run after the unit conversion, which the control points are in.
+*/
+static void SetTessellationSteps(FbxScene* pScene, const GltfOptions& options) {
+  std::vector<ControlNet> nets;
+  std::vector<std::function<void(int, int)>> setSteps;
+  auto addNet = [&](FbxGeometry* pGeometry,
+                    int uCount,
+                    int vCount,
+                    int uDegree,
+                    int vDegree,
+                    std::function<void(int, int)> setStep) {
+    const FbxVector4* controlPoints = pGeometry->GetControlPoints();
+    if (controlPoints == nullptr || uCount <= 0 || vCount <= 0 ||
+        pGeometry->GetControlPointsCount() < uCount * vCount) {
+      return;
+    }
+    ControlNet net;
+    net.name = pGeometry->GetName();
+    net.uCount = uCount;
+    net.vCount = vCount;
+    net.uDegree = uDegree;
+    net.vDegree = vDegree;
+    for (int ii = 0; ii < uCount * vCount; ii++) {
+      net.points.push_back(toVec3f(controlPoints[ii]) * scaleFactor);
+    }
+    nets.push_back(std::move(net));
+    setSteps.push_back(setStep);
+  };
+
+  for (int ii = 0; ii < pScene->GetSrcObjectCount<FbxNurbsSurface>(); ii++) {
+    // trimmed surfaces are tessellated through the untrimmed ones they hold, which are found here
+    FbxNurbsSurface* pSurface = pScene->GetSrcObject<FbxNurbsSurface>(ii);
+    addNet(
+        pSurface,
+        pSurface->GetUCount(),
+        pSurface->GetVCount(),
+        pSurface->GetUOrder() - 1,
+        pSurface->GetVOrder() - 1,
+        [pSurface](int u, int v) { pSurface->SetStep(u, v); });
+  }
+  for (int ii = 0; ii < pScene->GetSrcObjectCount<FbxNurbs>(); ii++) {
+    FbxNurbs* pNurbs = pScene->GetSrcObject<FbxNurbs>(ii);
+    addNet(
+        pNurbs,
+        pNurbs->GetUCount(),
+        pNurbs->GetVCount(),
+        pNurbs->GetUOrder() - 1,
+        pNurbs->GetVOrder() - 1,
+        [pNurbs](int u, int v) { pNurbs->SetStep(u, v); });
+  }
+  auto patchDegree = [](FbxPatch::EType type) -> int {
+    return (type == FbxPatch::eLinear) ? 1 : ((type == FbxPatch::eBezierQuadric) ? 2 : 3);
+  };
+  for (int ii = 0; ii < pScene->GetSrcObjectCount<FbxPatch>(); ii++) {
+    FbxPatch* pPatch = pScene->GetSrcObject<FbxPatch>(ii);
+    addNet(
+        pPatch,
+        pPatch->GetUCount(),
+        pPatch->GetVCount(),
+        patchDegree(pPatch->GetPatchUType()),
+        patchDegree(pPatch->GetPatchVType()),
+        [pPatch](int u, int v) { pPatch->SetStep(u, v); });
+  }
+  if (nets.empty()) {
+    return;
+  }
+
+  std::vector<TessellationSteps> steps(nets.size());
+  ParallelUtils::ParallelFor(nets.size(), [&](size_t ii) {
+    steps[ii] = EstimateTessellationSteps(
+        nets[ii],
+        options.tessellationTolerance,
+        options.tessellationMaxEdge,
+        options.tessellationMaxTriangles);
+  });
+
+  for (size_t ii = 0; ii < nets.size(); ii++) {
+    setSteps[ii](steps[ii].u, steps[ii].v);
+    if (verboseOutput) {
+      fmt::printf(
+          "Tessellating %s in %dx%d steps per leg, for about %ld triangles.\n",
+          nets[ii].name,
+          steps[ii].u,
+          steps[ii].v,
+          steps[ii].triangles);
+    }
+  }
+}
+
+/*
+    Read the FBX file into memory if it's compressed: either a gzip stream, or a zip bundle holding
+    the FBX along with its textures. For a plain FBX file, 'bytes' is left empty; the importer is
+    better off reading that from disk itself.
+*/
+static bool ReadCompressedFBXFile(const std::string& fbxFileName, std::vector<uint8_t>& bytes) {
+  if (ArchiveUtils::IsGzipFile(fbxFileName)) {
+    if (verboseOutput) {
+      fmt::printf("Decompressing gzip stream %s...\n", fbxFileName);
+    }
+    return ArchiveUtils::ReadGzipFile(fbxFileName, bytes);
+  }
+  if (ArchiveUtils::IsZipFile(fbxFileName)) {
+    const auto& entries = ArchiveUtils::ListZipEntries(fbxFileName, {"fbx"});
+    if (entries.empty()) {
+      fmt::fprintf(stderr, "ERROR:: Found no FBX file in zip bundle %s.\n", fbxFileName);
+      return false;
+    }
+    if (entries.size() > 1) {
+      fmt::printf(
+          "Warning: Zip bundle %s holds %lu FBX files; converting %s.\n",
+          fbxFileName,
+          entries.size(),
+          entries[0]);
+    } else if (verboseOutput) {
+      fmt::printf("Reading %s from zip bundle %s...\n", entries[0], fbxFileName);
+    }
+    return ArchiveUtils::ReadZipEntry(fbxFileName, entries[0], bytes);
+  }
+  if (ArchiveUtils::IsZstdFile(fbxFileName)) {
+    fmt::fprintf(
+        stderr,
+        "ERROR:: %s is zstd-compressed, which this build can't read; use gzip or zip.\n",
+        fbxFileName);
+    return false;
+  }
+  return true;
+}
+
 bool LoadFBXFile(
     RawModel& raw,
     const std::string fbxFileName,
@@ -1146,7 +1737,24 @@ bool LoadFBXFile(
 
   FbxImporter* pImporter = FbxImporter::Create(pManager, "");
 
-  if (!pImporter->Initialize(fbxFileNameU8.c_str(), -1, pManager->GetIOSettings())) {
+  // compressed input is decompressed into memory and handed to the importer as a stream
+  std::unique_ptr<FbxMemoryStream> fbxStream;
+  std::vector<uint8_t> fbxBytes;
+  if (!ReadCompressedFBXFile(fbxFileName, fbxBytes)) {
+    pImporter->Destroy();
+    pManager->Destroy();
+    return false;
+  }
+  bool initialized;
+  if (!fbxBytes.empty()) {
+    const int readerId = pManager->GetIOPluginRegistry()->FindReaderIDByExtension("fbx");
+    fbxStream.reset(new FbxMemoryStream(std::move(fbxBytes), readerId));
+    initialized =
+        pImporter->Initialize(fbxStream.get(), nullptr, readerId, pManager->GetIOSettings());
+  } else {
+    initialized = pImporter->Initialize(fbxFileNameU8.c_str(), -1, pManager->GetIOSettings());
+  }
+  if (!initialized) {
     if (verboseOutput) {
       fmt::printf("%s\n", pImporter->GetStatus().GetErrorString());
     }
@@ -1165,8 +1773,15 @@ bool LoadFBXFile(
     return false;
   }
 
+  // everything outside the selection is left unread: no triangulation, materials or textures
+  std::unique_ptr<NodeSelection> selection;
+  if (!options.includeNodes.empty() || !options.excludeNodes.empty()) {
+    selection.reset(new NodeSelection());
+    SelectNodes(pScene, options, *selection);
+  }
+
   std::map<const FbxTexture*, FbxString> textureLocations;
-  FindFbxTextures(pScene, fbxFileName, textureExtensions, textureLocations);
+  FindFbxTextures(pScene, fbxFileName, textureExtensions, textureLocations, selection.get());
 
   // Use Y up for glTF
   FbxAxisSystem::MayaYUp.ConvertScene(pScene);
@@ -1183,8 +1798,13 @@ bool LoadFBXFile(
   // this is always 0.01, but let's opt for clarity.
   scaleFactor = FbxSystemUnit::m.GetConversionFactorFrom(FbxSystemUnit::cm);
 
-  ReadNodeHierarchy(raw, pScene, pScene->GetRootNode(), 0, "", -1);
-  ReadNodeAttributes(raw, pScene, pScene->GetRootNode(), textureLocations);
+  if (options.tessellationTolerance > 0 || options.tessellationMaxEdge > 0 ||
+      options.tessellationMaxTriangles > 0) {
+    SetTessellationSteps(pScene, options);
+  }
+
+  ReadNodeHierarchy(raw, pScene, pScene->GetRootNode(), 0, "", -1, selection.get());
+  ReadNodeAttributes(raw, pScene, pScene->GetRootNode(), textureLocations, selection.get());
   ReadAnimations(raw, pScene, options);
 
   pScene->Destroy();
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FbxMemoryStream.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+size_t FbxMemoryStream::Read(void* pData, FbxUInt64 pSize) const {
+  const size_t count = (size_t)std::min<FbxUInt64>(pSize, bytes.size() - position);
+  if (count > 0) {
+    memcpy(pData, &bytes[position], count);
+    position += count;
+  }
+  return count;
+}
+
+char* FbxMemoryStream::ReadString(char* pBuffer, int pMaxSize, bool pStopAtFirstWhiteSpace) {
+  if (pMaxSize <= 0 || position >= (FbxInt64)bytes.size()) {
+    return nullptr;
+  }
+  // like fgets(): read up to and including the end of line, and always null-terminate
+  int count = 0;
+  while (count < pMaxSize - 1 && position < (FbxInt64)bytes.size()) {
+    const char c = (char)bytes[position++];
+    if (pStopAtFirstWhiteSpace && isspace((unsigned char)c)) {
+      break;
+    }
+    pBuffer[count++] = c;
+    if (c == '\n') {
+      break;
+    }
+  }
+  pBuffer[count] = '\0';
+  return pBuffer;
+}
+
+void FbxMemoryStream::Seek(const FbxInt64& pOffset, const FbxFile::ESeekPos& pSeekPos) {
+  FbxInt64 base = 0;
+  switch (pSeekPos) {
+    case FbxFile::eBegin:
+      base = 0;
+      break;
+    case FbxFile::eCurrent:
+      base = position;
+      break;
+    case FbxFile::eEnd:
+      base = bytes.size();
+      break;
+  }
+  position = std::max<FbxInt64>(0, std::min<FbxInt64>(base + pOffset, bytes.size()));
+}
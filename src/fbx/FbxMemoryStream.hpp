@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FBX2glTF.h"
+
+/**
+ * A read-only FbxStream over an FBX file that has already been decompressed into memory, so that
+ * the importer can read it straight out of a gzip stream or zip bundle. The SDK seeks freely about
+ * the file while parsing it, so we need the whole of it in memory; but it never touches the disk.
+ */
+class FbxMemoryStream : public FbxStream {
+ public:
+  FbxMemoryStream(std::vector<uint8_t>&& bytes, int readerId)
+      : bytes(std::move(bytes)), readerId(readerId) {}
+
+  EState GetState() override {
+    return isOpen ? eOpen : eClosed;
+  }
+  bool Open(void* /*pStreamData*/) override {
+    isOpen = true;
+    position = 0;
+    return true;
+  }
+  bool Close() override {
+    isOpen = false;
+    return true;
+  }
+  bool Flush() override {
+    return true;
+  }
+  size_t Write(const void* /*pData*/, FbxUInt64 /*pSize*/) override {
+    return 0;
+  }
+  size_t Read(void* pData, FbxUInt64 pSize) const override;
+  char* ReadString(char* pBuffer, int pMaxSize, bool pStopAtFirstWhiteSpace = false) override;
+
+  int GetReaderID() const override {
+    return readerId;
+  }
+  int GetWriterID() const override {
+    return -1;
+  }
+
+  void Seek(const FbxInt64& pOffset, const FbxFile::ESeekPos& pSeekPos) override;
+  FbxInt64 GetPosition() const override {
+    return position;
+  }
+  void SetPosition(FbxInt64 pPosition) override {
+    Seek(pPosition, FbxFile::eBegin);
+  }
+
+  int GetError() const override {
+    return 0;
+  }
+  void ClearError() override {}
+
+ private:
+  const std::vector<uint8_t> bytes;
+  const int readerId;
+  bool isOpen{false};
+  // Read() is const in the FbxStream interface, but must still advance the position
+  mutable FbxInt64 position{0};
+};
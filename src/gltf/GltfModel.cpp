@@ -8,15 +8,64 @@
 
 #include "GltfModel.hpp"
 
+#include "utils/Archive_Utils.hpp"
+
+// don't bother handing the binary to a writer in pieces smaller than this
+static const size_t STREAM_CHUNK_BYTES = 1024 * 1024;
+
 std::shared_ptr<BufferViewData> GltfModel::GetAlignedBufferView(
     BufferData& buffer,
     const BufferViewData::GL_ArrayType target) {
-  uint32_t bufferSize = to_uint32(this->binary->size());
+  return this->bufferViews.hold(new BufferViewData(buffer, AlignBinary(), target));
+}
+
+uint32_t GltfModel::AlignBinary() {
+  size_t bufferSize = this->binary->size();
   if ((bufferSize % 4) > 0) {
     bufferSize += (4 - (bufferSize % 4));
     this->binary->resize(bufferSize);
   }
-  return this->bufferViews.hold(new BufferViewData(buffer, bufferSize, target));
+  return to_uint32(defaultBuffer->streamedByteLength + bufferSize);
+}
+
+void GltfModel::StreamBinary(AsyncFileWriter& writer, bool flush) {
+  // hand over whole 4-aligned pieces, so that the streamed length keeps the alignment
+  AlignBinary();
+  if (this->binary->empty() || (!flush && this->binary->size() < STREAM_CHUNK_BYTES)) {
+    return;
+  }
+  std::vector<uint8_t> chunk;
+  chunk.swap(*this->binary);
+  defaultBuffer->streamedByteLength += chunk.size();
+  writer.Write(std::move(chunk));
+}
+
+GltfModel::CoalescedBufferView& GltfModel::GetCoalescedBufferView(
+    BufferData& buffer,
+    const BufferViewData::GL_ArrayType target,
+    const unsigned int byteStride) {
+  CoalescedBufferView& coalesced = coalescedBufferViews[std::make_pair(target, byteStride)];
+  if (!coalesced.bufferView) {
+    // the real offset is only known once everything else has been written; see below
+    coalesced.bufferView = this->bufferViews.hold(new BufferViewData(buffer, 0, target));
+    coalesced.bufferView->byteStride = byteStride;
+  }
+  return coalesced;
+}
+
+void GltfModel::FlushCoalescedBufferViews() {
+  for (auto& entry : coalescedBufferViews) {
+    CoalescedBufferView& coalesced = entry.second;
+    if (!coalesced.bufferView) {
+      continue;
+    }
+    coalesced.bufferView->byteOffset = AlignBinary();
+    coalesced.bufferView->byteLength = to_uint32(coalesced.data.size());
+    this->binary->insert(this->binary->end(), coalesced.data.begin(), coalesced.data.end());
+
+    coalesced.data.clear();
+    coalesced.data.shrink_to_fit();
+  }
 }
 
 // add a bufferview on the fly and copy data into it
@@ -44,19 +93,13 @@ std::shared_ptr<BufferViewData> GltfModel::AddBufferViewForFile(
   }
 
   std::shared_ptr<BufferViewData> result;
-  std::ifstream file(filename, std::ios::binary | std::ios::ate);
-  if (file) {
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    std::vector<char> fileBuffer(size);
-    if (file.read(fileBuffer.data(), size)) {
-      result = AddRawBufferView(buffer, fileBuffer.data(), to_uint32(size));
-    } else {
-      fmt::printf("Warning: Couldn't read %lu bytes from %s, skipping file.\n", size, filename);
-    }
+  // the file may also live inside a zip bundle, next to the FBX itself
+  std::vector<uint8_t> fileBuffer;
+  if (ArchiveUtils::ReadFile(filename, fileBuffer)) {
+    result = AddRawBufferView(
+        buffer, (const char*)fileBuffer.data(), to_uint32(fileBuffer.size()));
   } else {
-    fmt::printf("Warning: Couldn't open file %s, skipping file.\n", filename);
+    fmt::printf("Warning: Couldn't read file %s, skipping file.\n", filename);
   }
   // note that we persist here not only success, but also failure, as nullptr
   filenameToBufferView[filename] = result;
@@ -28,6 +28,9 @@
 #include "gltf/properties/SkinData.hpp"
 #include "gltf/properties/TextureData.hpp"
 
+#include "utils/Archive_Writer.hpp"
+#include "utils/Async_Writer.hpp"
+
 /**
  * glTF 2.0 is based on the idea that data structs within a file are referenced by index; an
  * accessor will point to the n:th buffer view, and so on. The Holder class takes a freshly
@@ -55,6 +58,7 @@ class GltfModel {
   explicit GltfModel(const GltfOptions& options)
       : binary(new std::vector<uint8_t>),
         isGlb(options.outputBinary),
+        coalesceBufferViews(options.coalesceBufferViews),
         defaultSampler(nullptr),
         defaultBuffer(buffers.hold(buildDefaultBuffer(options))) {
     defaultSampler = samplers.hold(buildDefaultSampler());
@@ -121,11 +125,53 @@ class GltfModel {
     return accessor;
   }
 
+  /**
+   * Add an accessor for the given data, bound for the given target. Normally this creates a new
+   * buffer view for the accessor; with coalesceBufferViews, the data is instead staged in the one
+   * shared buffer view for that target, and addressed through the accessor's byteOffset. Vertex
+   * attributes sharing a view need it to declare their byteStride, so those get one shared view
+   * per element size instead.
+   */
+  template <class T>
+  std::shared_ptr<AccessorData> AddAccessorForTarget(
+      BufferData& buffer,
+      const BufferViewData::GL_ArrayType target,
+      const GLType& type,
+      const std::vector<T>& source,
+      std::string name) {
+    if (!coalesceBufferViews) {
+      auto bufferView = GetAlignedBufferView(buffer, target);
+      return AddAccessorWithView(*bufferView, type, source, name);
+    }
+    // vertex attributes must also keep each element 4-aligned, so their stride is padded to suit
+    const unsigned int stride = (target == BufferViewData::GL_ARRAY_BUFFER)
+        ? (type.byteStride() + 3) & ~3u
+        : type.byteStride();
+    CoalescedBufferView& coalesced = GetCoalescedBufferView(
+        buffer, target, (target == BufferViewData::GL_ARRAY_BUFFER) ? stride : 0);
+
+    // keep every accessor 4-aligned; vertex attributes require it, and it suits all other types
+    std::vector<uint8_t>& data = coalesced.data;
+    if ((data.size() % 4) > 0) {
+      data.resize(data.size() + (4 - (data.size() % 4)));
+    }
+    const size_t byteOffset = data.size();
+    data.resize(byteOffset + source.size() * stride);
+    for (size_t ii = 0; ii < source.size(); ii++) {
+      type.write(&data[byteOffset + ii * stride], source[ii]);
+    }
+
+    auto accessor = accessors.hold(new AccessorData(*coalesced.bufferView, type, name));
+    accessor->byteOffset = to_uint32(byteOffset);
+    accessor->count = to_uint32(source.size());
+    return accessor;
+  }
+
   template <class T>
   std::shared_ptr<AccessorData>
   AddAccessorAndView(BufferData& buffer, const GLType& type, const std::vector<T>& source) {
-    auto bufferView = GetAlignedBufferView(buffer, BufferViewData::GL_ARRAY_NONE);
-    return AddAccessorWithView(*bufferView, type, source, std::string(""));
+    return AddAccessorForTarget(
+        buffer, BufferViewData::GL_ARRAY_NONE, type, source, std::string(""));
   }
 
   template <class T>
@@ -134,10 +180,22 @@ class GltfModel {
       const GLType& type,
       const std::vector<T>& source,
       std::string name) {
-    auto bufferView = GetAlignedBufferView(buffer, BufferViewData::GL_ARRAY_NONE);
-    return AddAccessorWithView(*bufferView, type, source, name);
+    return AddAccessorForTarget(buffer, BufferViewData::GL_ARRAY_NONE, type, source, name);
   }
 
+  /**
+   * Append the data staged for the coalesced buffer views to the binary, and fix their offsets.
+   * Must be called once all accessors have been added, and before the binary is serialized.
+   */
+  void FlushCoalescedBufferViews();
+
+  /**
+   * Hand the binary data built up so far to the writer, once there's enough of it or if flush is
+   * set. The offsets of buffer views still count from the start of the buffer; only the bytes
+   * themselves leave memory. Meaningless for .glb or embedded output, which need all of it.
+   */
+  void StreamBinary(AsyncFileWriter& writer, bool flush = false);
+
   template <class T>
   std::shared_ptr<AccessorData> AddAttributeToPrimitive(
       BufferData& buffer,
@@ -155,8 +213,8 @@ class GltfModel {
       accessor = accessors.hold(new AccessorData(attrDef.glType));
       accessor->count = to_uint32(attribArr.size());
     } else {
-      auto bufferView = GetAlignedBufferView(buffer, BufferViewData::GL_ARRAY_BUFFER);
-      accessor = AddAccessorWithView(*bufferView, attrDef.glType, attribArr, std::string(""));
+      accessor = AddAccessorForTarget(
+          buffer, BufferViewData::GL_ARRAY_BUFFER, attrDef.glType, attribArr, std::string(""));
     }
     primitive.AddAttrib(attrDef.gltfName, *accessor);
     return accessor;
@@ -179,8 +237,8 @@ class GltfModel {
       accessor = accessors.hold(new AccessorData(attrDef.glType));
       accessor->count = attribArr.size();
     } else {
-      auto bufferView = GetAlignedBufferView(buffer, BufferViewData::GL_ARRAY_BUFFER);
-      accessor = AddAccessorWithView(*bufferView, attrDef.glType, attribArr, std::string(""));
+      accessor = AddAccessorForTarget(
+          buffer, BufferViewData::GL_ARRAY_BUFFER, attrDef.glType, attribArr, std::string(""));
     }
     primitive.AddAttrib(attrDef.gltfName, *accessor);
     return accessor;
@@ -200,6 +258,10 @@ class GltfModel {
   void serializeHolders(json& glTFJson);
 
   const bool isGlb;
+  const bool coalesceBufferViews;
+
+  // if set, image files go into this archive rather than the output folder
+  ArchiveWriter* archive{nullptr};
 
   // cache BufferViewData instances that've already been created from a given filename
   std::map<std::string, std::shared_ptr<BufferViewData>> filenameToBufferView;
@@ -225,6 +287,24 @@ class GltfModel {
   std::shared_ptr<BufferData> defaultBuffer;
 
  private:
+  // pad the binary to 4-byte alignment, and return its full length, streamed bytes included
+  uint32_t AlignBinary();
+
+  // a buffer view shared by all accessors of one target and byteStride, and the data staged for it
+  struct CoalescedBufferView {
+    std::shared_ptr<BufferViewData> bufferView;
+    std::vector<uint8_t> data;
+  };
+
+  // byteStride is 0 for views that don't declare one
+  CoalescedBufferView& GetCoalescedBufferView(
+      BufferData& buffer,
+      const BufferViewData::GL_ArrayType target,
+      unsigned int byteStride);
+
+  std::map<std::pair<BufferViewData::GL_ArrayType, unsigned int>, CoalescedBufferView>
+      coalescedBufferViews;
+
   SamplerData* buildDefaultSampler() {
     return new SamplerData();
   }
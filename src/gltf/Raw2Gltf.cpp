@@ -8,16 +8,21 @@
 
 #include "Raw2Gltf.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <limits>
 
 #include <stb_image.h>
 #include <stb_image_write.h>
 
 #include <utils/File_Utils.hpp>
+#include "utils/Hash_Utils.hpp"
 #include "utils/Image_Utils.hpp"
+#include "utils/Parallel_Utils.hpp"
 #include "utils/String_Utils.hpp"
 
 #include "raw/RawModel.hpp"
@@ -76,11 +81,219 @@ static const std::vector<TriangleIndex> getIndexArray(const RawModel& raw) {
   return result;
 }
 
+/**
+ * The canonical view directions to presort transparent primitives for, each pointing from the mesh
+ * towards the viewer: the 6 axes, then with 14 also the 8 cube corners, and with 26 also the 12
+ * cube edges.
+ */
+static std::vector<Vec3f> getSortViewDirections(int count) {
+  std::vector<Vec3f> result;
+  for (int axes : {1, 3, 2}) {
+    if ((axes == 3 && count < 14) || (axes == 2 && count < 26)) {
+      break;
+    }
+    for (int x = -1; x <= 1; x++) {
+      for (int y = -1; y <= 1; y++) {
+        for (int z = -1; z <= 1; z++) {
+          if ((x != 0) + (y != 0) + (z != 0) == axes) {
+            result.push_back(Vec3f((float)x, (float)y, (float)z).Normalized());
+          }
+        }
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ * The model's triangles as seen from each direction, in draw order: back to front by how far
+ * their centroids lie along the direction, ties broken by triangle order.
+ */
+static std::vector<std::vector<TriangleIndex>> getViewSortedIndexArrays(
+    const RawModel& raw,
+    const std::vector<Vec3f>& directions) {
+  const int triangleCount = raw.GetTriangleCount();
+  std::vector<Vec3f> centroids(triangleCount);
+  for (int ii = 0; ii < triangleCount; ii++) {
+    const RawTriangle& triangle = raw.GetTriangle(ii);
+    centroids[ii] = (raw.GetVertex(triangle.verts[0]).position +
+                     raw.GetVertex(triangle.verts[1]).position +
+                     raw.GetVertex(triangle.verts[2]).position) /
+        3.0f;
+  }
+
+  std::vector<std::vector<TriangleIndex>> result;
+  std::vector<float> distances(triangleCount);
+  std::vector<int> order(triangleCount);
+  for (const Vec3f& direction : directions) {
+    for (int ii = 0; ii < triangleCount; ii++) {
+      distances[ii] = Vec3f::DotProduct(centroids[ii], direction);
+      order[ii] = ii;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return distances[a] < distances[b] || (distances[a] == distances[b] && a < b);
+    });
+    std::vector<TriangleIndex> indices;
+    indices.reserve(3 * (size_t)triangleCount);
+    for (const int triIx : order) {
+      for (int vv = 0; vv < 3; vv++) {
+        indices.push_back((TriangleIndex)raw.GetTriangle(triIx).verts[vv]);
+      }
+    }
+    result.push_back(std::move(indices));
+  }
+  return result;
+}
+
+/**
+ * Per surface, how many output vertices only exist because some attribute kept them from merging
+ * with another at the same position, and which attributes those were.
+ */
+static void reportVertexSplits(const std::vector<RawModel>& materialModels) {
+  std::vector<std::pair<long, std::string>> surfaceNames;
+  std::map<long, RawVertexSplits> splitsById;
+  std::vector<RawVertexSplits> modelSplits;
+  for (const RawModel& model : materialModels) {
+    model.GetVertexSplits(modelSplits);
+    for (int surfaceIx = 0; surfaceIx < model.GetSurfaceCount(); surfaceIx++) {
+      const RawSurface& surface = model.GetSurface(surfaceIx);
+      if (splitsById.count(surface.id) == 0) {
+        surfaceNames.emplace_back(surface.id, surface.name);
+      }
+      RawVertexSplits& total = splitsById[surface.id];
+      total.vertexCount += modelSplits[surfaceIx].vertexCount;
+      total.triangleCount += modelSplits[surfaceIx].triangleCount;
+      total.splitCount += modelSplits[surfaceIx].splitCount;
+      for (int cause = 0; cause < RAW_VERTEX_SPLIT_CAUSE_COUNT; cause++) {
+        total.causes[cause] += modelSplits[surfaceIx].causes[cause];
+      }
+    }
+  }
+  std::stable_sort(
+      surfaceNames.begin(),
+      surfaceNames.end(),
+      [&](const std::pair<long, std::string>& a, const std::pair<long, std::string>& b) {
+        return splitsById[a.first].splitCount > splitsById[b.first].splitCount;
+      });
+
+  for (const auto& surfaceName : surfaceNames) {
+    const RawVertexSplits& splits = splitsById[surfaceName.first];
+    if (splits.splitCount == 0) {
+      break;
+    }
+    std::string causes;
+    for (int cause = 0; cause < RAW_VERTEX_SPLIT_CAUSE_COUNT; cause++) {
+      if (splits.causes[cause] > 0) {
+        causes += fmt::sprintf(
+            "%s%s %d",
+            causes.empty() ? "" : ", ",
+            Describe((RawVertexSplitCause)cause),
+            splits.causes[cause]);
+      }
+    }
+    fmt::printf(
+        "Surface %s: %d vertices for %d triangles, %d split off by %s\n",
+        surfaceName.second,
+        splits.vertexCount,
+        splits.triangleCount,
+        splits.splitCount,
+        causes.empty() ? "nothing" : causes);
+  }
+}
+
+/**
+ * Quantize unit quaternions as normalized signed integers, the way glTF decodes them back:
+ * max(c / MAX, -1). Reports the largest rotation, in degrees, between a quaternion and its decoded,
+ * renormalized counterpart.
+ */
+template <typename T>
+static std::vector<mathfu::Vector<T, 4>> quantizeRotations(
+    const std::vector<Quatf>& rotations,
+    float& maxErrorDegrees) {
+  const float scale = (float)std::numeric_limits<T>::max();
+  std::vector<mathfu::Vector<T, 4>> result;
+  maxErrorDegrees = 0.0f;
+  for (const Quatf& rotation : rotations) {
+    Vec4f q(rotation.vector()[0], rotation.vector()[1], rotation.vector()[2], rotation.scalar());
+    const float length = q.Length();
+    q = (length > 0.0f) ? q / length : Vec4f(0, 0, 0, 1);
+    mathfu::Vector<T, 4> quantized;
+    Vec4f decoded;
+    for (int ii = 0; ii < 4; ii++) {
+      quantized[ii] = (T)std::round(q[ii] * scale);
+      decoded[ii] = std::max(quantized[ii] / scale, -1.0f);
+    }
+    const float decodedLength = decoded.Length();
+    const float dot = (decodedLength > 0.0f) ? Vec4f::DotProduct(q, decoded) / decodedLength : 0.0f;
+    maxErrorDegrees = std::max(
+        maxErrorDegrees, 2.0f * std::acos(std::min(1.0f, std::fabs(dot))) * 180.0f / (float)M_PI);
+    result.push_back(quantized);
+  }
+  return result;
+}
+
+/**
+ * Quantize weights in [0, 1] as normalized unsigned integers up to maxValue, reporting the largest
+ * difference between a weight and its decoded counterpart.
+ */
+static std::vector<uint32_t>
+quantizeWeights(const std::vector<float>& weights, uint32_t maxValue, float& maxError) {
+  std::vector<uint32_t> result;
+  maxError = 0.0f;
+  for (const float weight : weights) {
+    const uint32_t quantized = (uint32_t)std::round(weight * maxValue);
+    maxError = std::max(maxError, std::fabs(weight - quantized / (float)maxValue));
+    result.push_back(quantized);
+  }
+  return result;
+}
+
+static json describeBounds(const Boundsf& box, float radius) {
+  return {{"min", toStdVec(box.min)},
+          {"max", toStdVec(box.max)},
+          {"center", toStdVec((box.min + box.max) * 0.5f)},
+          {"radius", radius}};
+}
+
+std::string WriteSharedAsset(
+    const GltfOptions& options,
+    const std::string& outputFolder,
+    const std::vector<uint8_t>& bytes,
+    const std::string& suffix) {
+  // the folder is shared by every model converted into it, so the name must be a digest no two
+  // contents can share, accidentally or otherwise
+  const std::string fileName = HashUtils::Sha256(bytes.data(), bytes.size()) +
+      (suffix.empty() ? "" : "." + StringUtils::ToLower(suffix));
+  const std::string path = options.sharedAssetsDir + "/" + fileName;
+  const std::string uri =
+      FileUtils::GetRelativePath(path, outputFolder.empty() ? "." : outputFolder);
+  if (uri.empty()) {
+    // an absolute filesystem path is no URI
+    fmt::printf(
+        "Warning: Shared asset %s can't be reached by a relative path from the output folder.\n",
+        path);
+    return "";
+  }
+  if (FileUtils::FileExists(path)) {
+    if (verboseOutput) {
+      fmt::printf("Shared asset already present: %s\n", path);
+    }
+  } else if (FileUtils::WriteFileAtomically(path, bytes)) {
+    if (verboseOutput) {
+      fmt::printf("Wrote %lu bytes to shared asset: %s\n", bytes.size(), path);
+    }
+  } else {
+    return "";
+  }
+  return uri;
+}
+
 ModelData* Raw2Gltf(
-    std::ofstream& gltfOutStream,
+    std::ostream& gltfOutStream,
     const std::string& outputFolder,
     const RawModel& raw,
-    const GltfOptions& options) {
+    const GltfOptions& options,
+    ArchiveWriter* archive) {
   if (verboseOutput) {
     fmt::printf("Building render model...\n");
     for (int i = 0; i < raw.GetMaterialCount(); i++) {
@@ -92,7 +305,7 @@ ModelData* Raw2Gltf(
     }
     if (raw.GetVertexCount() > 2 * raw.GetTriangleCount()) {
       fmt::printf(
-          "Warning: High vertex count. Make sure there are no unnecessary vertex attributes. (see -keepAttribute cmd-line option)");
+          "Warning: High vertex count. Make sure there are no unnecessary vertex attributes. (see --keep-attribute cmd-line option)\n");
     }
   }
 
@@ -112,9 +325,11 @@ ModelData* Raw2Gltf(
     fmt::printf("%7d animations\n", raw.GetAnimationCount());
     fmt::printf("%7d cameras\n", raw.GetCameraCount());
     fmt::printf("%7d lights\n", raw.GetLightCount());
+    reportVertexSplits(materialModels);
   }
 
   std::unique_ptr<GltfModel> gltf(new GltfModel(options));
+  gltf->archive = archive;
 
   std::map<long, std::shared_ptr<NodeData>> nodesById;
   std::map<long, std::shared_ptr<MaterialData>> materialsById;
@@ -124,11 +339,40 @@ ModelData* Raw2Gltf(
   // for now, we only have one buffer; data->binary points to the same vector as that BufferData
   // does.
   BufferData& buffer = *gltf->defaultBuffer;
+
+  // with an external buffer file, finished binary data is written out while we work on the rest;
+  // one named by its content can't be, as the name isn't known until the end
+  const bool sharedBuffer = !options.sharedAssetsDir.empty() && options.sharedBuffers &&
+      !options.outputBinary && !options.embedResources && archive == nullptr;
+  std::unique_ptr<AsyncFileWriter> binaryWriter;
+  if (!options.outputBinary && !options.embedResources && archive == nullptr && !sharedBuffer) {
+    const std::string binaryPath = outputFolder + extBufferFilename;
+    binaryWriter.reset(new AsyncFileWriter(binaryPath));
+    if (!binaryWriter->IsOpen()) {
+      fmt::fprintf(stderr, "ERROR:: Couldn't open file '%s' for writing.\n", binaryPath);
+      return nullptr;
+    }
+  }
+
+  // Draco is free to reorder the vertices, so presorted indices couldn't refer to them
+  std::vector<Vec3f> sortViewDirections;
+  if (options.transparentSortViews > 0 && options.draco.enabled) {
+    fmt::printf("Warning: --transparent-sort-views is ignored with Draco compression.\n");
+  } else {
+    sortViewDirections = getSortViewDirections(options.transparentSortViews);
+  }
+  int viewSortedPrimitives = 0;
+
   {
     //
     // nodes
     //
 
+    std::vector<RawNodeBounds> nodeBounds;
+    if (options.nodeBounds) {
+      nodeBounds = raw.ComputeSubtreeBounds();
+    }
+
     for (int i = 0; i < raw.GetNodeCount(); i++) {
       // assumption: RawNode index == NodeData index
       const RawNode& node = raw.GetNode(i);
@@ -139,6 +383,11 @@ ModelData* Raw2Gltf(
       if (options.enableUserProperties) {
         nodeData->userProperties = node.userProperties;
       }
+      if (!nodeBounds.empty() && nodeBounds[i].world.initialized) {
+        nodeData->extras["bounds"] = {
+            {"world", describeBounds(nodeBounds[i].world, nodeBounds[i].worldRadius)},
+            {"local", describeBounds(nodeBounds[i].local, nodeBounds[i].localRadius)}};
+      }
 
       for (const auto& childId : node.childIds) {
         int childIx = raw.GetNodeById(childId);
@@ -199,20 +448,66 @@ ModelData* Raw2Gltf(
               "translation");
         }
         if (!channel.rotations.empty()) {
-          aDat.AddNodeChannel(
-              nDat, *gltf->AddAccessorAndView(buffer, GLT_QUATF, channel.rotations), "rotation");
+          std::shared_ptr<AccessorData> accessor;
+          float error = 0.0f;
+          switch (options.animationRotationPrecision) {
+            case AnimationPrecisionOptions::SHORT:
+              accessor = gltf->AddAccessorAndView(
+                  buffer, GLT_QUATS, quantizeRotations<int16_t>(channel.rotations, error));
+              accessor->normalized = true;
+              break;
+            case AnimationPrecisionOptions::BYTE:
+              accessor = gltf->AddAccessorAndView(
+                  buffer, GLT_QUATB, quantizeRotations<int8_t>(channel.rotations, error));
+              accessor->normalized = true;
+              break;
+            case AnimationPrecisionOptions::FLOAT:
+              accessor = gltf->AddAccessorAndView(buffer, GLT_QUATF, channel.rotations);
+              break;
+          }
+          aDat.AddNodeChannel(nDat, *accessor, "rotation");
+          if (verboseOutput && accessor->normalized) {
+            fmt::printf("    rotations quantized to within %.3f degrees\n", error);
+          }
         }
         if (!channel.scales.empty()) {
           aDat.AddNodeChannel(
               nDat, *gltf->AddAccessorAndView(buffer, GLT_VEC3F, channel.scales), "scale");
         }
         if (!channel.weights.empty()) {
-          aDat.AddNodeChannel(
-              nDat,
-              *gltf->AddAccessorAndView(buffer, {CT_FLOAT, 1, "SCALAR"}, channel.weights),
-              "weights");
+          // normalized unsigned integers can't hold weights outside [0, 1]
+          const auto range = std::minmax_element(channel.weights.begin(), channel.weights.end());
+          const bool inRange = *range.first >= 0.0f && *range.second <= 1.0f;
+          std::shared_ptr<AccessorData> accessor;
+          float error = 0.0f;
+          if (inRange && options.animationWeightPrecision == AnimationPrecisionOptions::SHORT) {
+            accessor = gltf->AddAccessorAndView(
+                buffer, GLT_USHORT, quantizeWeights(channel.weights, 0xFFFF, error));
+            accessor->normalized = true;
+          } else if (
+              inRange && options.animationWeightPrecision == AnimationPrecisionOptions::BYTE) {
+            accessor = gltf->AddAccessorAndView(
+                buffer, GLT_UBYTE, quantizeWeights(channel.weights, 0xFF, error));
+            accessor->normalized = true;
+          } else {
+            accessor = gltf->AddAccessorAndView(buffer, GLT_FLOAT, channel.weights);
+          }
+          aDat.AddNodeChannel(nDat, *accessor, "weights");
+          if (verboseOutput && accessor->normalized) {
+            fmt::printf("    weights quantized to within %.5f\n", error);
+          } else if (
+              verboseOutput &&
+              options.animationWeightPrecision != AnimationPrecisionOptions::FLOAT) {
+            fmt::printf(
+                "    weights kept as floats; they range over [%g, %g]\n",
+                *range.first,
+                *range.second);
+          }
         }
       }
+      if (binaryWriter) {
+        gltf->StreamBinary(*binaryWriter);
+      }
     }
 
     //
@@ -346,7 +641,15 @@ ModelData* Raw2Gltf(
                        metallic,
                        1}};
                 },
-                false);
+                false,
+                fmt::format(
+                    "orm|{}|{}|{}|{}|{}|{}",
+                    hasOcclusionMap,
+                    hasRoughnessMap,
+                    hasMetallicMap,
+                    props->roughness,
+                    props->metallic,
+                    props->invertRoughnessMap));
             if (aoMetRoughTex && verboseOutput) {
               fmt::printf(
                   "Material %s: detected multiple ORM textures, combined: [%s, %s, %s] into [%s]\n",
@@ -399,7 +702,8 @@ ModelData* Raw2Gltf(
                   float shininess = props->shininess * (*pixels[0])[0];
                   return {{0, getRoughness(shininess), metallic, 1}};
                 },
-                false);
+                false,
+                fmt::format("shininess|{}|{}", props->shininess, metallic));
 
             if (aoMetRoughTex != nullptr) {
               // if we successfully built a texture, factors are just multiplicative identity
@@ -472,7 +776,56 @@ ModelData* Raw2Gltf(
       }
     }
 
-    for (const auto& surfaceModel : materialModels) {
+    //
+    // impostors, as the last MSFT_lod level of the nodes they stand in for
+    //
+
+    for (int i = 0; i < raw.GetImpostorCount(); i++) {
+      const RawImpostor& impostor = raw.GetImpostor(i);
+      NodeData& nodeData = require(nodesById, impostor.nodeId);
+      const NodeData& impostorData = require(nodesById, impostor.impostorNodeId);
+      nodeData.lods.push_back(impostorData.ix);
+      nodeData.extras["impostor"] = {
+          {"layout", "octahedral"},
+          {"frames", impostor.frames},
+          {"frameSize", impostor.frameSize},
+          {"center", toStdVec(impostor.center)},
+          {"radius", impostor.radius},
+          {"node", impostorData.ix}};
+      const std::shared_ptr<TextureData> normalDepth =
+          textureBuilder.simple(impostor.normalDepthTexture, "simple");
+      if (normalDepth) {
+        nodeData.extras["impostor"]["normalDepthTexture"] = normalDepth->ix;
+      }
+    }
+    textureBuilder.reportPngOptimization();
+
+    // presort the transparent surfaces for every view direction, in parallel as they're independent
+    std::vector<std::vector<std::vector<TriangleIndex>>> viewSortedIndices(materialModels.size());
+    if (!sortViewDirections.empty()) {
+      ParallelUtils::ParallelFor(materialModels.size(), [&](size_t ii) {
+        const RawModel& surfaceModel = materialModels[ii];
+        const RawMaterialType type =
+            surfaceModel.GetMaterial(surfaceModel.GetTriangle(0).materialIndex).type;
+        if (type == RAW_MATERIAL_TYPE_TRANSPARENT ||
+            type == RAW_MATERIAL_TYPE_SKINNED_TRANSPARENT) {
+          viewSortedIndices[ii] = getViewSortedIndexArrays(surfaceModel, sortViewDirections);
+        }
+      });
+      if (verboseOutput) {
+        size_t sortedCount = 0;
+        for (const auto& sorted : viewSortedIndices) {
+          sortedCount += sorted.empty() ? 0 : 1;
+        }
+        fmt::printf(
+            "Presorted %lu transparent surfaces for %lu view directions.\n",
+            sortedCount,
+            sortViewDirections.size());
+      }
+    }
+
+    for (size_t surfaceIx = 0; surfaceIx < materialModels.size(); surfaceIx++) {
+      const RawModel& surfaceModel = materialModels[surfaceIx];
       assert(surfaceModel.GetSurfaceCount() == 1);
       const RawSurface& rawSurface = surfaceModel.GetSurface(0);
       const long surfaceId = rawSurface.id;
@@ -525,12 +878,25 @@ ModelData* Raw2Gltf(
         indexes.count = to_uint32(3 * triangleCount);
         primitive.reset(new PrimitiveData(indexes, mData, dracoMesh));
       } else {
-        const AccessorData& indexes = *gltf->AddAccessorWithView(
-            *gltf->GetAlignedBufferView(buffer, BufferViewData::GL_ELEMENT_ARRAY_BUFFER),
+        const AccessorData& indexes = *gltf->AddAccessorForTarget(
+            buffer,
+            BufferViewData::GL_ELEMENT_ARRAY_BUFFER,
             useLongIndices ? GLT_UINT : GLT_USHORT,
             getIndexArray(surfaceModel),
             std::string(""));
         primitive.reset(new PrimitiveData(indexes, mData));
+        for (const auto& sortedIndices : viewSortedIndices[surfaceIx]) {
+          const AccessorData& sortedIndexes = *gltf->AddAccessorForTarget(
+              buffer,
+              BufferViewData::GL_ELEMENT_ARRAY_BUFFER,
+              useLongIndices ? GLT_UINT : GLT_USHORT,
+              sortedIndices,
+              std::string(""));
+          primitive->viewSortedIndices.push_back(sortedIndexes.ix);
+        }
+        if (!viewSortedIndices[surfaceIx].empty()) {
+          viewSortedPrimitives++;
+        }
       };
 
       //
@@ -750,21 +1116,24 @@ ModelData* Raw2Gltf(
               }
             }
           } else {
-            pAcc = gltf->AddAccessorWithView(
-                *gltf->GetAlignedBufferView(buffer, BufferViewData::GL_ARRAY_BUFFER),
+            pAcc = gltf->AddAccessorForTarget(
+                buffer,
+                BufferViewData::GL_ARRAY_BUFFER,
                 GLT_VEC3F,
                 positions,
                 channel.name);
             if (!normals.empty()) {
-              nAcc = gltf->AddAccessorWithView(
-                  *gltf->GetAlignedBufferView(buffer, BufferViewData::GL_ARRAY_BUFFER),
+              nAcc = gltf->AddAccessorForTarget(
+                  buffer,
+                  BufferViewData::GL_ARRAY_BUFFER,
                   GLT_VEC3F,
                   normals,
                   channel.name);
             }
             if (!tangents.empty()) {
-              nAcc = gltf->AddAccessorWithView(
-                  *gltf->GetAlignedBufferView(buffer, BufferViewData::GL_ARRAY_BUFFER),
+              nAcc = gltf->AddAccessorForTarget(
+                  buffer,
+                  BufferViewData::GL_ARRAY_BUFFER,
                   GLT_VEC4F,
                   tangents,
                   channel.name);
@@ -814,6 +1183,9 @@ ModelData* Raw2Gltf(
         primitive->NoteDracoBuffer(*view);
       }
       mesh->AddPrimitive(primitive);
+      if (binaryWriter) {
+        gltf->StreamBinary(*binaryWriter);
+      }
     }
 
     //
@@ -861,6 +1233,66 @@ ModelData* Raw2Gltf(
       }
     }
 
+    // collision shapes and occluders are plain triangles, in meshes no node renders
+    auto addUnrenderedPrimitive = [&](MeshData& mesh,
+                                      const std::vector<Vec3f>& positions,
+                                      const std::vector<uint32_t>& indices) {
+      const bool useLongIndices = (options.useLongIndices == UseLongIndicesOptions::ALWAYS) ||
+          positions.size() > 65535;
+      const AccessorData& indexes = *gltf->AddAccessorForTarget(
+          buffer,
+          BufferViewData::GL_ELEMENT_ARRAY_BUFFER,
+          useLongIndices ? GLT_UINT : GLT_USHORT,
+          indices,
+          std::string(""));
+      std::shared_ptr<PrimitiveData> primitive(new PrimitiveData(indexes));
+
+      Bounds<float, 3> bounds;
+      for (const Vec3f& position : positions) {
+        bounds.AddPoint(position);
+      }
+      auto accessor = gltf->AddAccessorForTarget(
+          buffer, BufferViewData::GL_ARRAY_BUFFER, GLT_VEC3F, positions, std::string(""));
+      accessor->min = toStdVec(bounds.min);
+      accessor->max = toStdVec(bounds.max);
+      primitive->AddAttrib("POSITION", *accessor);
+      mesh.AddPrimitive(primitive);
+      if (binaryWriter) {
+        gltf->StreamBinary(*binaryWriter);
+      }
+    };
+
+    //
+    // collision shapes, named in their nodes' extras
+    //
+
+    for (int i = 0; i < raw.GetCollisionShapeCount(); i++) {
+      const RawCollisionShape& shape = raw.GetCollisionShape(i);
+      NodeData& nodeData = require(nodesById, shape.nodeId);
+      MeshData& mesh = *gltf->meshes.hold(new MeshData(nodeData.name + "_collision", {}));
+      for (const RawCollisionPart& part : shape.parts) {
+        addUnrenderedPrimitive(mesh, part.positions, part.indices);
+      }
+      nodeData.extras["collision"] = {{"shape", Describe(shape.shape)}, {"mesh", mesh.ix}};
+    }
+
+    //
+    // occluders, marked as such and named in the extras of every node showing their surface
+    //
+
+    for (int i = 0; i < raw.GetOccluderCount(); i++) {
+      const RawOccluder& occluder = raw.GetOccluder(i);
+      const RawSurface& rawSurface = raw.GetSurface(raw.GetSurfaceById(occluder.surfaceId));
+      MeshData& mesh = *gltf->meshes.hold(new MeshData(rawSurface.name + "_occluder", {}));
+      addUnrenderedPrimitive(mesh, occluder.positions, occluder.indices);
+      mesh.extras["occluder"] = true;
+      for (int j = 0; j < raw.GetNodeCount(); j++) {
+        if (raw.GetNode(j).surfaceId == occluder.surfaceId) {
+          gltf->nodes.ptrs[j]->extras["occluder"] = mesh.ix;
+        }
+      }
+    }
+
     std::vector<std::vector<uint32_t>> extraJointIndexes;
     extraJointIndexes.resize(raw.GetExtraSkinCount());
     for (int i = 0; i < raw.GetNodeCount(); i++) {
@@ -947,6 +1379,19 @@ ModelData* Raw2Gltf(
     }
   }
 
+  gltf->FlushCoalescedBufferViews();
+  if (binaryWriter) {
+    gltf->StreamBinary(*binaryWriter, true);
+  }
+  if (sharedBuffer) {
+    buffer.uri = WriteSharedAsset(options, outputFolder, *gltf->binary, "bin");
+    if (buffer.uri.empty()) {
+      fmt::fprintf(
+          stderr, "ERROR: Failed to write binary data to '%s'.\n", options.sharedAssetsDir);
+      return nullptr;
+    }
+  }
+
   NodeData& rootNode = require(nodesById, raw.GetRootNode());
   const SceneData& rootScene = *gltf->scenes.hold(new SceneData(DEFAULT_SCENE_NAME, rootNode));
 
@@ -990,6 +1435,12 @@ ModelData* Raw2Gltf(
     if (!gltf->lights.ptrs.empty()) {
       extensionsUsed.push_back(KHR_LIGHTS_PUNCTUAL);
     }
+    if (raw.GetImpostorCount() > 0) {
+      extensionsUsed.push_back(MSFT_LOD);
+    }
+    if (viewSortedPrimitives > 0) {
+      extensionsUsed.push_back(FB_VIEW_SORTED_INDICES);
+    }
     if (options.draco.enabled) {
       extensionsUsed.push_back(KHR_DRACO_MESH_COMPRESSION);
       extensionsRequired.push_back(KHR_DRACO_MESH_COMPRESSION);
@@ -1004,6 +1455,13 @@ ModelData* Raw2Gltf(
     if (!extensionsRequired.empty()) {
       glTFJson["extensionsRequired"] = extensionsRequired;
     }
+    if (viewSortedPrimitives > 0) {
+      json directions = json::array();
+      for (const Vec3f& direction : sortViewDirections) {
+        directions.push_back(toStdVec(direction));
+      }
+      glTFJson["extensions"][FB_VIEW_SORTED_INDICES] = {{"directions", directions}};
+    }
 
     gltf->serializeHolders(glTFJson);
 
@@ -1068,5 +1526,14 @@ ModelData* Raw2Gltf(
     gltfOutStream.seekp(0, std::ios::end);
   }
 
-  return new ModelData(gltf->binary);
+  ModelData* modelData = new ModelData(gltf->binary);
+  if (binaryWriter) {
+    if (!binaryWriter->Close()) {
+      fmt::fprintf(stderr, "ERROR: Failed to write binary data to '%s'.\n", extBufferFilename);
+      delete modelData;
+      return nullptr;
+    }
+    modelData->streamedBinaryBytes = binaryWriter->GetBytesWritten();
+  }
+  return modelData;
 }
@@ -21,6 +21,8 @@
 const std::string KHR_DRACO_MESH_COMPRESSION = "KHR_draco_mesh_compression";
 const std::string KHR_MATERIALS_CMN_UNLIT = "KHR_materials_unlit";
 const std::string KHR_LIGHTS_PUNCTUAL = "KHR_lights_punctual";
+const std::string MSFT_LOD = "MSFT_lod";
+const std::string FB_VIEW_SORTED_INDICES = "FB_view_sorted_indices";
 
 const std::string extBufferFilename = "buffer.bin";
 
@@ -40,6 +42,9 @@ struct ComponentType {
   const unsigned int size;
 };
 
+const ComponentType CT_BYTE = {ComponentType::GL_BYTE, 1};
+const ComponentType CT_UBYTE = {ComponentType::GL_UNSIGNED_BYTE, 1};
+const ComponentType CT_SHORT = {ComponentType::GL_SHORT, 2};
 const ComponentType CT_USHORT = {ComponentType::GL_UNSIGNED_SHORT, 2};
 const ComponentType CT_UINT = {ComponentType::GL_UNSIGNED_INT, 4};
 const ComponentType CT_FLOAT = {ComponentType::GL_FLOAT, 4};
@@ -114,6 +119,9 @@ const GLType GLT_MAT2F = {CT_USHORT, 4, "MAT2"};
 const GLType GLT_MAT3F = {CT_USHORT, 9, "MAT3"};
 const GLType GLT_MAT4F = {CT_FLOAT, 16, "MAT4"};
 const GLType GLT_QUATF = {CT_FLOAT, 4, "VEC4"};
+const GLType GLT_QUATS = {CT_SHORT, 4, "VEC4"};
+const GLType GLT_QUATB = {CT_BYTE, 4, "VEC4"};
+const GLType GLT_UBYTE = {CT_UBYTE, 1, "SCALAR"};
 
 /**
  * The base of any indexed glTF entity.
@@ -200,10 +208,30 @@ struct ModelData {
       : binary(_binary) {}
 
   std::shared_ptr<const std::vector<uint8_t>> const binary;
+  // bytes of binary data that were streamed to the external buffer file rather than kept
+  size_t streamedBinaryBytes{0};
 };
 
+class ArchiveWriter;
+
+/**
+ * Write the bytes into the --shared-assets folder, named by their SHA-256 digest and the suffix,
+ * unless an identical file is already there. Returns the URI to reference it by from a glTF in
+ * outputFolder, or "" if it couldn't be written or has no path relative to outputFolder.
+ */
+std::string WriteSharedAsset(
+    const GltfOptions& options,
+    const std::string& outputFolder,
+    const std::vector<uint8_t>& bytes,
+    const std::string& suffix);
+
+/**
+ * Build the glTF for the given model, writing its JSON (or, for .glb, everything) to the given
+ * stream. With an archive, every other artifact goes into that rather than into outputFolder.
+ */
 ModelData* Raw2Gltf(
-    std::ofstream& gltfOutStream,
+    std::ostream& gltfOutStream,
     const std::string& outputFolder,
     const RawModel& raw,
-    const GltfOptions& options);
+    const GltfOptions& options,
+    ArchiveWriter* archive = nullptr);
@@ -11,9 +11,12 @@
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+#include <utils/Archive_Utils.hpp>
 #include <utils/File_Utils.hpp>
 #include <utils/Image_Utils.hpp>
+#include <utils/Png_Optimizer.hpp>
 #include <utils/String_Utils.hpp>
+#include <utils/Texture_Cache.hpp>
 
 #include <gltf/properties/ImageData.hpp>
 #include <gltf/properties/TextureData.hpp>
@@ -33,19 +36,27 @@ struct TexInfo {
   uint8_t* pixels{};
 };
 
-std::shared_ptr<TextureData> TextureBuilder::combine(
-    const std::vector<int>& ixVec,
-    const std::string& tag,
-    const pixel_merger& computePixel,
-    bool includeAlphaChannel) {
-  const std::string key = texIndicesKey(ixVec, tag);
-  auto iter = textureByIndicesKey.find(key);
-  if (iter != textureByIndicesKey.end()) {
-    return iter->second;
+static bool writeFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (fp == nullptr) {
+    fmt::printf("Warning: Couldn't open file '%s' for writing.\n", path);
+    return false;
+  }
+  const bool success = bytes.empty() || fwrite(bytes.data(), bytes.size(), 1, fp) == 1;
+  if (!success) {
+    fmt::printf("Warning: Failed to write %lu bytes to file '%s'.\n", bytes.size(), path);
   }
+  fclose(fp);
+  return success;
+}
 
+bool TextureBuilder::mergePixels(
+    const std::vector<int>& ixVec,
+    const pixel_merger& computePixel,
+    bool includeAlphaChannel,
+    std::string& mergedFilename,
+    std::vector<char>& imgBuffer) {
   int width = -1, height = -1;
-  std::string mergedFilename = tag;
   std::vector<TexInfo> texes{};
   for (const int rawTexIx : ixVec) {
     TexInfo info(rawTexIx);
@@ -54,7 +65,18 @@ std::shared_ptr<TextureData> TextureBuilder::combine(
       const std::string& fileLoc = rawTex.fileLocation;
       const std::string& name = FileUtils::GetFileBase(FileUtils::GetFileName(fileLoc));
       if (!fileLoc.empty()) {
-        info.pixels = stbi_load(fileLoc.c_str(), &info.width, &info.height, &info.channels, 0);
+        std::vector<uint8_t> fileBytes;
+        if (!ArchiveUtils::IsArchivePath(fileLoc)) {
+          info.pixels = stbi_load(fileLoc.c_str(), &info.width, &info.height, &info.channels, 0);
+        } else if (ArchiveUtils::ReadFile(fileLoc, fileBytes)) {
+          info.pixels = stbi_load_from_memory(
+              fileBytes.data(),
+              (int)fileBytes.size(),
+              &info.width,
+              &info.height,
+              &info.channels,
+              0);
+        }
         if (!info.pixels) {
           fmt::printf("Warning: merge texture [%d](%s) could not be loaded.\n", rawTexIx, name);
         } else {
@@ -70,7 +92,7 @@ std::shared_ptr<TextureData> TextureBuilder::combine(
                 width,
                 height);
             // this is bad enough that we abort the whole merge
-            return nullptr;
+            return false;
           }
           mergedFilename += "_" + name;
         }
@@ -78,12 +100,9 @@ std::shared_ptr<TextureData> TextureBuilder::combine(
     }
     texes.push_back(info);
   }
-  // at the moment, the best choice of filename is also the best choice of name
-  const std::string mergedName = mergedFilename;
-
   if (width < 0) {
     // no textures to merge; bail
-    return nullptr;
+    return false;
   }
   // TODO: which channel combinations make sense in input files?
 
@@ -118,7 +137,6 @@ std::shared_ptr<TextureData> TextureBuilder::combine(
     }
   }
 
-  std::vector<char> imgBuffer;
   int res = stbi_write_png_to_func(
       WriteToVectorContext,
       &imgBuffer,
@@ -129,32 +147,150 @@ std::shared_ptr<TextureData> TextureBuilder::combine(
       width * channels);
   if (!res) {
     fmt::printf("Warning: failed to generate merge texture '%s'.\n", mergedFilename);
-    return nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool TextureBuilder::optimizePng(std::vector<uint8_t>& bytes, const std::string& name) {
+  const size_t originalSize = bytes.size();
+  pngsOptimized++;
+  pngBytesBefore += originalSize;
+
+  // trying every filter strategy is slow, so remember what we found; empty means no gain
+  TextureCache* cache = TextureCache::Get();
+  std::string cacheKey;
+  std::vector<uint8_t> optimized;
+  bool improved = false;
+  if (cache != nullptr) {
+    cacheKey = "pngopt|" + TextureCache::HashBytes(bytes.data(), bytes.size());
+  }
+  if (!cacheKey.empty() && cache->Load(cacheKey, optimized)) {
+    improved = !optimized.empty();
+  } else {
+    improved = PngOptimizer::Optimize(bytes, optimized);
+    if (!cacheKey.empty()) {
+      cache->Store(cacheKey, improved ? optimized : std::vector<uint8_t>());
+    }
   }
 
+  if (improved) {
+    bytes = std::move(optimized);
+    if (verboseOutput) {
+      fmt::printf("Optimized PNG '%s': %lu -> %lu bytes.\n", name, originalSize, bytes.size());
+    }
+  }
+  pngBytesAfter += bytes.size();
+  return improved;
+}
+
+void TextureBuilder::reportPngOptimization() const {
+  if (pngsOptimized == 0 || pngBytesBefore == 0) {
+    return;
+  }
+  const uint64_t saved = pngBytesBefore - pngBytesAfter;
+  fmt::printf(
+      "PNG optimization saved %lu of %lu bytes (%.1f%%) across %d images.\n",
+      saved,
+      pngBytesBefore,
+      100.0 * saved / pngBytesBefore,
+      pngsOptimized);
+}
+
+std::shared_ptr<TextureData> TextureBuilder::combine(
+    const std::vector<int>& ixVec,
+    const std::string& tag,
+    const pixel_merger& computePixel,
+    bool includeAlphaChannel,
+    const std::string& mergeKey) {
+  const std::string key = texIndicesKey(ixVec, tag);
+  auto iter = textureByIndicesKey.find(key);
+  if (iter != textureByIndicesKey.end()) {
+    return iter->second;
+  }
+
+  // an identical merge may already have been done, by this or some earlier conversion
+  TextureCache* cache = TextureCache::Get();
+  std::string cacheKey;
+  if (cache != nullptr && !mergeKey.empty()) {
+    cacheKey = fmt::format("combine|{}|{}|{}", tag, mergeKey, includeAlphaChannel ? 4 : 3);
+    for (const int rawTexIx : ixVec) {
+      const std::string fileLoc = (rawTexIx >= 0) ? raw.GetTexture(rawTexIx).fileLocation : "";
+      const std::string hash = fileLoc.empty() ? "none" : cache->HashFile(fileLoc);
+      if (hash.empty()) {
+        // can't vouch for a source we can't read
+        cacheKey.clear();
+        break;
+      }
+      cacheKey += "|" + hash;
+    }
+  }
+
+  std::string mergedFilename = tag;
+  std::vector<char> imgBuffer;
+  std::vector<uint8_t> cachedBytes;
+  if (!cacheKey.empty() && cache->Load(cacheKey, cachedBytes)) {
+    imgBuffer.assign(cachedBytes.begin(), cachedBytes.end());
+    for (const int rawTexIx : ixVec) {
+      if (rawTexIx >= 0 && !raw.GetTexture(rawTexIx).fileLocation.empty()) {
+        const std::string& fileLoc = raw.GetTexture(rawTexIx).fileLocation;
+        mergedFilename += "_" + FileUtils::GetFileBase(FileUtils::GetFileName(fileLoc));
+      }
+    }
+    if (verboseOutput) {
+      fmt::printf("Reused cached merge texture '%s'.\n", mergedFilename);
+    }
+  } else {
+    if (!mergePixels(ixVec, computePixel, includeAlphaChannel, mergedFilename, imgBuffer)) {
+      return nullptr;
+    }
+    if (!cacheKey.empty()) {
+      cache->Store(cacheKey, std::vector<uint8_t>(imgBuffer.begin(), imgBuffer.end()));
+    }
+  }
+  if (options.optimizePngs) {
+    std::vector<uint8_t> pngBytes(imgBuffer.begin(), imgBuffer.end());
+    if (optimizePng(pngBytes, mergedFilename)) {
+      imgBuffer.assign(pngBytes.begin(), pngBytes.end());
+    }
+  }
+  // at the moment, the best choice of filename is also the best choice of name
+  const std::string mergedName = mergedFilename;
+
   ImageData* image;
   if (options.outputBinary && !options.separateTextures) {
     const auto bufferView =
         gltf.AddRawBufferView(*gltf.defaultBuffer, imgBuffer.data(), to_uint32(imgBuffer.size()));
     image = new ImageData(mergedName, *bufferView, "image/png");
   } else {
-    const std::string imageFilename = mergedFilename + (".png");
-    const std::string imagePath = outputFolder + imageFilename;
-    FILE* fp = fopen(imagePath.c_str(), "wb");
-    if (fp == nullptr) {
-      fmt::printf("Warning:: Couldn't write file '%s' for writing.\n", imagePath);
-      return nullptr;
-    }
+    std::string imageFilename = mergedFilename + (".png");
+    if (gltf.archive != nullptr) {
+      gltf.archive->AddFile(
+          imageFilename, std::vector<uint8_t>(imgBuffer.begin(), imgBuffer.end()));
+    } else if (!options.sharedAssetsDir.empty()) {
+      imageFilename = WriteSharedAsset(
+          options, outputFolder, std::vector<uint8_t>(imgBuffer.begin(), imgBuffer.end()), "png");
+      if (imageFilename.empty()) {
+        return nullptr;
+      }
+    } else {
+      const std::string imagePath = outputFolder + imageFilename;
+      FILE* fp = fopen(imagePath.c_str(), "wb");
+      if (fp == nullptr) {
+        fmt::printf("Warning:: Couldn't write file '%s' for writing.\n", imagePath);
+        return nullptr;
+      }
 
-    if (fwrite(imgBuffer.data(), imgBuffer.size(), 1, fp) != 1) {
-      fmt::printf(
-          "Warning: Failed to write %lu bytes to file '%s'.\n", imgBuffer.size(), imagePath);
+      if (fwrite(imgBuffer.data(), imgBuffer.size(), 1, fp) != 1) {
+        fmt::printf(
+            "Warning: Failed to write %lu bytes to file '%s'.\n", imgBuffer.size(), imagePath);
+        fclose(fp);
+        return nullptr;
+      }
       fclose(fp);
-      return nullptr;
-    }
-    fclose(fp);
-    if (verboseOutput) {
-      fmt::printf("Wrote %lu bytes to texture '%s'.\n", imgBuffer.size(), imagePath);
+      if (verboseOutput) {
+        fmt::printf("Wrote %lu bytes to texture '%s'.\n", imgBuffer.size(), imagePath);
+      }
     }
     image = new ImageData(mergedName, imageFilename);
   }
@@ -175,11 +311,21 @@ std::shared_ptr<TextureData> TextureBuilder::simple(int rawTexIndex, const std::
   const RawTexture& rawTexture = raw.GetTexture(rawTexIndex);
   const std::string textureName = FileUtils::GetFileBase(rawTexture.name);
   const std::string relativeFilename = FileUtils::GetFileName(rawTexture.fileLocation);
+  const auto& suffix = FileUtils::GetFileSuffix(rawTexture.fileLocation);
+  const bool optimizeAsPng =
+      options.optimizePngs && suffix && StringUtils::ToLower(*suffix) == "png";
   ImageData* image = nullptr;
   if (options.outputBinary) {
-    auto bufferView = gltf.AddBufferViewForFile(*gltf.defaultBuffer, rawTexture.fileLocation);
+    std::shared_ptr<BufferViewData> bufferView;
+    std::vector<uint8_t> fileBytes;
+    if (optimizeAsPng && ArchiveUtils::ReadFile(rawTexture.fileLocation, fileBytes) &&
+        optimizePng(fileBytes, textureName)) {
+      bufferView = gltf.AddRawBufferView(
+          *gltf.defaultBuffer, (const char*)fileBytes.data(), to_uint32(fileBytes.size()));
+    } else {
+      bufferView = gltf.AddBufferViewForFile(*gltf.defaultBuffer, rawTexture.fileLocation);
+    }
     if (bufferView) {
-      const auto& suffix = FileUtils::GetFileSuffix(rawTexture.fileLocation);
       std::string mimeType;
       if (suffix) {
         mimeType = ImageUtils::suffixToMimeType(suffix.value());
@@ -193,13 +339,52 @@ std::shared_ptr<TextureData> TextureBuilder::simple(int rawTexIndex, const std::
       image = new ImageData(relativeFilename, *bufferView, mimeType);
     }
 
-  } else if (!relativeFilename.empty()) {    
+  } else if (!relativeFilename.empty() && gltf.archive != nullptr) {
+    image = new ImageData(relativeFilename, relativeFilename);
+    std::vector<uint8_t> fileBytes;
+    if (gltf.archive->HasFile(relativeFilename)) {
+      // already added for some other texture
+    } else if (ArchiveUtils::ReadFile(rawTexture.fileLocation, fileBytes)) {
+      if (optimizeAsPng) {
+        optimizePng(fileBytes, textureName);
+      }
+      gltf.archive->AddFile(relativeFilename, std::move(fileBytes));
+      if (verboseOutput) {
+        fmt::printf("Added texture '%s' to output archive: %s\n", textureName, relativeFilename);
+      }
+    } else {
+      // as below, we still want the image in the glTF JSON even if the file couldn't be read
+      fmt::printf("Warning: Couldn't read texture file %s.\n", rawTexture.fileLocation);
+    }
+  } else if (!relativeFilename.empty() && !options.sharedAssetsDir.empty()) {
+    std::vector<uint8_t> fileBytes;
+    std::string uri;
+    if (ArchiveUtils::ReadFile(rawTexture.fileLocation, fileBytes)) {
+      if (optimizeAsPng) {
+        optimizePng(fileBytes, textureName);
+      }
+      uri = WriteSharedAsset(options, outputFolder, fileBytes, suffix.value_or(""));
+    } else {
+      fmt::printf("Warning: Couldn't read texture file %s.\n", rawTexture.fileLocation);
+    }
+    // as below, the image belongs in the glTF JSON even if the file couldn't be written
+    image = new ImageData(relativeFilename, uri.empty() ? relativeFilename : uri);
+  } else if (!relativeFilename.empty()) {
     std::string outputPath = outputFolder + "/" + relativeFilename;
     auto dstAbs = FileUtils::GetAbsolutePath(outputPath);
     image = new ImageData(relativeFilename, relativeFilename);
     auto srcAbs = FileUtils::GetAbsolutePath(rawTexture.fileLocation);
-    if (!FileUtils::FileExists(outputPath) && srcAbs != dstAbs) {
-      if (FileUtils::CopyFile(rawTexture.fileLocation, outputPath, true)) {
+    std::vector<uint8_t> fileBytes;
+    if (FileUtils::FileExists(outputPath) || srcAbs == dstAbs) {
+      // nothing to do; and we must never rewrite the source in place
+    } else if (
+        optimizeAsPng && ArchiveUtils::ReadFile(rawTexture.fileLocation, fileBytes) &&
+        optimizePng(fileBytes, textureName)) {
+      if (writeFile(outputPath, fileBytes) && verboseOutput) {
+        fmt::printf("Wrote optimized texture '%s' to output folder: %s\n", textureName, outputPath);
+      }
+    } else {
+      if (ArchiveUtils::CopyFile(rawTexture.fileLocation, outputPath, true)) {
         if (verboseOutput) {
           fmt::printf("Copied texture '%s' to output folder: %s\n", textureName, outputPath);
         }
@@ -35,14 +35,23 @@ class TextureBuilder {
   }
   ~TextureBuilder() {}
 
+  /**
+   * Merge the given textures pixel by pixel into a new PNG texture. The mergeKey should capture
+   * everything that mergeFunction depends on beyond the pixels themselves; if it's given, the
+   * result can be shared through the texture cache.
+   */
   std::shared_ptr<TextureData> combine(
       const std::vector<int>& ixVec,
       const std::string& tag,
       const pixel_merger& mergeFunction,
-      bool transparency);
+      bool transparency,
+      const std::string& mergeKey = "");
 
   std::shared_ptr<TextureData> simple(int rawTexIndex, const std::string& tag);
 
+  /** Print how much --optimize-png saved, if it ran at all. */
+  void reportPngOptimization() const;
+
   static std::string texIndicesKey(const std::vector<int>& ixVec, const std::string& tag) {
     std::string result = tag;
     for (int ix : ixVec) {
@@ -74,10 +83,24 @@ class TextureBuilder {
   }
 
  private:
+  bool mergePixels(
+      const std::vector<int>& ixVec,
+      const pixel_merger& computePixel,
+      bool includeAlphaChannel,
+      std::string& mergedFilename,
+      std::vector<char>& imgBuffer);
+
+  /** Replace the given PNG with a smaller lossless encoding of it, if we can find one. */
+  bool optimizePng(std::vector<uint8_t>& bytes, const std::string& name);
+
   const RawModel& raw;
   const GltfOptions& options;
   std::string outputFolder;
   GltfModel& gltf;
 
   std::map<std::string, std::shared_ptr<TextureData>> textureByIndicesKey;
+
+  int pngsOptimized{0};
+  uint64_t pngBytesBefore{0};
+  uint64_t pngBytesAfter{0};
 };
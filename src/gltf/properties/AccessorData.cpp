@@ -48,6 +48,9 @@ json AccessorData::serialize() const {
     result["bufferView"] = bufferView;
     result["byteOffset"] = byteOffset;
   }
+  if (normalized) {
+    result["normalized"] = true;
+  }
   if (!min.empty()) {
     result["min"] = min;
   }
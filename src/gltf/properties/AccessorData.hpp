@@ -34,6 +34,8 @@ struct AccessorData : Holdable {
   std::vector<float> min;
   std::vector<float> max;
   std::string name;
+  // whether integer components map onto [0, 1], or [-1, 1] if signed
+  bool normalized{false};
 
   bool sparse;
   int sparseIdxCount;
@@ -20,7 +20,7 @@ BufferData::BufferData(
     : Holdable(), isGlb(false), uri(isEmbedded ? "" : std::move(uri)), binData(binData) {}
 
 json BufferData::serialize() const {
-  json result{{"byteLength", binData->size()}};
+  json result{{"byteLength", streamedByteLength + binData->size()}};
   if (!isGlb) {
     if (!uri.empty()) {
       result["uri"] = uri;
@@ -21,6 +21,8 @@ struct BufferData : Holdable {
   json serialize() const override;
 
   const bool isGlb;
-  const std::string uri;
+  std::string uri; // settled late for a buffer named by its content
   const std::shared_ptr<const std::vector<uint8_t>> binData; // TODO this is just weird
+  // leading bytes of the buffer that were already streamed out, and are no longer in binData
+  size_t streamedByteLength{0};
 };
@@ -17,6 +17,9 @@ BufferViewData::BufferViewData(
 
 json BufferViewData::serialize() const {
   json result{{"buffer", buffer}, {"byteLength", byteLength}, {"byteOffset", byteOffset}};
+  if (byteStride > 0) {
+    result["byteStride"] = byteStride;
+  }
   if (target != GL_ARRAY_NONE) {
     result["target"] = target;
   }
@@ -37,9 +37,11 @@ struct BufferViewData : Holdable {
   }
 
   const unsigned int buffer;
-  const unsigned int byteOffset;
+  unsigned int byteOffset;
   const GL_ArrayType target;
 
   unsigned int count = 0;
   unsigned int byteLength = 0;
+  // only for vertex attributes sharing the view; 0 means tightly packed, and isn't written
+  unsigned int byteStride = 0;
 };
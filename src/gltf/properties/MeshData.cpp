@@ -30,5 +30,10 @@ json MeshData::serialize() const {
   if (!jsonTargetNamesArray.empty()) {
     result["extras"]["targetNames"] = jsonTargetNamesArray;
   }
+  if (extras.is_object()) {
+    for (const auto& k : json::iterator_wrapper(extras)) {
+      result["extras"][k.key()] = k.value();
+    }
+  }
   return result;
 }
@@ -28,4 +28,6 @@ struct MeshData : Holdable {
   const std::string name;
   const std::vector<float> weights;
   std::vector<std::shared_ptr<PrimitiveData>> primitives;
+  // anything else for the mesh's extras
+  json extras;
 };
@@ -88,6 +88,9 @@ json NodeData::serialize() const {
     if (light >= 0) {
       result["extensions"][KHR_LIGHTS_PUNCTUAL]["light"] = light;
     }
+    if (!lods.empty()) {
+      result["extensions"][MSFT_LOD]["ids"] = lods;
+    }
   }
 
   for (const auto& i : userProperties) {
@@ -98,6 +101,11 @@ json NodeData::serialize() const {
       prop_map[k.key()] = k.value();
     }
   }
+  if (extras.is_object()) {
+    for (const auto& k : json::iterator_wrapper(extras)) {
+      result["extras"][k.key()] = k.value();
+    }
+  }
 
   return result;
 }
@@ -38,4 +38,8 @@ struct NodeData : Holdable {
   int32_t skin;
   std::vector<std::string> skeletons;
   std::vector<std::string> userProperties;
+  // MSFT_lod: the nodes that stand in for this one, ever further away
+  std::vector<uint32_t> lods;
+  // anything else for the node's extras, beside the user properties
+  json extras;
 };
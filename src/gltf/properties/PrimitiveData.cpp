@@ -29,6 +29,9 @@ PrimitiveData::PrimitiveData(const AccessorData& indices, const MaterialData& ma
       dracoMesh(nullptr),
       dracoBufferView(-1) {}
 
+PrimitiveData::PrimitiveData(const AccessorData& indices)
+    : indices(indices.ix), material(-1), mode(TRIANGLES), dracoMesh(nullptr), dracoBufferView(-1) {}
+
 void PrimitiveData::AddAttrib(std::string name, const AccessorData& accessor) {
   attributes[name] = accessor.ix;
 }
@@ -49,7 +52,12 @@ void PrimitiveData::AddTarget(
 }
 
 void to_json(json& j, const PrimitiveData& d) {
-  j = {{"material", d.material}, {"mode", d.mode}, {"attributes", d.attributes}};
+  j = json::object();
+  if (d.material >= 0) {
+    j["material"] = d.material;
+  }
+  j["mode"] = d.mode;
+  j["attributes"] = d.attributes;
   if (d.indices >= 0) {
     j["indices"] = d.indices;
   }
@@ -73,8 +81,10 @@ void to_json(json& j, const PrimitiveData& d) {
     j["targets"] = targets;
   }
   if (!d.dracoAttributes.empty()) {
-    j["extensions"] = {
-        {KHR_DRACO_MESH_COMPRESSION,
-         {{"bufferView", d.dracoBufferView}, {"attributes", d.dracoAttributes}}}};
+    j["extensions"][KHR_DRACO_MESH_COMPRESSION] = {
+        {"bufferView", d.dracoBufferView}, {"attributes", d.dracoAttributes}};
+  }
+  if (!d.viewSortedIndices.empty()) {
+    j["extensions"][FB_VIEW_SORTED_INDICES] = {{"indices", d.viewSortedIndices}};
   }
 }
@@ -28,6 +28,9 @@ struct PrimitiveData {
 
   PrimitiveData(const AccessorData& indices, const MaterialData& material);
 
+  // A primitive with no material, for geometry that's never rendered.
+  explicit PrimitiveData(const AccessorData& indices);
+
   void AddAttrib(std::string name, const AccessorData& accessor);
 
   void AddTarget(
@@ -88,12 +91,15 @@ struct PrimitiveData {
   void NoteDracoBuffer(const BufferViewData& data);
 
   const int indices;
-  const unsigned int material;
+  const int material;
   const MeshMode mode;
 
   std::vector<std::tuple<int, int, int>> targetAccessors{};
   std::vector<std::string> targetNames{};
 
+  // index accessors with the triangles sorted back to front, one per view direction
+  std::vector<int> viewSortedIndices;
+
   std::map<std::string, int> attributes;
   std::map<std::string, int> dracoAttributes;
 
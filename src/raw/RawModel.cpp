@@ -8,10 +8,14 @@
 
 #include "RawModel.hpp"
 
+#include <array>
+#include <cfloat>
+#include <climits>
 #include <cmath>
 #include <map>
 #include <set>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -19,8 +23,15 @@
 #include <algorithm>
 #endif
 
+#include "utils/Archive_Utils.hpp"
+#include "utils/Convex_Hull.hpp"
+#include "utils/File_Utils.hpp"
 #include "utils/Image_Utils.hpp"
+#include "utils/Impostor_Atlas.hpp"
+#include "utils/Parallel_Utils.hpp"
 #include "utils/String_Utils.hpp"
+#include "utils/Texture_Cache.hpp"
+#include "utils/Triangle_Bvh.hpp"
 
 size_t VertexHasher::operator()(const RawVertex& v) const {
   size_t seed = 5381;
@@ -457,6 +468,2406 @@ void RawModel::Condense(const int maxSkinningWeights, const bool normalizeWeight
   }
 }
 
+static float SrgbToLinear(float value) {
+  return (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+int RawModel::FoldUniformTextures(const float tolerance) {
+  // many materials tend to share the same swatches, so only look at each texture once
+  std::vector<int> uniformity(textures.size(), 0);
+  std::vector<std::array<float, 4>> colors(textures.size());
+  auto isUniform = [&](int textureIndex) -> bool {
+    if (textureIndex < 0) {
+      return false;
+    }
+    if (uniformity[textureIndex] == 0) {
+      const bool uniform = ImageUtils::GetUniformColor(
+          textures[textureIndex].fileLocation, tolerance, colors[textureIndex]);
+      uniformity[textureIndex] = uniform ? 1 : -1;
+    }
+    return uniformity[textureIndex] > 0;
+  };
+  // colour textures are sRGB-encoded, while the factors they're multiplied with are linear
+  auto linearColor = [&](int textureIndex) -> Vec4f {
+    const std::array<float, 4>& c = colors[textureIndex];
+    return Vec4f(SrgbToLinear(c[0]), SrgbToLinear(c[1]), SrgbToLinear(c[2]), c[3]);
+  };
+
+  int foldedCount = 0;
+  for (RawMaterial& material : materials) {
+    int* tex = material.textures;
+
+    // a flat normal map does nothing at all
+    if (isUniform(tex[RAW_TEXTURE_USAGE_NORMAL])) {
+      const std::array<float, 4>& c = colors[tex[RAW_TEXTURE_USAGE_NORMAL]];
+      if (fabs(c[0] - 0.5f) <= tolerance && fabs(c[1] - 0.5f) <= tolerance &&
+          c[2] >= 1.0f - tolerance) {
+        tex[RAW_TEXTURE_USAGE_NORMAL] = -1;
+        foldedCount++;
+      }
+    }
+
+    if (material.info->shadingModel == RAW_SHADING_MODEL_PBR_MET_ROUGH) {
+      const auto* props = (RawMetRoughMatProps*)material.info.get();
+      Vec4f diffuseFactor = props->diffuseFactor;
+      Vec3f emissiveFactor = props->emissiveFactor;
+      float metallic = props->metallic;
+      float roughness = props->roughness;
+
+      if (isUniform(tex[RAW_TEXTURE_USAGE_ALBEDO])) {
+        diffuseFactor = diffuseFactor * linearColor(tex[RAW_TEXTURE_USAGE_ALBEDO]);
+        tex[RAW_TEXTURE_USAGE_ALBEDO] = -1;
+        foldedCount++;
+      }
+      if (isUniform(tex[RAW_TEXTURE_USAGE_EMISSIVE])) {
+        emissiveFactor = emissiveFactor * linearColor(tex[RAW_TEXTURE_USAGE_EMISSIVE]).xyz();
+        tex[RAW_TEXTURE_USAGE_EMISSIVE] = -1;
+        foldedCount++;
+      }
+
+      // the occlusion, roughness and metallic maps are merged into one texture, so only fold them
+      // if they all go; occlusion has no factor, so it must also be (nearly) white to go
+      const int occlusionIx = tex[RAW_TEXTURE_USAGE_OCCLUSION];
+      const int roughnessIx = tex[RAW_TEXTURE_USAGE_ROUGHNESS];
+      const int metallicIx = tex[RAW_TEXTURE_USAGE_METALLIC];
+      const bool canFoldOcclusion = occlusionIx < 0 ||
+          (isUniform(occlusionIx) && colors[occlusionIx][0] >= 1.0f - tolerance);
+      const bool canFoldRoughness = roughnessIx < 0 || isUniform(roughnessIx);
+      const bool canFoldMetallic = metallicIx < 0 || isUniform(metallicIx);
+      if (canFoldOcclusion && canFoldRoughness && canFoldMetallic) {
+        // channels as picked by the texture merge in Raw2Gltf: R occlusion, G rough, B metal
+        if (roughnessIx >= 0) {
+          const float value = colors[roughnessIx][1];
+          roughness *= props->invertRoughnessMap ? 1.0f - value : value;
+        }
+        if (metallicIx >= 0) {
+          metallic *= colors[metallicIx][2];
+        }
+        for (RawTextureUsage usage :
+             {RAW_TEXTURE_USAGE_OCCLUSION,
+              RAW_TEXTURE_USAGE_ROUGHNESS,
+              RAW_TEXTURE_USAGE_METALLIC}) {
+          if (tex[usage] >= 0) {
+            tex[usage] = -1;
+            foldedCount++;
+          }
+        }
+      }
+
+      material.info = std::make_shared<RawMetRoughMatProps>(
+          props->shadingModel,
+          std::move(diffuseFactor),
+          std::move(emissiveFactor),
+          props->emissiveIntensity,
+          metallic,
+          roughness,
+          props->invertRoughnessMap);
+    } else {
+      const auto* props = (RawTraditionalMatProps*)material.info.get();
+      Vec4f diffuseFactor = props->diffuseFactor;
+      Vec3f emissiveFactor = props->emissiveFactor;
+      float shininess = props->shininess;
+
+      if (isUniform(tex[RAW_TEXTURE_USAGE_DIFFUSE])) {
+        diffuseFactor = diffuseFactor * linearColor(tex[RAW_TEXTURE_USAGE_DIFFUSE]);
+        tex[RAW_TEXTURE_USAGE_DIFFUSE] = -1;
+        foldedCount++;
+      }
+      if (isUniform(tex[RAW_TEXTURE_USAGE_EMISSIVE])) {
+        emissiveFactor = emissiveFactor * linearColor(tex[RAW_TEXTURE_USAGE_EMISSIVE]).xyz();
+        tex[RAW_TEXTURE_USAGE_EMISSIVE] = -1;
+        foldedCount++;
+      }
+      // the shininess map is read from its red channel, and scales the shininess value
+      if (isUniform(tex[RAW_TEXTURE_USAGE_SHININESS])) {
+        shininess *= colors[tex[RAW_TEXTURE_USAGE_SHININESS]][0];
+        tex[RAW_TEXTURE_USAGE_SHININESS] = -1;
+        foldedCount++;
+      }
+
+      material.info = std::make_shared<RawTraditionalMatProps>(
+          props->shadingModel,
+          Vec3f(props->ambientFactor),
+          std::move(diffuseFactor),
+          std::move(emissiveFactor),
+          Vec3f(props->specularFactor),
+          shininess);
+    }
+  }
+  return foldedCount;
+}
+
+int RawModel::UnskinRigidSurfaces() {
+  const float epsilon = 1e-4f;
+
+  // For each surface, the single joint (as an index into its jointIds) that every vertex is
+  // fully bound to; -1 while undecided, -2 once the surface is known not to qualify.
+  std::vector<int> rigidJoints(surfaces.size(), -1);
+  for (size_t surfaceIndex = 0; surfaceIndex < surfaces.size(); surfaceIndex++) {
+    // morph target deltas live in bind space too; leave those meshes to the GPU
+    if (surfaces[surfaceIndex].jointIds.empty() ||
+        !surfaces[surfaceIndex].blendChannels.empty()) {
+      rigidJoints[surfaceIndex] = -2;
+    }
+  }
+  for (const auto& triangle : triangles) {
+    int& rigidJoint = rigidJoints[triangle.surfaceIndex];
+    for (int j = 0; j < 3 && rigidJoint != -2; j++) {
+      // Condense() has sorted skinning info from largest to smallest weight
+      const std::vector<RawVertexSkinningInfo>& skinningInfo =
+          vertices[triangle.verts[j]].skinningInfo;
+      if (skinningInfo.empty() || fabs(skinningInfo[0].jointWeight - 1.0f) > epsilon) {
+        rigidJoint = -2;
+        break;
+      }
+      for (size_t k = 1; k < skinningInfo.size(); k++) {
+        if (skinningInfo[k].jointWeight > epsilon) {
+          rigidJoint = -2;
+          break;
+        }
+      }
+      if (rigidJoint == -1) {
+        rigidJoint = skinningInfo[0].jointIndex;
+      } else if (rigidJoint != skinningInfo[0].jointIndex) {
+        rigidJoint = -2;
+      }
+    }
+  }
+
+  long nextNodeId = 0;
+  for (const auto& node : nodes) {
+    nextNodeId = std::max(nextNodeId, node.id + 1);
+  }
+
+  // Column-vector forms of the inverse bind matrix, and of its inverse transpose for normals.
+  std::vector<Mat4f> positionTransforms(surfaces.size());
+  std::vector<Mat3f> normalTransforms(surfaces.size());
+
+  int convertedCount = 0;
+  for (size_t surfaceIndex = 0; surfaceIndex < surfaces.size(); surfaceIndex++) {
+    const int jointIndex = rigidJoints[surfaceIndex];
+    if (jointIndex < 0) {
+      continue;
+    }
+    RawSurface& surface = surfaces[surfaceIndex];
+    const long jointId = surface.jointIds[jointIndex];
+    const int jointNodeIndex = GetNodeById(jointId);
+    if (jointNodeIndex < 0) {
+      rigidJoints[surfaceIndex] = -2;
+      continue;
+    }
+
+    // RawSurface stores inverse bind matrices in FBX's row-vector layout
+    const Mat4f inverseBindMatrix = surface.inverseBindMatrices[jointIndex].Transpose();
+    Mat3f linear;
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 3; col++) {
+        linear(row, col) = inverseBindMatrix(row, col);
+      }
+    }
+    positionTransforms[surfaceIndex] = inverseBindMatrix;
+    normalTransforms[surfaceIndex] = linear.Inverse().Transpose();
+
+    // detach the surface from whichever nodes displayed it through the skin...
+    std::string meshName = surface.name;
+    for (auto& node : nodes) {
+      if (node.surfaceId == surface.id) {
+        node.surfaceId = 0;
+        meshName = node.name;
+      }
+    }
+
+    // ... and display it from a fresh, identity-transformed child of the joint instead
+    RawNode meshNode;
+    meshNode.isJoint = false;
+    meshNode.id = nextNodeId++;
+    meshNode.name = meshName;
+    meshNode.parentId = jointId;
+    meshNode.translation = Vec3f(0, 0, 0);
+    meshNode.rotation = Quatf(0, 0, 0, 1);
+    meshNode.scale = Vec3f(1, 1, 1);
+    meshNode.surfaceId = surface.id;
+    meshNode.lightIx = -1;
+    meshNode.extraSkinIx = -1;
+    AddNode(meshNode);
+    nodes[jointNodeIndex].childIds.push_back(meshNode.id);
+
+    surface.skeletonRootId = meshNode.id;
+    surface.jointIds.clear();
+    surface.jointGeometryMins.clear();
+    surface.jointGeometryMaxs.clear();
+    surface.inverseBindMatrices.clear();
+    surface.bounds.Clear();
+    convertedCount++;
+
+    if (verboseOutput) {
+      fmt::printf(
+          "Mesh %s is rigidly skinned to joint %s; parenting it instead.\n",
+          meshName,
+          nodes[jointNodeIndex].name);
+    }
+  }
+  if (convertedCount == 0) {
+    return 0;
+  }
+
+  // Rebuild the vertex list, moving vertices of converted surfaces into joint space.
+  {
+    std::vector<RawVertex> oldVertices = vertices;
+
+    vertexHash.clear();
+    vertices.clear();
+
+    for (auto& triangle : triangles) {
+      const int surfaceIndex = triangle.surfaceIndex;
+      for (int j = 0; j < 3; j++) {
+        RawVertex vertex = oldVertices[triangle.verts[j]];
+        if (rigidJoints[surfaceIndex] >= 0) {
+          const Mat4f& positionTransform = positionTransforms[surfaceIndex];
+          const Mat3f& normalTransform = normalTransforms[surfaceIndex];
+          Mat3f linear;
+          for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+              linear(row, col) = positionTransform(row, col);
+            }
+          }
+
+          vertex.position = positionTransform * vertex.position;
+          if (vertex.normal.LengthSquared() >= FLT_MIN) {
+            vertex.normal = (normalTransform * vertex.normal).Normalized();
+          }
+          if (vertex.binormal.LengthSquared() >= FLT_MIN) {
+            vertex.binormal = (linear * vertex.binormal).Normalized();
+          }
+          const Vec3f tangent = linear * vertex.tangent.xyz();
+          if (tangent.LengthSquared() >= FLT_MIN) {
+            vertex.tangent = Vec4f(tangent.Normalized(), vertex.tangent.w);
+          }
+          vertex.skinningInfo.clear();
+          vertex.jointIndices.clear();
+          vertex.jointWeights.clear();
+          surfaces[surfaceIndex].bounds.AddPoint(vertex.position);
+        }
+        triangle.verts[j] = AddVertex(vertex);
+      }
+    }
+  }
+
+  globalMaxWeights = 0;
+  for (const auto& vertex : vertices) {
+    globalMaxWeights = std::max(globalMaxWeights, (int)vertex.skinningInfo.size());
+  }
+  if (globalMaxWeights == 0) {
+    vertexAttributes &= ~(RAW_VERTEX_ATTRIBUTE_JOINT_INDICES | RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS);
+  }
+  return convertedCount;
+}
+
+int RawModel::BakeStaticBlendChannels() {
+  const float epsilon = 1e-5f;
+
+  // Find the blend channels that some animation moves away from their default weight. Animated
+  // weights are laid out frame by frame, with one weight per blend channel of the surface.
+  std::vector<std::vector<bool>> animated(surfaces.size());
+  for (size_t surfaceIndex = 0; surfaceIndex < surfaces.size(); surfaceIndex++) {
+    animated[surfaceIndex].assign(surfaces[surfaceIndex].blendChannels.size(), false);
+  }
+  for (const auto& animation : animations) {
+    for (const auto& channel : animation.channels) {
+      if (channel.weights.empty()) {
+        continue;
+      }
+      const int surfaceIndex = GetSurfaceById(nodes[channel.nodeIndex].surfaceId);
+      if (surfaceIndex < 0) {
+        continue;
+      }
+      const std::vector<RawBlendChannel>& blendChannels = surfaces[surfaceIndex].blendChannels;
+      const size_t stride = blendChannels.size();
+      if (stride == 0 || (channel.weights.size() % stride) != 0) {
+        // we can't tell which weights drive what; don't touch this surface
+        animated[surfaceIndex].assign(stride, true);
+        continue;
+      }
+      for (size_t ii = 0; ii < channel.weights.size(); ii++) {
+        if (fabs(channel.weights[ii] - blendChannels[ii % stride].defaultDeform) > epsilon) {
+          animated[surfaceIndex][ii % stride] = true;
+        }
+      }
+    }
+  }
+
+  int bakedCount = 0;
+  for (size_t surfaceIndex = 0; surfaceIndex < surfaces.size(); surfaceIndex++) {
+    for (size_t channelIx = 0; channelIx < animated[surfaceIndex].size(); channelIx++) {
+      if (!animated[surfaceIndex][channelIx]) {
+        bakedCount++;
+        if (verboseOutput) {
+          fmt::printf(
+              "Baking blend shape %s of mesh %s (weight %g).\n",
+              surfaces[surfaceIndex].blendChannels[channelIx].name,
+              surfaces[surfaceIndex].name,
+              surfaces[surfaceIndex].blendChannels[channelIx].defaultDeform);
+        }
+      }
+    }
+  }
+  if (bakedCount == 0) {
+    return 0;
+  }
+
+  // Fold the static channels into the base vertices and drop them from the blend vertices.
+  {
+    std::vector<RawVertex> oldVertices = vertices;
+
+    vertexHash.clear();
+    vertices.clear();
+
+    for (auto& triangle : triangles) {
+      const RawSurface& surface = surfaces[triangle.surfaceIndex];
+      const std::vector<bool>& keep = animated[triangle.surfaceIndex];
+      for (int j = 0; j < 3; j++) {
+        RawVertex vertex = oldVertices[triangle.verts[j]];
+        if (vertex.blends.size() == keep.size() && !keep.empty()) {
+          std::vector<RawBlendVertex> blends;
+          bool folded = false;
+          for (size_t channelIx = 0; channelIx < keep.size(); channelIx++) {
+            const RawBlendVertex& blend = vertex.blends[channelIx];
+            if (keep[channelIx]) {
+              blends.push_back(blend);
+              continue;
+            }
+            const RawBlendChannel& channel = surface.blendChannels[channelIx];
+            const float weight = channel.defaultDeform;
+            if (weight == 0.0f) {
+              continue;
+            }
+            vertex.position += blend.position * weight;
+            folded = true;
+            if (channel.hasNormals) {
+              vertex.normal += blend.normal * weight;
+            }
+            if (channel.hasTangents) {
+              vertex.tangent += Vec4f(blend.tangent.xyz() * weight, 0.0f);
+            }
+          }
+          const Vec3f tangent = vertex.tangent.xyz();
+          if (folded && vertex.normal.LengthSquared() >= FLT_MIN) {
+            vertex.normal.Normalize();
+          }
+          if (folded && tangent.LengthSquared() >= FLT_MIN) {
+            vertex.tangent = Vec4f(tangent.Normalized(), vertex.tangent.w);
+          }
+          vertex.blends = blends;
+          if (blends.empty()) {
+            vertex.blendSurfaceIx = -1;
+          }
+        }
+        triangle.verts[j] = AddVertex(vertex);
+      }
+    }
+  }
+
+  // Strip the same channels from the animated weights, then from the surfaces themselves.
+  for (auto& animation : animations) {
+    for (auto& channel : animation.channels) {
+      if (channel.weights.empty()) {
+        continue;
+      }
+      const int surfaceIndex = GetSurfaceById(nodes[channel.nodeIndex].surfaceId);
+      if (surfaceIndex < 0) {
+        continue;
+      }
+      const std::vector<bool>& keep = animated[surfaceIndex];
+      if (keep.empty()) {
+        continue;
+      }
+      std::vector<float> weights;
+      for (size_t ii = 0; ii < channel.weights.size(); ii++) {
+        if (keep[ii % keep.size()]) {
+          weights.push_back(channel.weights[ii]);
+        }
+      }
+      channel.weights = weights;
+    }
+  }
+  for (size_t surfaceIndex = 0; surfaceIndex < surfaces.size(); surfaceIndex++) {
+    std::vector<RawBlendChannel> blendChannels;
+    for (size_t channelIx = 0; channelIx < animated[surfaceIndex].size(); channelIx++) {
+      if (animated[surfaceIndex][channelIx]) {
+        blendChannels.push_back(surfaces[surfaceIndex].blendChannels[channelIx]);
+      }
+    }
+    surfaces[surfaceIndex].blendChannels = blendChannels;
+    surfaces[surfaceIndex].bounds.Clear();
+  }
+  for (const auto& triangle : triangles) {
+    for (int j = 0; j < 3; j++) {
+      surfaces[triangle.surfaceIndex].bounds.AddPoint(vertices[triangle.verts[j]].position);
+    }
+  }
+  return bakedCount;
+}
+
+// crop rectangles are aligned to this many pixels, so mip levels down to 1/4 scale line up
+static const int CROP_ALIGNMENT = 4;
+// don't bother cropping unless at least this fraction of the pixels go
+static const float CROP_MIN_SAVINGS = 0.25f;
+
+/** Mark the pixels covered by the given UV triangles in a width x height mask. */
+static void RasterizeUvOccupancy(
+    const std::vector<std::array<Vec2f, 3>>& uvTriangles,
+    int width,
+    int height,
+    std::vector<uint8_t>& mask) {
+  mask.assign((size_t)width * height, 0);
+
+  auto rasterizeBand = [&](int bandStart, int bandEnd) {
+    for (const auto& uvs : uvTriangles) {
+      Vec2f p[3];
+      float minY = FLT_MAX, maxY = -FLT_MAX, minX = FLT_MAX, maxX = -FLT_MAX;
+      for (int jj = 0; jj < 3; jj++) {
+        p[jj] = Vec2f(uvs[jj][0] * width, uvs[jj][1] * height);
+        minX = std::min(minX, p[jj][0]);
+        maxX = std::max(maxX, p[jj][0]);
+        minY = std::min(minY, p[jj][1]);
+        maxY = std::max(maxY, p[jj][1]);
+      }
+      const int y0 = std::max(bandStart, (int)floorf(minY));
+      const int y1 = std::min(bandEnd - 1, (int)floorf(maxY));
+      if (y0 > y1) {
+        continue;
+      }
+      const int x0 = std::max(0, (int)floorf(minX));
+      const int x1 = std::min(width - 1, (int)floorf(maxX));
+
+      // the pixels under the corners count even when the triangle is too thin to cover any centre
+      for (int jj = 0; jj < 3; jj++) {
+        const int px = std::min(width - 1, std::max(0, (int)floorf(p[jj][0])));
+        const int py = std::min(height - 1, std::max(0, (int)floorf(p[jj][1])));
+        if (py >= bandStart && py < bandEnd) {
+          mask[(size_t)py * width + px] = 1;
+        }
+      }
+
+      const float area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) -
+          (p[2][0] - p[0][0]) * (p[1][1] - p[0][1]);
+      if (area == 0.0f) {
+        continue;
+      }
+      const float sign = (area > 0) ? 1.0f : -1.0f;
+      for (int yy = y0; yy <= y1; yy++) {
+        for (int xx = x0; xx <= x1; xx++) {
+          const Vec2f c(xx + 0.5f, yy + 0.5f);
+          bool inside = true;
+          for (int jj = 0; jj < 3 && inside; jj++) {
+            const Vec2f& a = p[jj];
+            const Vec2f& b = p[(jj + 1) % 3];
+            const float edge = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+            inside = (sign * edge >= 0);
+          }
+          if (inside) {
+            mask[(size_t)yy * width + xx] = 1;
+          }
+        }
+      }
+    }
+  };
+
+  // every band walks all the triangles, so there are only as many as there are threads
+  const int bandCount = (int)ParallelUtils::GetWorkerCount((size_t)std::min(height, 16));
+  const int bandHeight = (height + bandCount - 1) / bandCount;
+  ParallelUtils::ParallelFor((size_t)bandCount, [&](size_t band) {
+    const int start = (int)band * bandHeight;
+    rasterizeBand(start, std::min(height, start + bandHeight));
+  });
+}
+
+int RawModel::CropTexturesToUvs(const std::string& folder, const int padding) {
+  if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_UV0) == 0) {
+    return 0;
+  }
+
+  // group materials with the textures they use, and textures with others of the same file; each
+  // group's UVs are remapped together, so all its textures must be cropped to the same region
+  const int materialCount = (int)materials.size();
+  std::vector<int> parent(materialCount + textures.size());
+  for (size_t ii = 0; ii < parent.size(); ii++) {
+    parent[ii] = (int)ii;
+  }
+  std::function<int(int)> find = [&](int ix) -> int {
+    return (parent[ix] == ix) ? ix : (parent[ix] = find(parent[ix]));
+  };
+  auto unite = [&](int a, int b) { parent[find(a)] = find(b); };
+
+  std::map<std::string, int> textureByFile;
+  for (int texIx = 0; texIx < (int)textures.size(); texIx++) {
+    const std::string file = StringUtils::ToLower(textures[texIx].fileLocation);
+    auto it = textureByFile.find(file);
+    if (it == textureByFile.end()) {
+      textureByFile[file] = texIx;
+    } else {
+      unite(materialCount + texIx, materialCount + it->second);
+    }
+  }
+  std::vector<bool> textured(materialCount, false);
+  for (int matIx = 0; matIx < materialCount; matIx++) {
+    for (int usage = 0; usage < RAW_TEXTURE_USAGE_MAX; usage++) {
+      const int texIx = materials[matIx].textures[usage];
+      if (texIx >= 0 && !textures[texIx].fileLocation.empty()) {
+        unite(matIx, materialCount + texIx);
+        textured[matIx] = true;
+      }
+    }
+  }
+
+  struct CropGroup {
+    std::vector<int> textures;
+    std::vector<int> triangles;
+    bool croppable{true};
+  };
+  std::map<int, CropGroup> groups;
+  for (int texIx = 0; texIx < (int)textures.size(); texIx++) {
+    if (!textures[texIx].fileLocation.empty()) {
+      groups[find(materialCount + texIx)].textures.push_back(texIx);
+    }
+  }
+  const float epsilon = 1e-4f;
+  for (int triIx = 0; triIx < (int)triangles.size(); triIx++) {
+    const int matIx = triangles[triIx].materialIndex;
+    if (matIx < 0 || !textured[matIx]) {
+      continue;
+    }
+    CropGroup& group = groups[find(matIx)];
+    group.triangles.push_back(triIx);
+    // a wrapping texture can't be cropped
+    for (int jj = 0; jj < 3; jj++) {
+      const Vec2f& uv = vertices[triangles[triIx].verts[jj]].uv0;
+      if (uv[0] < -epsilon || uv[0] > 1.0f + epsilon || uv[1] < -epsilon ||
+          uv[1] > 1.0f + epsilon) {
+        group.croppable = false;
+      }
+    }
+  }
+
+  std::vector<int> vertexGroup(vertices.size(), -1);
+  for (const auto& entry : groups) {
+    for (int triIx : entry.second.triangles) {
+      for (int vertIx : triangles[triIx].verts) {
+        vertexGroup[vertIx] = (vertexGroup[vertIx] == -1 || vertexGroup[vertIx] == entry.first)
+            ? entry.first
+            : -2; // shared between groups
+      }
+    }
+  }
+
+  std::set<std::string> usedNames;
+  int croppedCount = 0;
+  for (auto& entry : groups) {
+    CropGroup& group = entry.second;
+    if (!group.croppable || group.triangles.empty() || group.textures.empty()) {
+      continue;
+    }
+
+    // measure occupancy on the grid of the smallest texture; the others must be multiples of it
+    int gridWidth = INT_MAX, gridHeight = INT_MAX;
+    for (int texIx : group.textures) {
+      gridWidth = std::min(gridWidth, textures[texIx].width);
+      gridHeight = std::min(gridHeight, textures[texIx].height);
+    }
+    if (gridWidth < 2 * CROP_ALIGNMENT || gridHeight < 2 * CROP_ALIGNMENT) {
+      continue;
+    }
+    bool gridsAgree = true;
+    for (int texIx : group.textures) {
+      gridsAgree = gridsAgree && (textures[texIx].width % gridWidth == 0) &&
+          (textures[texIx].height % gridHeight == 0);
+    }
+    if (!gridsAgree) {
+      continue;
+    }
+
+    std::vector<std::array<Vec2f, 3>> uvTriangles;
+    uvTriangles.reserve(group.triangles.size());
+    for (int triIx : group.triangles) {
+      const int* verts = triangles[triIx].verts;
+      uvTriangles.push_back(
+          {{vertices[verts[0]].uv0, vertices[verts[1]].uv0, vertices[verts[2]].uv0}});
+    }
+    std::vector<uint8_t> mask;
+    RasterizeUvOccupancy(uvTriangles, gridWidth, gridHeight, mask);
+
+    int x0 = gridWidth, y0 = gridHeight, x1 = -1, y1 = -1;
+    size_t occupied = 0;
+    for (int yy = 0; yy < gridHeight; yy++) {
+      for (int xx = 0; xx < gridWidth; xx++) {
+        if (mask[(size_t)yy * gridWidth + xx] != 0) {
+          x0 = std::min(x0, xx);
+          x1 = std::max(x1, xx);
+          y0 = std::min(y0, yy);
+          y1 = std::max(y1, yy);
+          occupied++;
+        }
+      }
+    }
+    if (x1 < 0) {
+      continue;
+    }
+    // pad for filtering, then align for mipmapping
+    x0 = std::max(0, (x0 - padding) / CROP_ALIGNMENT * CROP_ALIGNMENT);
+    y0 = std::max(0, (y0 - padding) / CROP_ALIGNMENT * CROP_ALIGNMENT);
+    x1 = std::min(
+        gridWidth, (x1 + padding + CROP_ALIGNMENT) / CROP_ALIGNMENT * CROP_ALIGNMENT);
+    y1 = std::min(
+        gridHeight, (y1 + padding + CROP_ALIGNMENT) / CROP_ALIGNMENT * CROP_ALIGNMENT);
+    const float keptFraction = (float)(x1 - x0) * (y1 - y0) / ((float)gridWidth * gridHeight);
+    if (keptFraction > 1.0f - CROP_MIN_SAVINGS) {
+      continue;
+    }
+
+    // write all the cropped images before touching the model, so a failure leaves it intact
+    std::map<std::string, std::string> croppedByFile;
+    bool success = true;
+    for (int texIx : group.textures) {
+      const RawTexture& texture = textures[texIx];
+      const std::string key = StringUtils::ToLower(texture.fileLocation);
+      if (croppedByFile.count(key) > 0) {
+        continue;
+      }
+      const int scaleX = texture.width / gridWidth, scaleY = texture.height / gridHeight;
+      const std::string fileName = FileUtils::GetFileName(texture.fileLocation);
+      const size_t dot = fileName.find_last_of('.');
+      const std::string base = fileName.substr(0, dot);
+      const std::string suffix = (dot != std::string::npos) ? fileName.substr(dot) : ".png";
+      std::string croppedName = base + "_cropped" + suffix;
+      for (int ii = 2; usedNames.count(StringUtils::ToLower(croppedName)) > 0; ii++) {
+        croppedName = base + "_cropped" + std::to_string(ii) + suffix;
+      }
+      const std::string croppedPath = folder + "/" + croppedName;
+      if (!ImageUtils::CropImage(
+              texture.fileLocation,
+              croppedPath,
+              x0 * scaleX,
+              y0 * scaleY,
+              (x1 - x0) * scaleX,
+              (y1 - y0) * scaleY)) {
+        success = false;
+        break;
+      }
+      usedNames.insert(StringUtils::ToLower(croppedName));
+      croppedByFile[key] = croppedPath;
+    }
+    if (!success) {
+      if (verboseOutput) {
+        fmt::printf("Warning: couldn't crop the textures of material group %d.\n", entry.first);
+      }
+      continue;
+    }
+
+    for (int texIx : group.textures) {
+      RawTexture& texture = textures[texIx];
+      const int scaleX = texture.width / gridWidth, scaleY = texture.height / gridHeight;
+      if (verboseOutput) {
+        fmt::printf(
+            "Cropped texture %s from %dx%d to %dx%d (%.1f%% of it was in use).\n",
+            texture.name,
+            texture.width,
+            texture.height,
+            (x1 - x0) * scaleX,
+            (y1 - y0) * scaleY,
+            100.0 * occupied / ((double)gridWidth * gridHeight));
+      }
+      texture.fileLocation = croppedByFile[StringUtils::ToLower(texture.fileLocation)];
+      texture.width = (x1 - x0) * scaleX;
+      texture.height = (y1 - y0) * scaleY;
+      texture.mipLevels =
+          (int)ceilf(log2f(std::max((float)texture.width, (float)texture.height)));
+      croppedCount++;
+    }
+
+    // remap the UVs, copying any vertex that another group also uses
+    const Vec2f offset((float)x0 / gridWidth, (float)y0 / gridHeight);
+    const Vec2f scale((float)gridWidth / (x1 - x0), (float)gridHeight / (y1 - y0));
+    std::unordered_map<int, int> remapped;
+    for (int triIx : group.triangles) {
+      for (int& vertIx : triangles[triIx].verts) {
+        auto it = remapped.find(vertIx);
+        if (it != remapped.end()) {
+          vertIx = it->second;
+          continue;
+        }
+        int newIx = vertIx;
+        if (vertexGroup[vertIx] != entry.first) {
+          newIx = (int)vertices.size();
+          vertices.push_back(vertices[vertIx]);
+        }
+        vertices[newIx].uv0 = (vertices[newIx].uv0 - offset) * scale;
+        remapped[vertIx] = newIx;
+        vertIx = newIx;
+      }
+    }
+  }
+  return croppedCount;
+}
+
+std::vector<Mat4f> RawModel::GetRestWorldTransforms() const {
+  std::vector<Mat4f> worldTransforms(nodes.size());
+  std::vector<bool> resolved(nodes.size(), false);
+  std::unordered_map<long, int> nodeIndexById;
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    nodeIndexById[nodes[nodeIx].id] = nodeIx;
+  }
+  std::function<const Mat4f&(int)> worldTransform = [&](int nodeIx) -> const Mat4f& {
+    if (!resolved[nodeIx]) {
+      const RawNode& node = nodes[nodeIx];
+      const Mat4f local = Mat4f::FromTranslationVector(node.translation) *
+          node.rotation.ToMatrix4() * Mat4f::FromScaleVector(node.scale);
+      const auto parent = nodeIndexById.find(node.parentId);
+      worldTransforms[nodeIx] = (parent != nodeIndexById.end() && node.parentId != node.id)
+          ? worldTransform(parent->second) * local
+          : local;
+      resolved[nodeIx] = true;
+    }
+    return worldTransforms[nodeIx];
+  };
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    worldTransform(nodeIx);
+  }
+  return worldTransforms;
+}
+
+std::vector<RawNodeBounds> RawModel::ComputeSubtreeBounds() const {
+  std::unordered_map<long, int> nodeIndexById;
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    nodeIndexById[nodes[nodeIx].id] = nodeIx;
+  }
+  std::vector<int> parents(nodes.size(), -1);
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    const auto parent = nodeIndexById.find(nodes[nodeIx].parentId);
+    if (parent != nodeIndexById.end() && nodes[nodeIx].parentId != nodes[nodeIx].id) {
+      parents[nodeIx] = parent->second;
+    }
+  }
+  // parents before children, so world transforms can be built in one sweep
+  std::vector<int> order;
+  std::vector<bool> ordered(nodes.size(), false);
+  std::function<void(int)> visit = [&](int nodeIx) {
+    if (!ordered[nodeIx]) {
+      if (parents[nodeIx] >= 0) {
+        visit(parents[nodeIx]);
+      }
+      ordered[nodeIx] = true;
+      order.push_back(nodeIx);
+    }
+  };
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    visit(nodeIx);
+  }
+
+  std::vector<std::vector<int>> trianglesBySurface(surfaces.size());
+  for (int triIx = 0; triIx < (int)triangles.size(); triIx++) {
+    if (triangles[triIx].surfaceIndex >= 0) {
+      trianglesBySurface[triangles[triIx].surfaceIndex].push_back(triIx);
+    }
+  }
+
+  // What each mesh node draws: for static meshes, the points of their convex hull (whose box
+  // under any transform is that of the whole mesh), and for skinned ones, the box of what each
+  // joint carries, in the joint's space.
+  struct Content {
+    int nodeIx;
+    std::vector<Vec3f> points;
+    std::vector<std::pair<int, Boundsf>> jointBoxes;
+  };
+  std::vector<Content> contents;
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    const int surfaceIx =
+        (nodes[nodeIx].surfaceId != 0) ? GetSurfaceById(nodes[nodeIx].surfaceId) : -1;
+    if (surfaceIx >= 0 && !trianglesBySurface[surfaceIx].empty()) {
+      contents.push_back(Content{nodeIx, {}, {}});
+    }
+  }
+  auto gatherContent = [&](Content& content) {
+    const RawSurface& surface = surfaces[GetSurfaceById(nodes[content.nodeIx].surfaceId)];
+    std::set<int> vertexIndices;
+    for (const int triIx : trianglesBySurface[GetSurfaceById(surface.id)]) {
+      vertexIndices.insert(triangles[triIx].verts, triangles[triIx].verts + 3);
+    }
+    // the weights each morph target is used at, from its default and every animation, with zero
+    std::vector<std::pair<float, float>> weightRanges;
+    for (const RawBlendChannel& channel : surface.blendChannels) {
+      weightRanges.emplace_back(
+          std::min(0.0f, channel.defaultDeform), std::max(0.0f, channel.defaultDeform));
+    }
+    for (const RawAnimation& animation : animations) {
+      for (const RawChannel& channel : animation.channels) {
+        if (channel.nodeIndex != content.nodeIx || weightRanges.empty()) {
+          continue;
+        }
+        // one weight per target, frame after frame
+        for (size_t ii = 0; ii < channel.weights.size(); ii++) {
+          std::pair<float, float>& range = weightRanges[ii % weightRanges.size()];
+          range.first = std::min(range.first, channel.weights[ii]);
+          range.second = std::max(range.second, channel.weights[ii]);
+        }
+      }
+    }
+
+    std::vector<Vec3f> points;
+    std::map<int, Boundsf> jointBoxes;
+    // stored as FBX has them, to be transposed like everywhere else they're applied
+    std::vector<Mat4f> inverseBindMatrices;
+    for (const Mat4f& inverseBindMatrix : surface.inverseBindMatrices) {
+      inverseBindMatrices.push_back(inverseBindMatrix.Transpose());
+    }
+    for (const int vertexIx : vertexIndices) {
+      const RawVertex& vertex = vertices[vertexIx];
+      std::vector<Vec3f> positions(1, vertex.position);
+      if (!vertex.blends.empty()) {
+        // morph targets act together, so the vertex may be anywhere in the box that adds up, per
+        // axis, how far each target can take it either way over its range of weights
+        Vec3f low(0.0f), high(0.0f);
+        for (size_t ii = 0; ii < vertex.blends.size() && ii < weightRanges.size(); ii++) {
+          for (int axis = 0; axis < 3; axis++) {
+            const float a = weightRanges[ii].first * vertex.blends[ii].position[axis];
+            const float b = weightRanges[ii].second * vertex.blends[ii].position[axis];
+            low[axis] += std::min(a, b);
+            high[axis] += std::max(a, b);
+          }
+        }
+        positions.clear();
+        for (int corner = 0; corner < 8; corner++) {
+          positions.push_back(
+              vertex.position +
+              Vec3f(
+                  (corner & 1) ? high[0] : low[0],
+                  (corner & 2) ? high[1] : low[1],
+                  (corner & 4) ? high[2] : low[2]));
+        }
+      }
+      if (surface.jointIds.empty()) {
+        points.insert(points.end(), positions.begin(), positions.end());
+        continue;
+      }
+      for (size_t ii = 0; ii < vertex.jointIndices.size(); ii++) {
+        for (int component = 0; component < 4; component++) {
+          const int jointIx = vertex.jointIndices[ii][component];
+          if (vertex.jointWeights[ii][component] <= 0.0f ||
+              jointIx >= (int)surface.jointIds.size()) {
+            continue;
+          }
+          for (const Vec3f& position : positions) {
+            jointBoxes[jointIx].AddPoint(inverseBindMatrices[jointIx] * position);
+          }
+        }
+      }
+    }
+    for (const auto& jointBox : jointBoxes) {
+      const auto joint = nodeIndexById.find(surface.jointIds[jointBox.first]);
+      if (joint != nodeIndexById.end()) {
+        content.jointBoxes.emplace_back(joint->second, jointBox.second);
+      }
+    }
+    std::vector<uint32_t> indices;
+    if (!ConvexHull::Build(points, INT_MAX, content.points, indices)) {
+      content.points = std::move(points);
+    }
+  };
+
+  // the rest pose, then every frame of every animation, by (animation, frame), or -1 for rest
+  std::vector<std::pair<int, int>> poses(1, std::make_pair(-1, 0));
+  for (int animIx = 0; animIx < (int)animations.size(); animIx++) {
+    for (int frame = 0; frame < (int)animations[animIx].times.size(); frame++) {
+      poses.emplace_back(animIx, frame);
+    }
+  }
+  auto worldTransformsAt = [&](const std::pair<int, int>& pose, std::vector<Mat4f>& world) {
+    std::vector<Vec3f> translations(nodes.size()), scales(nodes.size());
+    std::vector<Quatf> rotations(nodes.size());
+    for (size_t nodeIx = 0; nodeIx < nodes.size(); nodeIx++) {
+      translations[nodeIx] = nodes[nodeIx].translation;
+      rotations[nodeIx] = nodes[nodeIx].rotation;
+      scales[nodeIx] = nodes[nodeIx].scale;
+    }
+    if (pose.first >= 0) {
+      for (const RawChannel& channel : animations[pose.first].channels) {
+        if (pose.second < (int)channel.translations.size()) {
+          translations[channel.nodeIndex] = channel.translations[pose.second];
+        }
+        if (pose.second < (int)channel.rotations.size()) {
+          rotations[channel.nodeIndex] = channel.rotations[pose.second];
+        }
+        if (pose.second < (int)channel.scales.size()) {
+          scales[channel.nodeIndex] = channel.scales[pose.second];
+        }
+      }
+    }
+    world.resize(nodes.size());
+    for (const int nodeIx : order) {
+      const Mat4f local = Mat4f::FromTranslationVector(translations[nodeIx]) *
+          rotations[nodeIx].ToMatrix4() * Mat4f::FromScaleVector(scales[nodeIx]);
+      world[nodeIx] = (parents[nodeIx] >= 0) ? world[parents[nodeIx]] * local : local;
+    }
+  };
+  // call back with each point a mesh node draws in a pose, in world space, for it and each of its
+  // ancestors, along with that point in the ancestor's space
+  auto visitPoints = [&](const std::vector<Mat4f>& world,
+                         const std::vector<Mat4f>& inverseWorld,
+                         const std::function<void(int, const Vec3f&, const Vec3f&)>& callback) {
+    std::vector<Vec3f> worldPoints;
+    for (const Content& content : contents) {
+      worldPoints.clear();
+      for (const Vec3f& p : content.points) {
+        worldPoints.push_back(world[content.nodeIx] * p);
+      }
+      for (const auto& jointBox : content.jointBoxes) {
+        const Boundsf& box = jointBox.second;
+        for (int corner = 0; corner < 8; corner++) {
+          worldPoints.push_back(
+              world[jointBox.first] *
+              Vec3f(
+                  (corner & 1) ? box.max[0] : box.min[0],
+                  (corner & 2) ? box.max[1] : box.min[1],
+                  (corner & 4) ? box.max[2] : box.min[2]));
+        }
+      }
+      for (int nodeIx = content.nodeIx; nodeIx >= 0; nodeIx = parents[nodeIx]) {
+        for (const Vec3f& p : worldPoints) {
+          callback(nodeIx, p, inverseWorld[nodeIx] * p);
+        }
+      }
+    }
+  };
+
+  // hand the poses out to workers, each with its own bounds, twice: once for the boxes, then for
+  // the spheres around their centres
+  const size_t workerCount = ParallelUtils::GetWorkerCount(poses.size());
+  using PoseVisitor =
+      std::function<void(int, const std::vector<Mat4f>&, const std::vector<Mat4f>&)>;
+  auto forEachPose = [&](const PoseVisitor& accumulate) {
+    std::vector<std::vector<Mat4f>> world(workerCount);
+    std::vector<std::vector<Mat4f>> inverseWorld(workerCount, std::vector<Mat4f>(nodes.size()));
+    ParallelUtils::ParallelForWorkers(poses.size(), [&](size_t poseIx, size_t worker) {
+      worldTransformsAt(poses[poseIx], world[worker]);
+      for (size_t nodeIx = 0; nodeIx < nodes.size(); nodeIx++) {
+        inverseWorld[worker][nodeIx] = world[worker][nodeIx].Inverse();
+      }
+      accumulate((int)worker, world[worker], inverseWorld[worker]);
+    });
+  };
+
+  ParallelUtils::ParallelFor(contents.size(), [&](size_t ii) { gatherContent(contents[ii]); });
+
+  std::vector<std::vector<RawNodeBounds>> partial(
+      workerCount, std::vector<RawNodeBounds>(nodes.size()));
+  forEachPose([&](int worker, const std::vector<Mat4f>& world, const std::vector<Mat4f>& inverse) {
+    std::vector<RawNodeBounds>& bounds = partial[worker];
+    visitPoints(world, inverse, [&](int nodeIx, const Vec3f& worldPoint, const Vec3f& localPoint) {
+      bounds[nodeIx].world.AddPoint(worldPoint);
+      bounds[nodeIx].local.AddPoint(localPoint);
+    });
+  });
+  std::vector<RawNodeBounds> result(nodes.size());
+  for (const auto& bounds : partial) {
+    for (size_t nodeIx = 0; nodeIx < nodes.size(); nodeIx++) {
+      if (bounds[nodeIx].world.initialized) {
+        result[nodeIx].world.AddPoint(bounds[nodeIx].world.min);
+        result[nodeIx].world.AddPoint(bounds[nodeIx].world.max);
+        result[nodeIx].local.AddPoint(bounds[nodeIx].local.min);
+        result[nodeIx].local.AddPoint(bounds[nodeIx].local.max);
+      }
+    }
+  }
+
+  for (auto& bounds : partial) {
+    for (RawNodeBounds& nodeBounds : bounds) {
+      nodeBounds.worldRadius = nodeBounds.localRadius = 0.0f;
+    }
+  }
+  forEachPose([&](int worker, const std::vector<Mat4f>& world, const std::vector<Mat4f>& inverse) {
+    std::vector<RawNodeBounds>& bounds = partial[worker];
+    visitPoints(world, inverse, [&](int nodeIx, const Vec3f& worldPoint, const Vec3f& localPoint) {
+      const Vec3f worldCentre = (result[nodeIx].world.min + result[nodeIx].world.max) * 0.5f;
+      const Vec3f localCentre = (result[nodeIx].local.min + result[nodeIx].local.max) * 0.5f;
+      bounds[nodeIx].worldRadius =
+          std::max(bounds[nodeIx].worldRadius, (worldPoint - worldCentre).Length());
+      bounds[nodeIx].localRadius =
+          std::max(bounds[nodeIx].localRadius, (localPoint - localCentre).Length());
+    });
+  });
+  for (const auto& bounds : partial) {
+    for (size_t nodeIx = 0; nodeIx < nodes.size(); nodeIx++) {
+      result[nodeIx].worldRadius = std::max(result[nodeIx].worldRadius, bounds[nodeIx].worldRadius);
+      result[nodeIx].localRadius = std::max(result[nodeIx].localRadius, bounds[nodeIx].localRadius);
+    }
+  }
+  return result;
+}
+
+std::vector<float> RawModel::ComputeTexelDensities() const {
+  const std::vector<Mat4f> worldTransforms = GetRestWorldTransforms();
+  std::map<long, std::vector<Mat4f>> instancesBySurfaceId;
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    if (nodes[nodeIx].surfaceId != 0) {
+      instancesBySurfaceId[nodes[nodeIx].surfaceId].push_back(worldTransforms[nodeIx]);
+    }
+  }
+
+  std::vector<std::vector<int>> trianglesBySurface(surfaces.size());
+  for (int triIx = 0; triIx < (int)triangles.size(); triIx++) {
+    const RawTriangle& triangle = triangles[triIx];
+    if (triangle.surfaceIndex >= 0 && triangle.materialIndex >= 0) {
+      trianglesBySurface[triangle.surfaceIndex].push_back(triIx);
+    }
+  }
+
+  // by texture index
+  struct Areas {
+    std::map<int, double> uv;
+    std::map<int, double> world;
+  };
+  auto measureSurface = [&](int surfaceIx, Areas& areas) {
+    const auto it = instancesBySurfaceId.find(surfaces[surfaceIx].id);
+    const std::vector<Mat4f> identity = {Mat4f::Identity()};
+    const std::vector<Mat4f>& instances =
+        (it != instancesBySurfaceId.end()) ? it->second : identity;
+
+    for (int triIx : trianglesBySurface[surfaceIx]) {
+      const RawTriangle& triangle = triangles[triIx];
+      const RawVertex& v0 = vertices[triangle.verts[0]];
+      const RawVertex& v1 = vertices[triangle.verts[1]];
+      const RawVertex& v2 = vertices[triangle.verts[2]];
+      const Vec2f du = v1.uv0 - v0.uv0, dv = v2.uv0 - v0.uv0;
+      const double uvArea = 0.5 * fabs(du[0] * dv[1] - du[1] * dv[0]);
+      // the texture has to be sharp enough for the biggest instance
+      double worldArea = 0.0;
+      for (const Mat4f& transform : instances) {
+        const Vec3f p0 = transform * v0.position;
+        const Vec3f e1 = transform * v1.position - p0, e2 = transform * v2.position - p0;
+        worldArea = std::max(worldArea, 0.5 * (double)Vec3f::CrossProduct(e1, e2).Length());
+      }
+      for (int texIx : materials[triangle.materialIndex].textures) {
+        if (texIx >= 0) {
+          areas.uv[texIx] += uvArea;
+          areas.world[texIx] += worldArea;
+        }
+      }
+    }
+  };
+
+  // measure the surfaces in parallel, but add them up in order, so the sums don't vary from run to
+  // run with the scheduling
+  std::vector<Areas> surfaceAreas(surfaces.size());
+  ParallelUtils::ParallelFor(surfaces.size(), [&](size_t surfaceIx) {
+    measureSurface((int)surfaceIx, surfaceAreas[surfaceIx]);
+  });
+  std::vector<double> uvArea(textures.size(), 0.0), worldArea(textures.size(), 0.0);
+  for (const Areas& areas : surfaceAreas) {
+    for (const auto& area : areas.uv) {
+      uvArea[area.first] += area.second;
+    }
+    for (const auto& area : areas.world) {
+      worldArea[area.first] += area.second;
+    }
+  }
+
+  std::vector<float> densities(textures.size(), 0.0f);
+  for (size_t texIx = 0; texIx < textures.size(); texIx++) {
+    if (worldArea[texIx] > 0.0) {
+      const double texels = uvArea[texIx] * textures[texIx].width * textures[texIx].height;
+      densities[texIx] = (float)sqrt(texels / worldArea[texIx]);
+    }
+  }
+  return densities;
+}
+
+int RawModel::ResizeTexturesToDensity(const std::string& folder, const float targetTexelsPerMetre) {
+  const std::vector<float> densities = ComputeTexelDensities();
+
+  std::vector<int> halvings(textures.size(), 0);
+  for (size_t texIx = 0; texIx < textures.size(); texIx++) {
+    const RawTexture& texture = textures[texIx];
+    float density = densities[texIx];
+    if (density <= 0.0f || texture.fileLocation.empty()) {
+      continue;
+    }
+    if (density >= 4.0f * targetTexelsPerMetre) {
+      fmt::printf(
+          "Warning: texture %s (%dx%d) is authored at %.0f texels per metre, %.0fx the target.\n",
+          texture.name,
+          texture.width,
+          texture.height,
+          density,
+          density / targetTexelsPerMetre);
+    }
+    while (density >= 2.0f * targetTexelsPerMetre &&
+           (texture.width >> (halvings[texIx] + 1)) > 0 &&
+           (texture.height >> (halvings[texIx] + 1)) > 0) {
+      density /= 2.0f;
+      halvings[texIx]++;
+    }
+  }
+
+  // a material's occlusion, roughness and metallic maps are merged into one texture, so they must
+  // stay the same size: group the textures merged together, through any material, and give each
+  // group the fewest halvings any of its textures needs
+  std::vector<int> parent(textures.size());
+  for (size_t ii = 0; ii < parent.size(); ii++) {
+    parent[ii] = (int)ii;
+  }
+  std::function<int(int)> find = [&](int ix) -> int {
+    return (parent[ix] == ix) ? ix : (parent[ix] = find(parent[ix]));
+  };
+  for (const RawMaterial& material : materials) {
+    int first = -1;
+    for (const RawTextureUsage usage :
+         {RAW_TEXTURE_USAGE_OCCLUSION, RAW_TEXTURE_USAGE_ROUGHNESS, RAW_TEXTURE_USAGE_METALLIC}) {
+      const int texIx = material.textures[usage];
+      if (texIx < 0) {
+        continue;
+      }
+      if (first < 0) {
+        first = texIx;
+      } else {
+        parent[find(texIx)] = find(first);
+      }
+    }
+  }
+  std::vector<int> groupHalvings(textures.size(), INT_MAX);
+  for (size_t texIx = 0; texIx < textures.size(); texIx++) {
+    const int group = find((int)texIx);
+    groupHalvings[group] = std::min(groupHalvings[group], halvings[texIx]);
+  }
+
+  // several textures may share a file, and if they need the same size, they can share the result
+  std::map<std::string, std::string> resizedFiles;
+  int resizedCount = 0;
+  for (size_t texIx = 0; texIx < textures.size(); texIx++) {
+    RawTexture& texture = textures[texIx];
+    const int textureHalvings = groupHalvings[find((int)texIx)];
+    if (textureHalvings > 0) {
+      const int width = texture.width >> textureHalvings;
+      const int height = texture.height >> textureHalvings;
+      ImageUtils::ImageEncoding encoding = ImageUtils::IMAGE_LINEAR;
+      if (texture.usage == RAW_TEXTURE_USAGE_DIFFUSE ||
+          texture.usage == RAW_TEXTURE_USAGE_ALBEDO ||
+          texture.usage == RAW_TEXTURE_USAGE_EMISSIVE) {
+        encoding = ImageUtils::IMAGE_SRGB;
+      } else if (texture.usage == RAW_TEXTURE_USAGE_NORMAL) {
+        encoding = ImageUtils::IMAGE_NORMAL_MAP;
+      }
+      const std::string key = fmt::format(
+          "{}|{}x{}|{}", StringUtils::ToLower(texture.fileLocation), width, height, (int)encoding);
+      auto it = resizedFiles.find(key);
+      if (it == resizedFiles.end()) {
+        const std::string fileName = FileUtils::GetFileName(texture.fileLocation);
+        const size_t dot = fileName.find_last_of('.');
+        const std::string suffix = (dot != std::string::npos) ? fileName.substr(dot) : ".png";
+        const std::string resizedPath = fmt::format(
+            "{}/{}_{}x{}{}{}",
+            folder,
+            fileName.substr(0, dot),
+            width,
+            height,
+            (encoding == ImageUtils::IMAGE_SRGB) ? "" : "_linear",
+            suffix);
+        // filtering a large image down is slow, so remember the result by its source's content
+        TextureCache* cache = TextureCache::Get();
+        std::string cacheKey;
+        if (cache != nullptr) {
+          const std::string fileHash = cache->HashFile(texture.fileLocation);
+          if (!fileHash.empty()) {
+            cacheKey =
+                fmt::format("resize|{}|{}x{}|{}", fileHash, width, height, (int)encoding);
+          }
+        }
+        std::vector<uint8_t> resized;
+        const bool fromCache = !cacheKey.empty() && cache->Load(cacheKey, resized) &&
+            !resized.empty() && FileUtils::WriteFileAtomically(resizedPath, resized);
+        if (!fromCache) {
+          if (!ImageUtils::DownsampleImage(
+                  texture.fileLocation, resizedPath, width, height, encoding)) {
+            fmt::printf("Warning: couldn't downsample texture %s.\n", texture.name);
+            continue;
+          }
+          if (!cacheKey.empty() && ArchiveUtils::ReadFile(resizedPath, resized)) {
+            cache->Store(cacheKey, resized);
+          }
+        }
+        it = resizedFiles.emplace(key, resizedPath).first;
+      }
+      if (verboseOutput) {
+        fmt::printf(
+            "Downsampled texture %s from %dx%d to %dx%d (%.0f texels per metre).\n",
+            texture.name,
+            texture.width,
+            texture.height,
+            width,
+            height,
+            densities[texIx] / (float)(1 << textureHalvings));
+      }
+      texture.fileLocation = it->second;
+      texture.width = width;
+      texture.height = height;
+      texture.mipLevels =
+          (int)ceilf(log2f(std::max((float)texture.width, (float)texture.height)));
+      resizedCount++;
+    }
+  }
+  return resizedCount;
+}
+
+// The diagonal of the box around a transformed box.
+static float transformedDiagonal(const Boundsf& bounds, const Mat4f& transform) {
+  Boundsf transformed;
+  for (int corner = 0; corner < 8; corner++) {
+    const Vec3f p(
+        (corner & 1) ? bounds.max[0] : bounds.min[0],
+        (corner & 2) ? bounds.max[1] : bounds.min[1],
+        (corner & 4) ? bounds.max[2] : bounds.min[2]);
+    transformed.AddPoint(transform * p);
+  }
+  return (transformed.max - transformed.min).Length();
+}
+
+RawPruneReport RawModel::PruneSmallDetails(
+    const float minSize,
+    const float minAngle,
+    const float distance) {
+  RawPruneReport report;
+  const std::vector<Mat4f> worldTransforms = GetRestWorldTransforms();
+
+  std::vector<size_t> triangleCounts(surfaces.size(), 0);
+  for (const RawTriangle& triangle : triangles) {
+    if (triangle.surfaceIndex >= 0) {
+      triangleCounts[triangle.surfaceIndex]++;
+    }
+  }
+
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    RawNode& node = nodes[nodeIx];
+    const int surfaceIx = (node.surfaceId != 0) ? GetSurfaceById(node.surfaceId) : -1;
+    // morphed meshes too, as their weight channels are only valid on nodes with a mesh
+    if (surfaceIx < 0 || !surfaces[surfaceIx].jointIds.empty() ||
+        !surfaces[surfaceIx].blendChannels.empty() || !surfaces[surfaceIx].bounds.initialized) {
+      continue;
+    }
+    const float size = transformedDiagonal(surfaces[surfaceIx].bounds, worldTransforms[nodeIx]);
+
+    if (minSize > 0.0f && size < minSize) {
+      report.nodesBySize++;
+      report.trianglesBySize += triangleCounts[surfaceIx];
+    } else if (
+        minAngle > 0.0f && distance > 0.0f && 2.0f * atanf(0.5f * size / distance) < minAngle) {
+      report.nodesByAngle++;
+      report.trianglesByAngle += triangleCounts[surfaceIx];
+    } else {
+      continue;
+    }
+    node.surfaceId = 0;
+  }
+  if (report.nodesBySize + report.nodesByAngle == 0) {
+    return report;
+  }
+
+  // drop the geometry that nothing shows any more
+  std::vector<bool> surfaceUsed(surfaces.size(), false);
+  for (const RawNode& node : nodes) {
+    const int surfaceIx = (node.surfaceId != 0) ? GetSurfaceById(node.surfaceId) : -1;
+    if (surfaceIx >= 0) {
+      surfaceUsed[surfaceIx] = true;
+    }
+  }
+  std::vector<RawTriangle> keptTriangles;
+  for (const RawTriangle& triangle : triangles) {
+    if (triangle.surfaceIndex < 0 || surfaceUsed[triangle.surfaceIndex]) {
+      keptTriangles.push_back(triangle);
+    }
+  }
+  triangles = std::move(keptTriangles);
+
+  // delete the empty leaves, repeatedly, as their parents may become empty leaves in turn
+  std::set<long> referencedIds = {rootNodeId};
+  for (const RawSurface& surface : surfaces) {
+    referencedIds.insert(surface.skeletonRootId);
+    referencedIds.insert(surface.jointIds.begin(), surface.jointIds.end());
+  }
+  for (const RawCamera& camera : cameras) {
+    referencedIds.insert(camera.nodeId);
+  }
+  std::set<int> animatedNodes;
+  for (const RawAnimation& animation : animations) {
+    for (const RawChannel& channel : animation.channels) {
+      animatedNodes.insert(channel.nodeIndex);
+    }
+  }
+  std::vector<bool> deleted(nodes.size(), false);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+      RawNode& node = nodes[nodeIx];
+      if (deleted[nodeIx] || node.isJoint || node.surfaceId != 0 || node.lightIx >= 0 ||
+          !node.childIds.empty() || referencedIds.count(node.id) > 0 ||
+          animatedNodes.count(nodeIx) > 0) {
+        continue;
+      }
+      deleted[nodeIx] = true;
+      changed = true;
+      report.nodesDeleted++;
+      const int parentIx = GetNodeById(node.parentId);
+      if (parentIx >= 0) {
+        auto& siblings = nodes[parentIx].childIds;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), node.id), siblings.end());
+      }
+    }
+  }
+  if (report.nodesDeleted > 0) {
+    std::vector<int> newIndex(nodes.size(), -1);
+    std::vector<RawNode> keptNodes;
+    for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+      if (!deleted[nodeIx]) {
+        newIndex[nodeIx] = (int)keptNodes.size();
+        keptNodes.push_back(nodes[nodeIx]);
+      }
+    }
+    nodes = std::move(keptNodes);
+    for (RawAnimation& animation : animations) {
+      for (RawChannel& channel : animation.channels) {
+        channel.nodeIndex = newIndex[channel.nodeIndex];
+      }
+    }
+  }
+  return report;
+}
+
+// Merge the vertices of a triangle list that fall in the same cell of a grid laid over it, and
+// drop the triangles that collapse; what's left is a cheap, coarse stand-in for collision.
+static RawCollisionPart simplifyByClustering(const RawCollisionPart& mesh, int resolution) {
+  Boundsf bounds;
+  for (const Vec3f& p : mesh.positions) {
+    bounds.AddPoint(p);
+  }
+  const Vec3f extent = bounds.max - bounds.min;
+  const float cellSize = std::max(extent[0], std::max(extent[1], extent[2])) / resolution;
+  if (!bounds.initialized || cellSize <= 0.0f) {
+    return mesh;
+  }
+
+  RawCollisionPart result;
+  std::map<std::tuple<int, int, int>, uint32_t> clusterByCell;
+  std::vector<uint32_t> clusterOf(mesh.positions.size());
+  std::vector<int> clusterSizes;
+  for (size_t ii = 0; ii < mesh.positions.size(); ii++) {
+    const Vec3f cell = (mesh.positions[ii] - bounds.min) / cellSize;
+    const auto key = std::make_tuple((int)cell[0], (int)cell[1], (int)cell[2]);
+    const auto inserted = clusterByCell.emplace(key, (uint32_t)result.positions.size());
+    if (inserted.second) {
+      result.positions.push_back(Vec3f(0.0f));
+      clusterSizes.push_back(0);
+    }
+    clusterOf[ii] = inserted.first->second;
+    result.positions[clusterOf[ii]] += mesh.positions[ii];
+    clusterSizes[clusterOf[ii]]++;
+  }
+  for (size_t ii = 0; ii < result.positions.size(); ii++) {
+    result.positions[ii] /= (float)clusterSizes[ii];
+  }
+
+  std::set<std::array<uint32_t, 3>> seen;
+  for (size_t ii = 0; ii + 2 < mesh.indices.size(); ii += 3) {
+    std::array<uint32_t, 3> corners = {clusterOf[mesh.indices[ii]],
+                                       clusterOf[mesh.indices[ii + 1]],
+                                       clusterOf[mesh.indices[ii + 2]]};
+    if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0]) {
+      continue;
+    }
+    std::array<uint32_t, 3> sorted = corners;
+    std::sort(sorted.begin(), sorted.end());
+    if (seen.insert(sorted).second) {
+      result.indices.insert(result.indices.end(), corners.begin(), corners.end());
+    }
+  }
+
+  // clustering leaves some positions unused; compact them
+  std::vector<int> newIndex(result.positions.size(), -1);
+  std::vector<Vec3f> usedPositions;
+  for (uint32_t& index : result.indices) {
+    if (newIndex[index] < 0) {
+      newIndex[index] = (int)usedPositions.size();
+      usedPositions.push_back(result.positions[index]);
+    }
+    index = (uint32_t)newIndex[index];
+  }
+  result.positions = std::move(usedPositions);
+  return result;
+}
+
+// Split a mesh into pieces whose convex hulls follow it closely: each round splits the piece that
+// gains the most from it, along whichever of a few axis-aligned planes shrinks the pieces' summed
+// hull volume the most, until there are maxHulls pieces or no split saves more than 'concavity'
+// of a piece's hull volume. Triangles go to the side of their centroid; the hulls may overlap a
+// little where triangles straddle a split, which is harmless for collision.
+static std::vector<RawCollisionPart> decomposeConvex(
+    const RawCollisionPart& mesh,
+    const CollisionOptions& options) {
+  struct Piece {
+    std::vector<uint32_t> triangles; // offsets into mesh.indices
+    float hullVolume;
+    float concavity; // the fraction of hull volume the best split saves
+    int splitAxis;
+    float splitAt;
+  };
+  auto hullVolume = [&](const std::vector<uint32_t>& triangles) -> float {
+    std::vector<Vec3f> points;
+    for (uint32_t triangle : triangles) {
+      for (int corner = 0; corner < 3; corner++) {
+        points.push_back(mesh.positions[mesh.indices[triangle + corner]]);
+      }
+    }
+    std::vector<Vec3f> positions;
+    std::vector<uint32_t> indices;
+    return ConvexHull::Build(points, INT_MAX, positions, indices)
+        ? ConvexHull::Volume(positions, indices)
+        : 0.0f;
+  };
+  auto centroid = [&](uint32_t triangle, int axis) -> float {
+    return (mesh.positions[mesh.indices[triangle]][axis] +
+            mesh.positions[mesh.indices[triangle + 1]][axis] +
+            mesh.positions[mesh.indices[triangle + 2]][axis]) /
+        3.0f;
+  };
+  auto split = [&](const Piece& piece, int axis, float at, Piece& below, Piece& above) {
+    below.triangles.clear();
+    above.triangles.clear();
+    for (uint32_t triangle : piece.triangles) {
+      (centroid(triangle, axis) < at ? below : above).triangles.push_back(triangle);
+    }
+  };
+  auto evaluate = [&](Piece& piece) {
+    piece.hullVolume = hullVolume(piece.triangles);
+    piece.concavity = 0.0f;
+    if (piece.hullVolume <= 0.0f || piece.triangles.size() < 2) {
+      return;
+    }
+    Boundsf bounds;
+    for (uint32_t triangle : piece.triangles) {
+      bounds.AddPoint(
+          Vec3f(centroid(triangle, 0), centroid(triangle, 1), centroid(triangle, 2)));
+    }
+    Piece below, above;
+    for (int axis = 0; axis < 3; axis++) {
+      for (const float fraction : {0.25f, 0.5f, 0.75f}) {
+        const float at = bounds.min[axis] + fraction * (bounds.max[axis] - bounds.min[axis]);
+        split(piece, axis, at, below, above);
+        if (below.triangles.empty() || above.triangles.empty()) {
+          continue;
+        }
+        const float saving = 1.0f -
+            (hullVolume(below.triangles) + hullVolume(above.triangles)) / piece.hullVolume;
+        if (saving > piece.concavity) {
+          piece.concavity = saving;
+          piece.splitAxis = axis;
+          piece.splitAt = at;
+        }
+      }
+    }
+  };
+
+  std::vector<Piece> pieces(1);
+  for (uint32_t triangle = 0; triangle + 2 < mesh.indices.size(); triangle += 3) {
+    pieces[0].triangles.push_back(triangle);
+  }
+  evaluate(pieces[0]);
+  while ((int)pieces.size() < options.maxHulls) {
+    size_t worst = 0;
+    for (size_t ii = 1; ii < pieces.size(); ii++) {
+      if (pieces[ii].concavity > pieces[worst].concavity) {
+        worst = ii;
+      }
+    }
+    if (pieces[worst].concavity <= options.concavity) {
+      break;
+    }
+    Piece below, above;
+    split(pieces[worst], pieces[worst].splitAxis, pieces[worst].splitAt, below, above);
+    evaluate(below);
+    evaluate(above);
+    pieces[worst] = std::move(below);
+    pieces.push_back(std::move(above));
+  }
+
+  std::vector<RawCollisionPart> hulls;
+  for (const Piece& piece : pieces) {
+    std::vector<Vec3f> points;
+    for (uint32_t triangle : piece.triangles) {
+      for (int corner = 0; corner < 3; corner++) {
+        points.push_back(mesh.positions[mesh.indices[triangle + corner]]);
+      }
+    }
+    RawCollisionPart hull;
+    if (ConvexHull::Build(points, options.maxHullVertices, hull.positions, hull.indices)) {
+      hulls.push_back(std::move(hull));
+    }
+  }
+  return hulls;
+}
+
+int RawModel::GenerateCollisionShapes(const CollisionOptions& options) {
+  const std::vector<Mat4f> worldTransforms = GetRestWorldTransforms();
+  std::unordered_map<long, int> nodeIndexById;
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    nodeIndexById[nodes[nodeIx].id] = nodeIx;
+  }
+
+  // a node's own 'collision' property, if it has one
+  auto ownShape = [&](const RawNode& node, CollisionShapeOption& shape) -> bool {
+    for (const std::string& property : node.userProperties) {
+      const json parsed = json::parse(property);
+      const auto it = parsed.find("collision");
+      if (it == parsed.end() || !it->is_object() || !(*it)["value"].is_string()) {
+        continue;
+      }
+      const std::string value = StringUtils::ToLower((*it)["value"].get<std::string>());
+      if (value == "none") {
+        shape = CollisionShapeOption::NONE;
+      } else if (value == "hull") {
+        shape = CollisionShapeOption::CONVEX_HULL;
+      } else if (value == "decomposition") {
+        shape = CollisionShapeOption::CONVEX_DECOMPOSITION;
+      } else if (value == "mesh") {
+        shape = CollisionShapeOption::TRIANGLE_MESH;
+      } else {
+        fmt::printf(
+            "Warning: node '%s' has unknown collision shape '%s'.\n", node.name, value.c_str());
+        continue;
+      }
+      return true;
+    }
+    return false;
+  };
+
+  // resolve, top-down, each node's shape and the node at the top of its subtree
+  std::vector<CollisionShapeOption> shapes(nodes.size(), options.shape);
+  std::vector<int> subtreeTops(nodes.size(), -1);
+  std::function<void(int, int)> resolve = [&](int nodeIx, int parentIx) {
+    const RawNode& node = nodes[nodeIx];
+    const bool explicitShape = ownShape(node, shapes[nodeIx]);
+    if (!explicitShape && parentIx >= 0) {
+      shapes[nodeIx] = shapes[parentIx];
+    }
+    const bool isTop = explicitShape || parentIx < 0 || nodes[parentIx].id == rootNodeId;
+    subtreeTops[nodeIx] = isTop ? nodeIx : subtreeTops[parentIx];
+    for (const long childId : node.childIds) {
+      const auto child = nodeIndexById.find(childId);
+      if (child != nodeIndexById.end() && subtreeTops[child->second] < 0) {
+        resolve(child->second, nodeIx);
+      }
+    }
+  };
+  const auto root = nodeIndexById.find(rootNodeId);
+  if (root != nodeIndexById.end()) {
+    resolve(root->second, -1);
+  }
+
+  std::vector<std::vector<int>> trianglesBySurface(surfaces.size());
+  for (int triIx = 0; triIx < (int)triangles.size(); triIx++) {
+    if (triangles[triIx].surfaceIndex >= 0) {
+      trianglesBySurface[triangles[triIx].surfaceIndex].push_back(triIx);
+    }
+  }
+
+  // gather the mesh nodes into jobs, each for the node whose shape they make up
+  struct Job {
+    int nodeIx;
+    std::vector<int> meshNodes;
+  };
+  std::vector<Job> jobs;
+  std::map<int, size_t> jobByNode;
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    const int surfaceIx =
+        (nodes[nodeIx].surfaceId != 0) ? GetSurfaceById(nodes[nodeIx].surfaceId) : -1;
+    if (surfaceIx < 0 || subtreeTops[nodeIx] < 0 || shapes[nodeIx] == CollisionShapeOption::NONE ||
+        !surfaces[surfaceIx].jointIds.empty() || trianglesBySurface[surfaceIx].empty()) {
+      continue;
+    }
+    const int owner = options.perSubtree ? subtreeTops[nodeIx] : nodeIx;
+    const auto inserted = jobByNode.emplace(owner, jobs.size());
+    if (inserted.second) {
+      jobs.push_back(Job{owner, {}});
+    }
+    jobs[inserted.first->second].meshNodes.push_back(nodeIx);
+  }
+
+  auto buildShape = [&](const Job& job) {
+    RawCollisionShape result;
+    result.nodeId = nodes[job.nodeIx].id;
+    result.shape = shapes[job.nodeIx];
+
+    RawCollisionPart mesh;
+    const Mat4f toOwner = worldTransforms[job.nodeIx].Inverse();
+    for (const int nodeIx : job.meshNodes) {
+      const Mat4f transform =
+          (nodeIx == job.nodeIx) ? Mat4f::Identity() : toOwner * worldTransforms[nodeIx];
+      std::unordered_map<int, uint32_t> gathered;
+      for (const int triIx : trianglesBySurface[GetSurfaceById(nodes[nodeIx].surfaceId)]) {
+        for (const int vertexIx : triangles[triIx].verts) {
+          const auto inserted = gathered.emplace(vertexIx, (uint32_t)mesh.positions.size());
+          if (inserted.second) {
+            mesh.positions.push_back(transform * vertices[vertexIx].position);
+          }
+          mesh.indices.push_back(inserted.first->second);
+        }
+      }
+    }
+
+    if (result.shape == CollisionShapeOption::CONVEX_HULL) {
+      RawCollisionPart hull;
+      if (ConvexHull::Build(
+              mesh.positions, options.maxHullVertices, hull.positions, hull.indices)) {
+        result.parts.push_back(std::move(hull));
+      }
+    } else if (result.shape == CollisionShapeOption::CONVEX_DECOMPOSITION) {
+      result.parts = decomposeConvex(mesh, options);
+    }
+    if (result.parts.empty()) {
+      result.shape = CollisionShapeOption::TRIANGLE_MESH;
+      result.parts.push_back(simplifyByClustering(mesh, options.meshResolution));
+    }
+    return result;
+  };
+
+  std::vector<RawCollisionShape> built(jobs.size());
+  ParallelUtils::ParallelFor(
+      jobs.size(), [&](size_t jobIx) { built[jobIx] = buildShape(jobs[jobIx]); });
+
+  int builtCount = 0;
+  for (RawCollisionShape& shape : built) {
+    if (!shape.parts.empty() && !shape.parts[0].indices.empty()) {
+      collisionShapes.push_back(std::move(shape));
+      builtCount++;
+    }
+  }
+  return builtCount;
+}
+
+// Occluders are carved out of a voxel grid this many cells along the surface's longest side.
+static const int OCCLUDER_GRID_RESOLUTION = 32;
+// Boxes after the first are only worth their triangles if they hold this much of its volume.
+static const float OCCLUDER_MIN_BOX_FRACTION = 0.1f;
+
+// Whether a triangle touches an axis-aligned box, by the separating axis test.
+static bool triangleTouchesBox(const Vec3f tri[3], const Vec3f& centre, const Vec3f& halfSize) {
+  const Vec3f v[3] = {tri[0] - centre, tri[1] - centre, tri[2] - centre};
+  const Vec3f edges[3] = {v[1] - v[0], v[2] - v[1], v[0] - v[2]};
+  auto separates = [&](const Vec3f& axis) {
+    const float p0 = Vec3f::DotProduct(v[0], axis);
+    const float p1 = Vec3f::DotProduct(v[1], axis);
+    const float p2 = Vec3f::DotProduct(v[2], axis);
+    const float radius = halfSize[0] * fabsf(axis[0]) + halfSize[1] * fabsf(axis[1]) +
+        halfSize[2] * fabsf(axis[2]);
+    return std::min(p0, std::min(p1, p2)) > radius || std::max(p0, std::max(p1, p2)) < -radius;
+  };
+  for (int axis = 0; axis < 3; axis++) {
+    const Vec3f boxAxis(axis == 0 ? 1.0f : 0.0f, axis == 1 ? 1.0f : 0.0f, axis == 2 ? 1.0f : 0.0f);
+    if (separates(boxAxis)) {
+      return false;
+    }
+    for (const Vec3f& edge : edges) {
+      if (separates(Vec3f::CrossProduct(edge, boxAxis))) {
+        return false;
+      }
+    }
+  }
+  return !separates(Vec3f::CrossProduct(edges[0], edges[1]));
+}
+
+// The largest box of set cells in a grid, found by narrowing a 2D mask over every run of z
+// slices and finding the largest rectangle in it. Returns its volume in cells, or zero.
+static int largestBox(const std::vector<uint8_t>& cells, const int size[3], int lo[3], int hi[3]) {
+  int bestVolume = 0;
+  std::vector<uint8_t> mask(size[0] * size[1]);
+  std::vector<int> heights(size[0]);
+  std::vector<int> stack;
+  for (int z0 = 0; z0 < size[2] && size[0] * size[1] * (size[2] - z0) > bestVolume; z0++) {
+    std::fill(mask.begin(), mask.end(), 1);
+    for (int z1 = z0; z1 < size[2]; z1++) {
+      const int depth = z1 - z0 + 1;
+      bool any = false;
+      for (int ii = 0; ii < size[0] * size[1]; ii++) {
+        mask[ii] &= cells[ii + size[0] * size[1] * z1];
+        any |= (mask[ii] != 0);
+      }
+      if (!any) {
+        break;
+      }
+      // largest rectangle under the histogram of runs of set cells ending at each row
+      std::fill(heights.begin(), heights.end(), 0);
+      for (int y = 0; y < size[1]; y++) {
+        for (int x = 0; x < size[0]; x++) {
+          heights[x] = mask[x + size[0] * y] ? heights[x] + 1 : 0;
+        }
+        stack.clear();
+        for (int x = 0; x <= size[0]; x++) {
+          const int height = (x < size[0]) ? heights[x] : 0;
+          while (!stack.empty() && heights[stack.back()] >= height) {
+            const int top = stack.back();
+            stack.pop_back();
+            const int left = stack.empty() ? 0 : stack.back() + 1;
+            const int volume = heights[top] * (x - left) * depth;
+            if (volume > bestVolume) {
+              bestVolume = volume;
+              lo[0] = left;
+              hi[0] = x - 1;
+              lo[1] = y - heights[top] + 1;
+              hi[1] = y;
+              lo[2] = z0;
+              hi[2] = z1;
+            }
+          }
+          stack.push_back(x);
+        }
+      }
+    }
+  }
+  return bestVolume;
+}
+
+// Whether every edge of the triangles, with vertices welded by position, is shared by an even
+// number of them, as it is for a closed surface.
+static bool isClosed(const std::vector<Vec3f>& corners) {
+  std::map<std::tuple<float, float, float>, int> weld;
+  std::map<std::pair<int, int>, int> edgeCounts;
+  std::vector<int> ids(corners.size());
+  for (size_t ii = 0; ii < corners.size(); ii++) {
+    const auto key = std::make_tuple(corners[ii][0], corners[ii][1], corners[ii][2]);
+    ids[ii] = weld.emplace(key, (int)weld.size()).first->second;
+  }
+  for (size_t ii = 0; ii < corners.size(); ii += 3) {
+    for (int edge = 0; edge < 3; edge++) {
+      const int a = ids[ii + edge], b = ids[ii + (edge + 1) % 3];
+      if (a != b) {
+        edgeCounts[std::make_pair(std::min(a, b), std::max(a, b))]++;
+      }
+    }
+  }
+  for (const auto& edge : edgeCounts) {
+    if ((edge.second % 2) != 0) {
+      return false;
+    }
+  }
+  return !edgeCounts.empty();
+}
+
+// Voxelise a closed surface, flood-fill the outside, and fill what's left strictly inside with as
+// many of the largest boxes as the budget allows.
+static RawOccluder buildOccluder(const std::vector<Vec3f>& corners, int maxBoxes) {
+  RawOccluder occluder;
+  Boundsf bounds;
+  for (const Vec3f& p : corners) {
+    bounds.AddPoint(p);
+  }
+  const Vec3f extent = bounds.max - bounds.min;
+  const float cellSize =
+      std::max(extent[0], std::max(extent[1], extent[2])) / OCCLUDER_GRID_RESOLUTION;
+  if (cellSize <= 0.0f) {
+    return occluder;
+  }
+  // a cell of padding all round guarantees the corner cell is outside
+  const Vec3f origin = bounds.min - Vec3f(cellSize);
+  int size[3];
+  for (int axis = 0; axis < 3; axis++) {
+    size[axis] = (int)ceilf(extent[axis] / cellSize) + 2;
+  }
+  auto cellIndex = [&](int x, int y, int z) { return x + size[0] * (y + size[1] * z); };
+
+  enum : uint8_t { EMPTY, SURFACE, OUTSIDE };
+  std::vector<uint8_t> cells(size[0] * size[1] * size[2], EMPTY);
+  // grow the cells a hair, so nothing slips between them through rounding
+  const Vec3f halfSize(cellSize * 0.5f * 1.001f);
+  for (size_t ii = 0; ii < corners.size(); ii += 3) {
+    Boundsf triangleBounds;
+    for (int corner = 0; corner < 3; corner++) {
+      triangleBounds.AddPoint(corners[ii + corner]);
+    }
+    int lo[3], hi[3];
+    for (int axis = 0; axis < 3; axis++) {
+      lo[axis] = std::max(0, (int)((triangleBounds.min[axis] - origin[axis]) / cellSize) - 1);
+      hi[axis] =
+          std::min(size[axis] - 1, (int)((triangleBounds.max[axis] - origin[axis]) / cellSize) + 1);
+    }
+    for (int z = lo[2]; z <= hi[2]; z++) {
+      for (int y = lo[1]; y <= hi[1]; y++) {
+        for (int x = lo[0]; x <= hi[0]; x++) {
+          const Vec3f centre = origin + Vec3f(x + 0.5f, y + 0.5f, z + 0.5f) * cellSize;
+          if (triangleTouchesBox(&corners[ii], centre, halfSize)) {
+            cells[cellIndex(x, y, z)] = SURFACE;
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<int> stack(1, 0);
+  cells[0] = OUTSIDE;
+  while (!stack.empty()) {
+    const int cell = stack.back();
+    stack.pop_back();
+    const int x = cell % size[0], y = (cell / size[0]) % size[1], z = cell / (size[0] * size[1]);
+    const int neighbours[6][3] = {
+        {x - 1, y, z}, {x + 1, y, z}, {x, y - 1, z}, {x, y + 1, z}, {x, y, z - 1}, {x, y, z + 1}};
+    for (const auto& n : neighbours) {
+      if (n[0] >= 0 && n[1] >= 0 && n[2] >= 0 && n[0] < size[0] && n[1] < size[1] &&
+          n[2] < size[2] && cells[cellIndex(n[0], n[1], n[2])] == EMPTY) {
+        cells[cellIndex(n[0], n[1], n[2])] = OUTSIDE;
+        stack.push_back(cellIndex(n[0], n[1], n[2]));
+      }
+    }
+  }
+  std::vector<uint8_t> interior(cells.size());
+  for (size_t ii = 0; ii < cells.size(); ii++) {
+    interior[ii] = (cells[ii] == EMPTY) ? 1 : 0;
+  }
+
+  int firstVolume = 0;
+  for (int box = 0; box < maxBoxes; box++) {
+    int lo[3], hi[3];
+    const int volume = largestBox(interior, size, lo, hi);
+    if (volume == 0 || volume < OCCLUDER_MIN_BOX_FRACTION * firstVolume) {
+      break;
+    }
+    firstVolume = std::max(firstVolume, volume);
+    for (int z = lo[2]; z <= hi[2]; z++) {
+      for (int y = lo[1]; y <= hi[1]; y++) {
+        for (int x = lo[0]; x <= hi[0]; x++) {
+          interior[cellIndex(x, y, z)] = 0;
+        }
+      }
+    }
+    const Vec3f boxMin = origin + Vec3f((float)lo[0], (float)lo[1], (float)lo[2]) * cellSize;
+    const Vec3f boxMax =
+        origin + Vec3f((float)hi[0] + 1, (float)hi[1] + 1, (float)hi[2] + 1) * cellSize;
+    const uint32_t base = (uint32_t)occluder.positions.size();
+    for (int corner = 0; corner < 8; corner++) {
+      occluder.positions.emplace_back(
+          (corner & 1) ? boxMax[0] : boxMin[0],
+          (corner & 2) ? boxMax[1] : boxMin[1],
+          (corner & 4) ? boxMax[2] : boxMin[2]);
+    }
+    static const uint32_t faces[6][4] = {
+        {0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    for (const auto& face : faces) {
+      for (const uint32_t corner : {face[0], face[1], face[2], face[0], face[2], face[3]}) {
+        occluder.indices.push_back(base + corner);
+      }
+    }
+  }
+  return occluder;
+}
+
+int RawModel::GenerateOccluders(const float minSize, const int maxTriangles) {
+  const std::vector<Mat4f> worldTransforms = GetRestWorldTransforms();
+  std::vector<float> sizes(surfaces.size(), 0.0f);
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    const int surfaceIx =
+        (nodes[nodeIx].surfaceId != 0) ? GetSurfaceById(nodes[nodeIx].surfaceId) : -1;
+    if (surfaceIx >= 0 && surfaces[surfaceIx].bounds.initialized) {
+      sizes[surfaceIx] = std::max(
+          sizes[surfaceIx],
+          transformedDiagonal(surfaces[surfaceIx].bounds, worldTransforms[nodeIx]));
+    }
+  }
+
+  std::vector<int> candidates;
+  for (int surfaceIx = 0; surfaceIx < (int)surfaces.size(); surfaceIx++) {
+    const RawSurface& surface = surfaces[surfaceIx];
+    if (sizes[surfaceIx] >= minSize && sizes[surfaceIx] > 0.0f && surface.jointIds.empty() &&
+        surface.blendChannels.empty()) {
+      candidates.push_back(surfaceIx);
+    }
+  }
+  std::vector<std::vector<Vec3f>> corners(surfaces.size());
+  for (const RawTriangle& triangle : triangles) {
+    if (triangle.surfaceIndex >= 0 && sizes[triangle.surfaceIndex] >= minSize) {
+      for (const int vertexIx : triangle.verts) {
+        corners[triangle.surfaceIndex].push_back(vertices[vertexIx].position);
+      }
+    }
+  }
+
+  std::vector<RawOccluder> built(candidates.size());
+  ParallelUtils::ParallelFor(candidates.size(), [&](size_t ii) {
+    if (isClosed(corners[candidates[ii]])) {
+      built[ii] = buildOccluder(corners[candidates[ii]], std::max(1, maxTriangles / 12));
+      built[ii].surfaceId = surfaces[candidates[ii]].id;
+    }
+  });
+
+  int builtCount = 0;
+  for (RawOccluder& occluder : built) {
+    if (!occluder.indices.empty()) {
+      occluders.push_back(std::move(occluder));
+      builtCount++;
+    }
+  }
+  return builtCount;
+}
+
+// a node's own 'impostor' property: 1 if it asks for one, 0 if it refuses, -1 if it doesn't say
+static int impostorChoice(const RawNode& node) {
+  for (const std::string& property : node.userProperties) {
+    const json parsed = json::parse(property);
+    const auto it = parsed.find("impostor");
+    if (it == parsed.end() || !it->is_object() || it->find("value") == it->end()) {
+      continue;
+    }
+    const json& value = *it->find("value");
+    if (value.is_boolean()) {
+      return value.get<bool>() ? 1 : 0;
+    }
+    if (value.is_number()) {
+      return (value.get<double>() != 0.0) ? 1 : 0;
+    }
+    if (value.is_string()) {
+      const std::string text = StringUtils::ToLower(value.get<std::string>());
+      return (text == "true" || text == "yes" || text == "1") ? 1 : 0;
+    }
+  }
+  return -1;
+}
+
+int RawModel::BakeImpostors(
+    const std::string& folder,
+    const float minSize,
+    const int frames,
+    const int frameSize) {
+  const std::vector<Mat4f> worldTransforms = GetRestWorldTransforms();
+  std::vector<bool> animated(nodes.size(), false);
+  for (const RawAnimation& animation : animations) {
+    for (const RawChannel& channel : animation.channels) {
+      animated[channel.nodeIndex] = true;
+    }
+  }
+
+  // the stand-ins replace whole nodes, so the nodes can't move on their own
+  std::vector<std::vector<int>> nodesBySurface(surfaces.size());
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    const RawNode& node = nodes[nodeIx];
+    const int surfaceIx = (node.surfaceId != 0) ? GetSurfaceById(node.surfaceId) : -1;
+    if (surfaceIx < 0 || node.isJoint || animated[nodeIx] || node.id == rootNodeId) {
+      continue;
+    }
+    const RawSurface& surface = surfaces[surfaceIx];
+    if (!surface.jointIds.empty() || !surface.blendChannels.empty()) {
+      continue;
+    }
+    const int choice = impostorChoice(node);
+    const bool large = minSize > 0.0f && surface.bounds.initialized &&
+        transformedDiagonal(surface.bounds, worldTransforms[nodeIx]) >= minSize;
+    if (choice == 1 || (choice < 0 && large)) {
+      nodesBySurface[surfaceIx].push_back(nodeIx);
+    }
+  }
+  std::vector<std::vector<int>> trianglesBySurface(surfaces.size());
+  for (int triIx = 0; triIx < (int)triangles.size(); triIx++) {
+    const int surfaceIx = triangles[triIx].surfaceIndex;
+    if (surfaceIx >= 0 && !nodesBySurface[surfaceIx].empty()) {
+      trianglesBySurface[surfaceIx].push_back(triIx);
+    }
+  }
+
+  long nextNodeId = 0, nextSurfaceId = 0, nextMaterialId = 0;
+  for (const RawNode& node : nodes) {
+    nextNodeId = std::max(nextNodeId, node.id + 1);
+  }
+  for (const RawSurface& surface : surfaces) {
+    nextSurfaceId = std::max(nextSurfaceId, surface.id + 1);
+  }
+  for (const RawMaterial& material : materials) {
+    nextMaterialId = std::max(nextMaterialId, material.id + 1);
+  }
+
+  struct Pixels {
+    bool loaded{false};
+    int width{0};
+    int height{0};
+    std::vector<uint8_t> rgba;
+  };
+  std::vector<Pixels> pixels(textures.size());
+  std::set<std::string> usedNames;
+  const int surfaceCount = (int)surfaces.size();
+  int bakedCount = 0;
+  for (int surfaceIx = 0; surfaceIx < surfaceCount; surfaceIx++) {
+    if (trianglesBySurface[surfaceIx].empty()) {
+      continue;
+    }
+
+    std::vector<ImpostorAtlas::Vertex> bakeVertices;
+    std::vector<ImpostorAtlas::Triangle> bakeTriangles;
+    std::vector<ImpostorAtlas::Material> bakeMaterials;
+    std::unordered_map<int, uint32_t> vertexMap;
+    std::unordered_map<int, int> materialMap;
+    Boundsf bounds;
+    for (int triIx : trianglesBySurface[surfaceIx]) {
+      const RawTriangle& triangle = triangles[triIx];
+      ImpostorAtlas::Triangle bakeTriangle;
+      for (int jj = 0; jj < 3; jj++) {
+        const int vertexIx = triangle.verts[jj];
+        auto inserted = vertexMap.emplace(vertexIx, (uint32_t)bakeVertices.size());
+        if (inserted.second) {
+          const RawVertex& vertex = vertices[vertexIx];
+          ImpostorAtlas::Vertex bakeVertex;
+          bakeVertex.position = vertex.position;
+          bakeVertex.normal =
+              (vertexAttributes & RAW_VERTEX_ATTRIBUTE_NORMAL) ? vertex.normal : Vec3f(0.0f);
+          bakeVertex.uv = vertex.uv0;
+          bakeVertex.color =
+              (vertexAttributes & RAW_VERTEX_ATTRIBUTE_COLOR) ? vertex.color : Vec4f(1.0f);
+          bakeVertices.push_back(bakeVertex);
+          bounds.AddPoint(vertex.position);
+        }
+        bakeTriangle.verts[jj] = inserted.first->second;
+      }
+
+      bakeTriangle.material = -1;
+      if (triangle.materialIndex >= 0) {
+        auto inserted = materialMap.emplace(triangle.materialIndex, (int)bakeMaterials.size());
+        if (inserted.second) {
+          const RawMaterial& material = materials[triangle.materialIndex];
+          ImpostorAtlas::Material bakeMaterial;
+          bakeMaterial.cutout = material.type == RAW_MATERIAL_TYPE_TRANSPARENT;
+          int texIx;
+          if (material.info->shadingModel == RAW_SHADING_MODEL_PBR_MET_ROUGH) {
+            bakeMaterial.color = ((RawMetRoughMatProps*)material.info.get())->diffuseFactor;
+            texIx = material.textures[RAW_TEXTURE_USAGE_ALBEDO];
+          } else {
+            bakeMaterial.color = ((RawTraditionalMatProps*)material.info.get())->diffuseFactor;
+            texIx = material.textures[RAW_TEXTURE_USAGE_DIFFUSE];
+          }
+          if (texIx >= 0 && !textures[texIx].fileLocation.empty()) {
+            Pixels& texture = pixels[texIx];
+            if (!texture.loaded) {
+              texture.loaded = true;
+              if (!ImageUtils::ReadPixels(
+                      textures[texIx].fileLocation, texture.width, texture.height, texture.rgba)) {
+                fmt::printf(
+                    "Warning: couldn't read texture %s; impostors will show it untextured.\n",
+                    textures[texIx].fileLocation);
+              }
+            }
+            if (!texture.rgba.empty()) {
+              bakeMaterial.width = texture.width;
+              bakeMaterial.height = texture.height;
+              bakeMaterial.texels = texture.rgba.data();
+            }
+          }
+          bakeMaterials.push_back(bakeMaterial);
+        }
+        bakeTriangle.material = inserted.first->second;
+      }
+      bakeTriangles.push_back(bakeTriangle);
+    }
+
+    const Vec3f center = (bounds.min + bounds.max) * 0.5f;
+    float radius = 0.0f;
+    for (const ImpostorAtlas::Vertex& vertex : bakeVertices) {
+      radius = std::max(radius, (vertex.position - center).Length());
+    }
+    if (radius <= 0.0f) {
+      continue;
+    }
+    std::vector<uint8_t> albedo, normalDepth;
+    ImpostorAtlas::Bake(
+        bakeVertices,
+        bakeTriangles,
+        bakeMaterials,
+        center,
+        radius,
+        frames,
+        frameSize,
+        albedo,
+        normalDepth);
+
+    std::string base = surfaces[surfaceIx].name + "_impostor";
+    for (char& c : base) {
+      c = (isalnum((unsigned char)c) || c == '-') ? c : '_';
+    }
+    std::string name = base;
+    for (int ii = 2; usedNames.count(StringUtils::ToLower(name)) > 0; ii++) {
+      name = base + std::to_string(ii);
+    }
+    usedNames.insert(StringUtils::ToLower(name));
+    const int atlasSize = frames * frameSize;
+    const std::string albedoPath = folder + "/" + name + "_albedo.png";
+    const std::string normalPath = folder + "/" + name + "_normal.png";
+    if (!ImageUtils::WritePixels(albedoPath, atlasSize, atlasSize, albedo) ||
+        !ImageUtils::WritePixels(normalPath, atlasSize, atlasSize, normalDepth)) {
+      fmt::printf(
+          "Warning: couldn't write the impostor atlases of %s.\n", surfaces[surfaceIx].name);
+      continue;
+    }
+
+    int quadTextures[RAW_TEXTURE_USAGE_MAX];
+    std::fill_n(quadTextures, RAW_TEXTURE_USAGE_MAX, -1);
+    quadTextures[RAW_TEXTURE_USAGE_ALBEDO] = AddTexture(
+        name + "_albedo", name + "_albedo.png", albedoPath, RAW_TEXTURE_USAGE_ALBEDO);
+    // the normals are in object space, so they can't be the quad's (tangent-space) normal map
+    const int normalTexture = AddTexture(
+        name + "_normal", name + "_normal.png", normalPath, RAW_TEXTURE_USAGE_NORMAL);
+    const int materialIx = AddMaterial(
+        nextMaterialId++,
+        name.c_str(),
+        RAW_MATERIAL_TYPE_TRANSPARENT,
+        quadTextures,
+        std::make_shared<RawMetRoughMatProps>(
+            RAW_SHADING_MODEL_PBR_MET_ROUGH, Vec4f(1.0f), Vec3f(0.0f), 1.0f, 0.0f, 1.0f, false),
+        {},
+        true);
+
+    // one quad across the bounding sphere, facing +Z, with the whole atlas on it
+    const long quadSurfaceId = nextSurfaceId++;
+    const int quadSurfaceIx = AddSurface(name.c_str(), quadSurfaceId);
+    AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_NORMAL);
+    AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_UV0);
+    int quadVerts[4];
+    for (int corner = 0; corner < 4; corner++) {
+      // top left, top right, bottom right, bottom left
+      const float u = (corner == 1 || corner == 2) ? 1.0f : 0.0f;
+      const float v = (corner >= 2) ? 1.0f : 0.0f;
+      RawVertex vertex;
+      vertex.position = center + Vec3f((2.0f * u - 1.0f) * radius, (1.0f - 2.0f * v) * radius, 0);
+      vertex.normal = Vec3f(0.0f, 0.0f, 1.0f);
+      vertex.tangent = Vec4f(1.0f, 0.0f, 0.0f, -1.0f);
+      vertex.binormal = Vec3f(0.0f, -1.0f, 0.0f);
+      vertex.color = Vec4f(1.0f);
+      vertex.uv0 = Vec2f(u, v);
+      quadVerts[corner] = AddVertex(vertex);
+      surfaces[quadSurfaceIx].bounds.AddPoint(vertex.position);
+    }
+    AddTriangle(quadVerts[0], quadVerts[3], quadVerts[2], materialIx, quadSurfaceIx);
+    AddTriangle(quadVerts[0], quadVerts[2], quadVerts[1], materialIx, quadSurfaceIx);
+
+    for (int nodeIx : nodesBySurface[surfaceIx]) {
+      RawNode impostorNode = nodes[nodeIx];
+      impostorNode.id = nextNodeId++;
+      impostorNode.name = nodes[nodeIx].name + "_impostor";
+      impostorNode.childIds.clear();
+      impostorNode.surfaceId = quadSurfaceId;
+      impostorNode.lightIx = -1;
+      impostorNode.userProperties.clear();
+      impostorNode.extraSkinIx = -1;
+      AddNode(impostorNode);
+
+      RawImpostor impostor;
+      impostor.nodeId = nodes[nodeIx].id;
+      impostor.impostorNodeId = impostorNode.id;
+      impostor.normalDepthTexture = normalTexture;
+      impostor.center = center;
+      impostor.radius = radius;
+      impostor.frames = frames;
+      impostor.frameSize = frameSize;
+      impostors.push_back(impostor);
+    }
+    if (verboseOutput) {
+      fmt::printf(
+          "Baked a %dx%d impostor atlas of %s for %lu nodes.\n",
+          atlasSize,
+          atlasSize,
+          surfaces[surfaceIx].name,
+          nodesBySurface[surfaceIx].size());
+    }
+    bakedCount++;
+  }
+  return bakedCount;
+}
+
+int RawModel::RemoveHiddenTriangles(
+    const std::vector<Vec3f>& viewpoints,
+    const int sphereViewpoints,
+    const float threshold) {
+  const std::vector<Mat4f> worldTransforms = GetRestWorldTransforms();
+
+  // anything that moves may uncover, or stop covering, something else
+  std::vector<int> animated(nodes.size(), -1);
+  std::unordered_map<long, int> nodeIndexById;
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    nodeIndexById[nodes[nodeIx].id] = nodeIx;
+  }
+  for (const RawAnimation& animation : animations) {
+    for (const RawChannel& channel : animation.channels) {
+      animated[channel.nodeIndex] = 1;
+    }
+  }
+  std::function<bool(int)> isAnimated = [&](int nodeIx) -> bool {
+    if (animated[nodeIx] < 0) {
+      const RawNode& node = nodes[nodeIx];
+      const auto parent = nodeIndexById.find(node.parentId);
+      animated[nodeIx] = (parent != nodeIndexById.end() && node.parentId != node.id &&
+                          isAnimated(parent->second))
+          ? 1
+          : 0;
+    }
+    return animated[nodeIx] > 0;
+  };
+
+  // each instance of a static surface contributes a world-space copy of its triangles
+  std::vector<bool> staticSurface(surfaces.size(), true);
+  std::vector<std::vector<int>> instancesBySurface(surfaces.size());
+  for (int nodeIx = 0; nodeIx < (int)nodes.size(); nodeIx++) {
+    if (nodes[nodeIx].surfaceId != 0) {
+      const int surfaceIx = GetSurfaceById(nodes[nodeIx].surfaceId);
+      if (surfaceIx >= 0) {
+        instancesBySurface[surfaceIx].push_back(nodeIx);
+        if (isAnimated(nodeIx)) {
+          staticSurface[surfaceIx] = false;
+        }
+      }
+    }
+  }
+  for (int surfaceIx = 0; surfaceIx < (int)surfaces.size(); surfaceIx++) {
+    staticSurface[surfaceIx] = staticSurface[surfaceIx] &&
+        !instancesBySurface[surfaceIx].empty() && surfaces[surfaceIx].jointIds.empty() &&
+        surfaces[surfaceIx].blendChannels.empty();
+  }
+  std::vector<std::vector<int>> trianglesBySurface(surfaces.size());
+  for (int triIx = 0; triIx < (int)triangles.size(); triIx++) {
+    const int surfaceIx = triangles[triIx].surfaceIndex;
+    if (surfaceIx >= 0 && staticSurface[surfaceIx]) {
+      trianglesBySurface[surfaceIx].push_back(triIx);
+    }
+  }
+
+  struct Candidate {
+    std::vector<TriangleBvh::Triangle> instances;
+    std::vector<int> occluderIds; // per instance; -1 for triangles that don't block rays
+  };
+  std::vector<int> candidateTriangles;
+  std::vector<Candidate> candidates;
+  std::vector<TriangleBvh::Triangle> occluders;
+  Boundsf sceneBounds;
+  for (int surfaceIx = 0; surfaceIx < (int)surfaces.size(); surfaceIx++) {
+    for (int triIx : trianglesBySurface[surfaceIx]) {
+      const RawTriangle& triangle = triangles[triIx];
+      const RawMaterialType type = (triangle.materialIndex >= 0)
+          ? materials[triangle.materialIndex].type
+          : RAW_MATERIAL_TYPE_OPAQUE;
+      const bool opaque =
+          (type == RAW_MATERIAL_TYPE_OPAQUE || type == RAW_MATERIAL_TYPE_SKINNED_OPAQUE);
+      Candidate candidate;
+      for (int nodeIx : instancesBySurface[surfaceIx]) {
+        TriangleBvh::Triangle world;
+        for (int jj = 0; jj < 3; jj++) {
+          world[jj] = worldTransforms[nodeIx] * vertices[triangle.verts[jj]].position;
+          sceneBounds.AddPoint(world[jj]);
+        }
+        candidate.instances.push_back(world);
+        candidate.occluderIds.push_back(opaque ? (int)occluders.size() : -1);
+        if (opaque) {
+          occluders.push_back(world);
+        }
+      }
+      candidateTriangles.push_back(triIx);
+      candidates.push_back(std::move(candidate));
+    }
+  }
+  if (candidates.empty()) {
+    return 0;
+  }
+  const TriangleBvh bvh(occluders);
+
+  // well outside the scene, spread evenly over a Fibonacci sphere
+  std::vector<Vec3f> eyes = viewpoints;
+  if (eyes.empty()) {
+    const Vec3f center = (sceneBounds.min + sceneBounds.max) * 0.5f;
+    const float radius = std::max(1e-3f, (sceneBounds.max - sceneBounds.min).Length());
+    const float goldenAngle = (float)(M_PI * (3.0 - sqrt(5.0)));
+    for (int ii = 0; ii < sphereViewpoints; ii++) {
+      const float y = 1.0f - 2.0f * (ii + 0.5f) / sphereViewpoints;
+      const float r = sqrtf(std::max(0.0f, 1.0f - y * y));
+      const float theta = goldenAngle * ii;
+      eyes.push_back(center + Vec3f(r * cosf(theta), y, r * sinf(theta)) * radius);
+    }
+  }
+
+  // a few fixed points inside each triangle, so the answer never depends on scheduling
+  static const float SAMPLES[][3] = {
+      {1.0f / 3, 1.0f / 3, 1.0f / 3},
+      {0.8f, 0.1f, 0.1f},
+      {0.1f, 0.8f, 0.1f},
+      {0.1f, 0.1f, 0.8f},
+  };
+  const int sampleCount = sizeof(SAMPLES) / sizeof(SAMPLES[0]);
+
+  std::vector<uint8_t> keep(candidates.size(), 0);
+  // in chunks, as a single candidate is too little work to hand out on its own
+  const size_t chunkSize = 256;
+  const size_t chunkCount = (candidates.size() + chunkSize - 1) / chunkSize;
+  ParallelUtils::ParallelFor(chunkCount, [&](size_t chunk) {
+    const size_t chunkEnd = std::min(candidates.size(), (chunk + 1) * chunkSize);
+    for (size_t ii = chunk * chunkSize; ii < chunkEnd; ii++) {
+      const Candidate& candidate = candidates[ii];
+      const size_t rayCount = candidate.instances.size() * sampleCount * eyes.size();
+      const size_t needed = (size_t)(threshold * rayCount);
+      size_t visible = 0;
+      for (size_t inst = 0; inst < candidate.instances.size() && visible <= needed; inst++) {
+        const TriangleBvh::Triangle& tri = candidate.instances[inst];
+        for (int ss = 0; ss < sampleCount && visible <= needed; ss++) {
+          const Vec3f target =
+              tri[0] * SAMPLES[ss][0] + tri[1] * SAMPLES[ss][1] + tri[2] * SAMPLES[ss][2];
+          for (size_t ee = 0; ee < eyes.size() && visible <= needed; ee++) {
+            const Vec3f toTarget = target - eyes[ee];
+            const float distance = toTarget.Length();
+            if (distance <= 0.0f ||
+                !bvh.IsOccluded(
+                    eyes[ee],
+                    toTarget / distance,
+                    distance * (1.0f - 1e-4f),
+                    candidate.occluderIds[inst])) {
+              visible++;
+            }
+          }
+        }
+      }
+      keep[ii] = (visible > needed) ? 1 : 0;
+    }
+  });
+
+  std::vector<bool> removed(triangles.size(), false);
+  std::vector<bool> touchedSurface(surfaces.size(), false);
+  int removedCount = 0;
+  for (size_t ii = 0; ii < candidates.size(); ii++) {
+    if (!keep[ii]) {
+      removed[candidateTriangles[ii]] = true;
+      touchedSurface[triangles[candidateTriangles[ii]].surfaceIndex] = true;
+      removedCount++;
+    }
+  }
+  if (removedCount == 0) {
+    return 0;
+  }
+  std::vector<int> remainingBySurface(surfaces.size(), 0);
+  std::vector<RawTriangle> keptTriangles;
+  keptTriangles.reserve(triangles.size() - removedCount);
+  for (int triIx = 0; triIx < (int)triangles.size(); triIx++) {
+    if (!removed[triIx]) {
+      keptTriangles.push_back(triangles[triIx]);
+      if (triangles[triIx].surfaceIndex >= 0) {
+        remainingBySurface[triangles[triIx].surfaceIndex]++;
+      }
+    }
+  }
+  triangles = std::move(keptTriangles);
+
+  // a mesh with nothing left in it must not be referenced at all
+  for (RawNode& node : nodes) {
+    if (node.surfaceId != 0) {
+      const int surfaceIx = GetSurfaceById(node.surfaceId);
+      if (surfaceIx >= 0 && touchedSurface[surfaceIx] && remainingBySurface[surfaceIx] == 0) {
+        node.surfaceId = 0;
+      }
+    }
+  }
+  return removedCount;
+}
+
 void RawModel::TransformGeometry(ComputeNormalsOption normals) {
   switch (normals) {
     case ComputeNormalsOption::NEVER:
@@ -691,6 +3102,108 @@ void RawModel::CreateMaterialModels(
   }
 }
 
+static uint32_t vertexSplitCauses(const RawVertex& a, const RawVertex& b) {
+  uint32_t causes = 0;
+  if (a.normal != b.normal) {
+    causes |= 1 << RAW_VERTEX_SPLIT_NORMAL;
+  }
+  if (a.tangent != b.tangent) {
+    causes |= 1 << RAW_VERTEX_SPLIT_TANGENT;
+  }
+  if (a.binormal != b.binormal) {
+    causes |= 1 << RAW_VERTEX_SPLIT_BINORMAL;
+  }
+  if (a.color != b.color) {
+    causes |= 1 << RAW_VERTEX_SPLIT_COLOR;
+  }
+  if (a.uv0 != b.uv0) {
+    causes |= 1 << RAW_VERTEX_SPLIT_UV0;
+  }
+  if (a.uv1 != b.uv1) {
+    causes |= 1 << RAW_VERTEX_SPLIT_UV1;
+  }
+  if (a.jointIndices != b.jointIndices || a.jointWeights != b.jointWeights) {
+    causes |= 1 << RAW_VERTEX_SPLIT_SKIN;
+  }
+  if (a.blendSurfaceIx != b.blendSurfaceIx || !(a.blends == b.blends)) {
+    causes |= 1 << RAW_VERTEX_SPLIT_BLEND;
+  }
+  if (a.polarityUv0 != b.polarityUv0) {
+    causes |= 1 << RAW_VERTEX_SPLIT_POLARITY_UV0;
+  }
+  return causes;
+}
+
+static int countBits(uint32_t bits) {
+  int count = 0;
+  for (; bits != 0; bits &= bits - 1) {
+    count++;
+  }
+  return count;
+}
+
+void RawModel::GetVertexSplits(std::vector<RawVertexSplits>& surfaceSplits) const {
+  surfaceSplits.assign(surfaces.size(), RawVertexSplits());
+
+  // a vertex belongs to the surface of the first triangle that uses it
+  std::vector<int> vertexSurface(vertices.size(), -1);
+  for (const RawTriangle& triangle : triangles) {
+    if (triangle.surfaceIndex < 0 || triangle.surfaceIndex >= (int)surfaces.size()) {
+      continue;
+    }
+    surfaceSplits[triangle.surfaceIndex].triangleCount++;
+    for (int vertIx : triangle.verts) {
+      if (vertexSurface[vertIx] < 0) {
+        vertexSurface[vertIx] = triangle.surfaceIndex;
+        surfaceSplits[triangle.surfaceIndex].vertexCount++;
+      }
+    }
+  }
+
+  // line up the vertices of each surface by position, keeping the order they were added in
+  std::vector<int> order;
+  for (int vertIx = 0; vertIx < (int)vertices.size(); vertIx++) {
+    if (vertexSurface[vertIx] >= 0) {
+      order.push_back(vertIx);
+    }
+  }
+  const auto samePlace = [&](int a, int b) {
+    return vertexSurface[a] == vertexSurface[b] && vertices[a].position == vertices[b].position;
+  };
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    const Vec3f& pa = vertices[a].position;
+    const Vec3f& pb = vertices[b].position;
+    return std::make_tuple(vertexSurface[a], pa[0], pa[1], pa[2], a) <
+        std::make_tuple(vertexSurface[b], pb[0], pb[1], pb[2], b);
+  });
+
+  for (size_t start = 0, end = 0; start < order.size(); start = end) {
+    end = start + 1;
+    while (end < order.size() && samePlace(order[start], order[end])) {
+      end++;
+    }
+    RawVertexSplits& splits = surfaceSplits[vertexSurface[order[start]]];
+    for (size_t ii = start + 1; ii < end; ii++) {
+      // the split is blamed on what differs from the closest vertex it could have merged with
+      uint32_t best = ~0u;
+      int bestCount = INT_MAX;
+      for (size_t jj = start; jj < ii && bestCount > 1; jj++) {
+        const uint32_t causes = vertexSplitCauses(vertices[order[ii]], vertices[order[jj]]);
+        if (countBits(causes) < bestCount) {
+          best = causes;
+          bestCount = countBits(causes);
+        }
+      }
+      splits.splitCount++;
+      for (int cause = 0; cause < RAW_VERTEX_SPLIT_CAUSE_COUNT; cause++) {
+        if ((best & (1 << cause)) != 0) {
+          splits.causes[cause]++;
+        }
+      }
+    }
+  }
+}
+
 int RawModel::GetNodeById(const long nodeId) const {
   for (size_t i = 0; i < nodes.size(); i++) {
     if (nodes[i].id == nodeId) {
@@ -82,6 +82,55 @@ class VertexHasher {
   size_t operator()(const RawVertex& v) const;
 };
 
+// What can keep a vertex from merging with another at the same position.
+enum RawVertexSplitCause {
+  RAW_VERTEX_SPLIT_NORMAL,
+  RAW_VERTEX_SPLIT_TANGENT,
+  RAW_VERTEX_SPLIT_BINORMAL,
+  RAW_VERTEX_SPLIT_COLOR,
+  RAW_VERTEX_SPLIT_UV0,
+  RAW_VERTEX_SPLIT_UV1,
+  RAW_VERTEX_SPLIT_SKIN,
+  RAW_VERTEX_SPLIT_BLEND,
+  RAW_VERTEX_SPLIT_POLARITY_UV0,
+  RAW_VERTEX_SPLIT_CAUSE_COUNT
+};
+
+inline std::string Describe(RawVertexSplitCause cause) {
+  switch (cause) {
+    case RAW_VERTEX_SPLIT_NORMAL:
+      return "normal";
+    case RAW_VERTEX_SPLIT_TANGENT:
+      return "tangent";
+    case RAW_VERTEX_SPLIT_BINORMAL:
+      return "binormal";
+    case RAW_VERTEX_SPLIT_COLOR:
+      return "color";
+    case RAW_VERTEX_SPLIT_UV0:
+      return "uv0";
+    case RAW_VERTEX_SPLIT_UV1:
+      return "uv1";
+    case RAW_VERTEX_SPLIT_SKIN:
+      return "skin";
+    case RAW_VERTEX_SPLIT_BLEND:
+      return "blend";
+    case RAW_VERTEX_SPLIT_POLARITY_UV0:
+      return "uv0 polarity";
+    case RAW_VERTEX_SPLIT_CAUSE_COUNT:
+      break;
+  }
+  return "<unknown>";
+}
+
+struct RawVertexSplits {
+  int vertexCount{0};
+  int triangleCount{0};
+  // vertices that share their position with an earlier one on the same surface
+  int splitCount{0};
+  // a split counts once under every attribute it differs in
+  int causes[RAW_VERTEX_SPLIT_CAUSE_COUNT] = {};
+};
+
 struct RawTriangle {
   int verts[3];
   int materialIndex;
@@ -358,6 +407,70 @@ struct RawNode {
   int extraSkinIx;
 };
 
+// One convex hull, or a triangle mesh, of a collision shape, in the space of its node.
+struct RawCollisionPart {
+  std::vector<Vec3f> positions;
+  std::vector<uint32_t> indices;
+};
+
+inline std::string Describe(CollisionShapeOption shape) {
+  switch (shape) {
+    case CollisionShapeOption::CONVEX_HULL:
+      return "convexHull";
+    case CollisionShapeOption::CONVEX_DECOMPOSITION:
+      return "convexDecomposition";
+    case CollisionShapeOption::TRIANGLE_MESH:
+      return "triangleMesh";
+    case CollisionShapeOption::NONE:
+    default:
+      return "none";
+  }
+}
+
+struct RawCollisionShape {
+  long nodeId;
+  CollisionShapeOption shape;
+  std::vector<RawCollisionPart> parts;
+};
+
+// A stand-in for a surface, in its space, that lies wholly inside it, for occlusion culling.
+struct RawOccluder {
+  long surfaceId{0};
+  std::vector<Vec3f> positions;
+  std::vector<uint32_t> indices;
+};
+
+// An octahedral impostor baked for a node's surface, shown through a node of its own that stands
+// in for the original at a distance; the atlas cells are frameSize pixels square.
+struct RawImpostor {
+  long nodeId;
+  long impostorNodeId;
+  int normalDepthTexture; // object-space normals in RGB, depth in alpha
+  Vec3f center;
+  float radius;
+  int frames;
+  int frameSize;
+};
+
+// Everything a node's subtree draws, bounded in world space and in the node's own space; the
+// spheres are centred on the boxes.
+struct RawNodeBounds {
+  Boundsf world;
+  Boundsf local;
+  float worldRadius{0.0f};
+  float localRadius{0.0f};
+};
+
+// What PruneSmallDetails() took out, by the criterion that caught it.
+struct RawPruneReport {
+  int nodesBySize{0};
+  size_t trianglesBySize{0};
+  int nodesByAngle{0};
+  size_t trianglesByAngle{0};
+  // nodes that were left with nothing to do and deleted outright
+  int nodesDeleted{0};
+};
+
 class RawModel {
  public:
   RawModel();
@@ -419,10 +532,87 @@ class RawModel {
     return rootNodeId;
   }
 
+  // Replace material textures whose pixels are all the same colour, within the given tolerance,
+  // with the equivalent material factor, and drop the texture references. Should run before
+  // Condense(), which then discards the textures. Returns the number of references dropped.
+  int FoldUniformTextures(float tolerance);
+
   // Remove unused vertices, textures or materials after removing vertex attributes, textures,
   // materials or surfaces.
   void Condense(const int maxSkinningWeights, const bool normalizeWeights);
 
+  // Re-express surfaces whose every vertex is bound to the same joint at full weight in that
+  // joint's local space, parent them to the joint through a new node, and drop their skin.
+  // Must run after Condense(). Returns the number of surfaces converted.
+  int UnskinRigidSurfaces();
+
+  // Fold every blend channel that no animation ever moves away from its default weight into the
+  // base vertices, and remove it from its surface, its vertices and the animation weights.
+  // Returns the number of blend channels removed.
+  int BakeStaticBlendChannels();
+
+  // Rasterise the UV0 triangles of every textured material into an occupancy mask, and where the
+  // occupied region is much smaller than the image, write a cropped copy of each texture into the
+  // given folder (plus a margin of padding pixels) and remap the UVs to match. Textures shared by
+  // materials are cropped only if all their users agree. Returns the number of textures cropped.
+  int CropTexturesToUvs(const std::string& folder, int padding);
+
+  // The bounds of each node's subtree, by node index, over the rest pose and every frame of every
+  // animation. Static meshes are bounded exactly, through their convex hulls; skinned ones by
+  // the box of what each joint carries, and morphed ones with each target at full weight. Poses
+  // are processed in parallel. Subtrees that draw nothing have uninitialised bounds.
+  std::vector<RawNodeBounds> ComputeSubtreeBounds() const;
+
+  // Texels per metre of each texture at its current resolution, from the UV0 area and world-space
+  // area (under the nodes' rest transforms, at the largest instance) of the triangles that use
+  // it; zero for unused textures. Surfaces are measured in parallel.
+  std::vector<float> ComputeTexelDensities() const;
+
+  // Downsample, into the given folder, every texture whose texel density is well above the target
+  // (in texels per metre), by the largest power of two that still meets it. Textures merged into
+  // one (a material's occlusion, roughness and metallic maps) are downsampled alike, as far as the
+  // least dense of them allows. Textures authored at four or more times the target are reported.
+  // Returns the number of textures downsampled.
+  int ResizeTexturesToDensity(const std::string& folder, float targetTexelsPerMetre);
+
+  // Render every static surface that's at least minSize metres across at some instance (or whose
+  // node has a true 'impostor' user property; a false one opts out) from frames x frames octahedral
+  // view directions into albedo and normal/depth atlases, written as PNGs into the given folder.
+  // Each such node gets a sibling outside the hierarchy, with the same transform, showing one quad
+  // across the bounding sphere textured with the atlases, to stand in for it far away. Skinned,
+  // morphed and animated meshes are left alone. Returns the number of surfaces baked.
+  int BakeImpostors(const std::string& folder, float minSize, int frames, int frameSize);
+
+  // Detach meshes from the nodes where their world-space bounds (rest pose) have a diagonal
+  // shorter than minSize metres, or subtend less than minAngle radians seen from 'distance'
+  // metres away; zero disables either test. Skinned and morphed meshes are left alone. Empty leaf
+  // nodes left behind are deleted, and so are the triangles of meshes no node uses any more.
+  RawPruneReport PruneSmallDetails(float minSize, float minAngle, float distance);
+
+  // Build collision shapes for the static (unskinned) meshes: one per mesh node, or with
+  // perSubtree, one per subtree, merged into the space of the node at its top. A 'collision' user
+  // property of none, hull, decomposition or mesh on a node sets the shape for its subtree (and
+  // makes it a subtree of its own); elsewhere the default shape applies. Flat geometry that has no
+  // hull gets a triangle mesh instead. Shapes are built in parallel. Returns the number built.
+  int GenerateCollisionShapes(const CollisionOptions& options);
+
+  // Build an occluder for each static (neither skinned nor morphed) surface that is closed, by an
+  // edge adjacency check, and whose bounds are at least minSize metres across at its largest
+  // instance: up to maxTriangles / 12 boxes carved from the inside of a voxelisation of it, so it
+  // never covers anything the surface doesn't. Surfaces are processed in parallel, and should be
+  // complete (before RemoveHiddenTriangles()). Returns the number of occluders built.
+  int GenerateOccluders(float minSize, int maxTriangles);
+
+  // Estimate how visible each triangle is by casting rays at it from the given viewpoints (or, if
+  // there are none, from 'sphereViewpoints' points on a sphere around the scene), against all the
+  // opaque triangles of the scene, and remove those seen by at most 'threshold' of the rays. Only
+  // triangles that can't move (neither skinned, morphed nor under an animated node) are removed
+  // or block rays. Deterministic, whatever the thread count. Returns the number removed.
+  int RemoveHiddenTriangles(
+      const std::vector<Vec3f>& viewpoints,
+      int sphereViewpoints,
+      float threshold);
+
   void TransformGeometry(ComputeNormalsOption);
 
   void TransformTextures(const std::vector<std::function<Vec2f(Vec2f)>>& transforms);
@@ -507,6 +697,30 @@ class RawModel {
     return lights[index];
   }
 
+  // Iterate over the collision shapes.
+  int GetCollisionShapeCount() const {
+    return (int)collisionShapes.size();
+  }
+  const RawCollisionShape& GetCollisionShape(const int index) const {
+    return collisionShapes[index];
+  }
+
+  // Iterate over the occluders.
+  int GetOccluderCount() const {
+    return (int)occluders.size();
+  }
+  const RawOccluder& GetOccluder(const int index) const {
+    return occluders[index];
+  }
+
+  // Iterate over the impostors.
+  int GetImpostorCount() const {
+    return (int)impostors.size();
+  }
+  const RawImpostor& GetImpostor(const int index) const {
+    return impostors[index];
+  }
+
   // Iterate over the nodes.
   int GetNodeCount() const {
     return (int)nodes.size();
@@ -519,6 +733,9 @@ class RawModel {
   }
   int GetNodeById(const long nodeId) const;
 
+  // Every node's world transform in the rest pose, by node index.
+  std::vector<Mat4f> GetRestWorldTransforms() const;
+
   // Create individual attribute arrays.
   // Returns true if the vertices store the particular attribute.
   template <typename _attrib_type_>
@@ -542,6 +759,10 @@ class RawModel {
       const int keepAttribs,
       const bool forceDiscrete) const;
 
+  // For each surface, count the vertices that share their position with an earlier one, and which
+  // attributes keep each apart from the most similar of those.
+  void GetVertexSplits(std::vector<RawVertexSplits>& surfaceSplits) const;
+
   int CreateExtraSkinIndex() {
     int ret = nextExtraSkinIx;
     nextExtraSkinIx++;
@@ -568,6 +789,9 @@ class RawModel {
   std::vector<RawAnimation> animations;
   std::vector<RawCamera> cameras;
   std::vector<RawNode> nodes;
+  std::vector<RawCollisionShape> collisionShapes;
+  std::vector<RawOccluder> occluders;
+  std::vector<RawImpostor> impostors;
 };
 
 template <typename _attrib_type_>
@@ -0,0 +1,323 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Archive_Utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <zlib.h>
+
+#include "FBX2glTF.h"
+#include "File_Utils.hpp"
+#include "String_Utils.hpp"
+
+namespace ArchiveUtils {
+
+static const uint32_t ZIP_LOCAL_HEADER_SIG = 0x04034b50;
+static const uint32_t ZIP_CENTRAL_HEADER_SIG = 0x02014b50;
+static const uint32_t ZIP_END_OF_DIRECTORY_SIG = 0x06054b50;
+
+static const uint16_t ZIP_METHOD_STORED = 0;
+static const uint16_t ZIP_METHOD_DEFLATED = 8;
+
+struct ZipEntry {
+  uint16_t method;
+  uint32_t compressedSize;
+  uint32_t size;
+  uint32_t localHeaderOffset;
+};
+
+// the central directory of a zip bundle, by entry name
+typedef std::map<std::string, ZipEntry> ZipDirectory;
+
+static uint16_t ReadU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool ReadDiskFile(const std::string& path, std::vector<uint8_t>& bytes) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  const std::streamsize size = file.tellg();
+  file.seekg(0, std::ios::beg);
+  bytes.resize(size);
+  return size == 0 || file.read((char*)bytes.data(), size);
+}
+
+static bool ReadDiskBytes(std::ifstream& file, uint64_t offset, size_t count, uint8_t* out) {
+  file.clear();
+  file.seekg(offset, std::ios::beg);
+  return file.read((char*)out, count) && file.gcount() == (std::streamsize)count;
+}
+
+static bool HasMagic(const std::string& path, const uint8_t* magic, size_t magicLength) {
+  std::ifstream file(path, std::ios::binary);
+  uint8_t head[4];
+  return file && ReadDiskBytes(file, 0, magicLength, head) && memcmp(head, magic, magicLength) == 0;
+}
+
+bool IsGzipFile(const std::string& path) {
+  static const uint8_t magic[] = {0x1f, 0x8b};
+  return HasMagic(path, magic, sizeof(magic));
+}
+
+bool IsZipFile(const std::string& path) {
+  static const uint8_t magic[] = {'P', 'K', 0x03, 0x04};
+  return HasMagic(path, magic, sizeof(magic));
+}
+
+bool IsZstdFile(const std::string& path) {
+  static const uint8_t magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+  return HasMagic(path, magic, sizeof(magic));
+}
+
+static bool Inflate(
+    const uint8_t* in,
+    size_t inLength,
+    int windowBits,
+    size_t expectedLength,
+    std::vector<uint8_t>& out) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, windowBits) != Z_OK) {
+    return false;
+  }
+  out.clear();
+  out.resize(expectedLength > 0 ? expectedLength : std::max<size_t>(inLength * 4, 1024));
+
+  stream.next_in = const_cast<Bytef*>(in);
+  stream.avail_in = (uInt)inLength;
+  int status = Z_OK;
+  while (status == Z_OK) {
+    if (stream.total_out == out.size()) {
+      out.resize(out.size() * 2);
+    }
+    stream.next_out = &out[stream.total_out];
+    stream.avail_out = (uInt)(out.size() - stream.total_out);
+    status = inflate(&stream, Z_NO_FLUSH);
+    // concatenated gzip members are legal; carry on with the next one
+    if (status == Z_STREAM_END && stream.avail_in > 0 && windowBits > MAX_WBITS) {
+      status = inflateReset(&stream);
+    }
+  }
+  out.resize(stream.total_out);
+  inflateEnd(&stream);
+  return status == Z_STREAM_END;
+}
+
+bool ReadGzipFile(const std::string& path, std::vector<uint8_t>& bytes) {
+  std::vector<uint8_t> compressed;
+  if (!ReadDiskFile(path, compressed)) {
+    fmt::printf("Warning: Couldn't read file %s.\n", path);
+    return false;
+  }
+  // MAX_WBITS + 16 selects gzip decoding
+  if (!Inflate(compressed.data(), compressed.size(), MAX_WBITS + 16, 0, bytes)) {
+    fmt::printf("Warning: Couldn't decompress gzip file %s.\n", path);
+    return false;
+  }
+  return true;
+}
+
+static bool ParseZipDirectory(const std::string& zipPath, ZipDirectory& directory) {
+  std::ifstream file(zipPath, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  const uint64_t fileSize = file.tellg();
+
+  // the end-of-directory record sits at the very end, behind a comment of up to 64k
+  const size_t tailSize = (size_t)std::min<uint64_t>(fileSize, 22 + 0xFFFF);
+  std::vector<uint8_t> tail(tailSize);
+  if (tailSize < 22 || !ReadDiskBytes(file, fileSize - tailSize, tailSize, tail.data())) {
+    return false;
+  }
+  const uint8_t* eocd = nullptr;
+  for (size_t ii = tailSize - 22 + 1; ii-- > 0;) {
+    if (ReadU32(&tail[ii]) == ZIP_END_OF_DIRECTORY_SIG) {
+      eocd = &tail[ii];
+      break;
+    }
+  }
+  if (eocd == nullptr) {
+    return false;
+  }
+  const uint16_t entryCount = ReadU16(eocd + 10);
+  const uint32_t directorySize = ReadU32(eocd + 12);
+  const uint32_t directoryOffset = ReadU32(eocd + 16);
+  if ((uint64_t)directoryOffset + directorySize > fileSize) {
+    // most likely zip64, which we don't support
+    return false;
+  }
+
+  std::vector<uint8_t> central(directorySize);
+  if (!ReadDiskBytes(file, directoryOffset, directorySize, central.data())) {
+    return false;
+  }
+  size_t pos = 0;
+  for (int ii = 0; ii < entryCount; ii++) {
+    if (pos + 46 > central.size() || ReadU32(&central[pos]) != ZIP_CENTRAL_HEADER_SIG) {
+      return false;
+    }
+    const uint8_t* header = &central[pos];
+    const uint16_t nameLength = ReadU16(header + 28);
+    const uint16_t extraLength = ReadU16(header + 30);
+    const uint16_t commentLength = ReadU16(header + 32);
+    if (pos + 46 + nameLength > central.size()) {
+      return false;
+    }
+    const std::string name((const char*)header + 46, nameLength);
+    if (!name.empty() && name.back() != '/') {
+      directory[name] = {
+          ReadU16(header + 10), ReadU32(header + 20), ReadU32(header + 24), ReadU32(header + 42)};
+    }
+    pos += 46 + nameLength + extraLength + commentLength;
+  }
+  return true;
+}
+
+// parse each bundle's directory only once; textures tend to be looked up repeatedly
+static const ZipDirectory* GetZipDirectory(const std::string& zipPath) {
+  static std::mutex mutex;
+  static std::map<std::string, std::unique_ptr<ZipDirectory>> directories;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto iter = directories.find(zipPath);
+  if (iter == directories.end()) {
+    std::unique_ptr<ZipDirectory> directory(new ZipDirectory());
+    if (!ParseZipDirectory(zipPath, *directory)) {
+      fmt::printf("Warning: Couldn't read the directory of zip file %s.\n", zipPath);
+      directory.reset();
+    }
+    iter = directories.emplace(zipPath, std::move(directory)).first;
+  }
+  return iter->second.get();
+}
+
+std::vector<std::string> ListZipEntries(
+    const std::string& zipPath,
+    const std::set<std::string>& matchExtensions) {
+  std::vector<std::string> entries;
+  const ZipDirectory* directory = GetZipDirectory(zipPath);
+  if (directory != nullptr) {
+    for (const auto& entry : *directory) {
+      const auto& suffix = FileUtils::GetFileSuffix(entry.first);
+      if (suffix.has_value() &&
+          matchExtensions.find(StringUtils::ToLower(suffix.value())) != matchExtensions.end()) {
+        entries.push_back(entry.first);
+      }
+    }
+  }
+  return entries;
+}
+
+bool ReadZipEntry(const std::string& zipPath, const std::string& entry, std::vector<uint8_t>& bytes) {
+  const ZipDirectory* directory = GetZipDirectory(zipPath);
+  if (directory == nullptr) {
+    return false;
+  }
+  auto iter = directory->find(entry);
+  if (iter == directory->end()) {
+    return false;
+  }
+  const ZipEntry& zipEntry = iter->second;
+
+  std::ifstream file(zipPath, std::ios::binary);
+  uint8_t localHeader[30];
+  if (!file || !ReadDiskBytes(file, zipEntry.localHeaderOffset, 30, localHeader) ||
+      ReadU32(localHeader) != ZIP_LOCAL_HEADER_SIG) {
+    fmt::printf("Warning: Corrupt zip entry %s in %s.\n", entry, zipPath);
+    return false;
+  }
+  // the local header's name and extra field needn't match the central directory's lengths
+  const uint64_t dataOffset =
+      zipEntry.localHeaderOffset + 30 + ReadU16(localHeader + 26) + ReadU16(localHeader + 28);
+
+  std::vector<uint8_t> compressed(zipEntry.compressedSize);
+  if (!ReadDiskBytes(file, dataOffset, zipEntry.compressedSize, compressed.data())) {
+    fmt::printf("Warning: Corrupt zip entry %s in %s.\n", entry, zipPath);
+    return false;
+  }
+  switch (zipEntry.method) {
+    case ZIP_METHOD_STORED:
+      bytes.swap(compressed);
+      return true;
+    case ZIP_METHOD_DEFLATED:
+      // negative window bits select raw deflate data, without zlib header
+      if (Inflate(compressed.data(), compressed.size(), -MAX_WBITS, zipEntry.size, bytes)) {
+        return true;
+      }
+      fmt::printf("Warning: Couldn't decompress zip entry %s in %s.\n", entry, zipPath);
+      return false;
+    default:
+      fmt::printf(
+          "Warning: Zip entry %s in %s uses unsupported compression method %d.\n",
+          entry,
+          zipPath,
+          zipEntry.method);
+      return false;
+  }
+}
+
+bool SplitArchivePath(const std::string& path, std::string& zipPath, std::string& entry) {
+  // look for a leading part of the path that names an existing .zip file
+  size_t pos = 0;
+  while ((pos = path.find_first_of("/\\", pos + 1)) != std::string::npos) {
+    const std::string prefix = path.substr(0, pos);
+    const auto& suffix = FileUtils::GetFileSuffix(prefix);
+    if (suffix.has_value() && StringUtils::ToLower(suffix.value()) == "zip" &&
+        FileUtils::FileExists(prefix)) {
+      zipPath = prefix;
+      entry = path.substr(pos + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>& bytes) {
+  std::string zipPath, entry;
+  if (SplitArchivePath(path, zipPath, entry)) {
+    return ReadZipEntry(zipPath, entry, bytes);
+  }
+  return ReadDiskFile(path, bytes);
+}
+
+bool CopyFile(const std::string& srcFilename, const std::string& dstFilename, bool createPath) {
+  std::string zipPath, entry;
+  if (!SplitArchivePath(srcFilename, zipPath, entry)) {
+    return FileUtils::CopyFile(srcFilename, dstFilename, createPath);
+  }
+  std::vector<uint8_t> bytes;
+  if (!ReadZipEntry(zipPath, entry, bytes)) {
+    fmt::printf("Warning: Couldn't read %s from zip file %s.\n", entry, zipPath);
+    return false;
+  }
+  if (createPath && !FileUtils::CreatePath(dstFilename.c_str())) {
+    fmt::printf("Warning: Couldn't create directory %s.\n", dstFilename);
+    return false;
+  }
+  std::ofstream dstFile(dstFilename, std::ios::binary | std::ios::trunc);
+  if (!dstFile || !dstFile.write((const char*)bytes.data(), bytes.size())) {
+    fmt::printf("Warning: Couldn't write file %s.\n", dstFilename);
+    return false;
+  }
+  return true;
+}
+
+} // namespace ArchiveUtils
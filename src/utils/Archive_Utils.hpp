@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef CopyFile
+#undef CopyFile
+#endif
+
+/**
+ * Read access to compressed inputs without extracting them to disk first: gzip-compressed single
+ * files, and zip bundles. A file inside a zip bundle is addressed by a path that simply runs on
+ * through the archive, e.g. "assets/bundle.zip/textures/wood.png".
+ */
+namespace ArchiveUtils {
+
+// whether the file is a gzip stream or a zip bundle, judging by its leading bytes
+bool IsGzipFile(const std::string& path);
+bool IsZipFile(const std::string& path);
+// zstd streams are recognised, but we don't link a decoder for them
+bool IsZstdFile(const std::string& path);
+
+// read and decompress an entire gzip-compressed file
+bool ReadGzipFile(const std::string& path, std::vector<uint8_t>& bytes);
+
+// list the entries of a zip bundle whose suffix matches one of the given (lower-case) extensions
+std::vector<std::string> ListZipEntries(
+    const std::string& zipPath,
+    const std::set<std::string>& matchExtensions);
+
+// read and decompress one entry of a zip bundle
+bool ReadZipEntry(const std::string& zipPath, const std::string& entry, std::vector<uint8_t>& bytes);
+
+// split a path that runs through a zip bundle into the bundle and the entry within it
+bool SplitArchivePath(const std::string& path, std::string& zipPath, std::string& entry);
+
+inline bool IsArchivePath(const std::string& path) {
+  std::string zipPath, entry;
+  return SplitArchivePath(path, zipPath, entry);
+}
+
+// read the whole of a file, whether it lives on disk or inside a zip bundle
+bool ReadFile(const std::string& path, std::vector<uint8_t>& bytes);
+
+// as FileUtils::CopyFile(), but the source may also live inside a zip bundle
+bool CopyFile(const std::string& srcFilename, const std::string& dstFilename, bool createPath);
+
+} // namespace ArchiveUtils
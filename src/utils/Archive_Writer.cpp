@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Archive_Writer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+#include <zlib.h>
+
+#include "FBX2glTF.h"
+#include "File_Utils.hpp"
+#include "String_Utils.hpp"
+
+static const uint32_t ZIP_LOCAL_HEADER_SIG = 0x04034b50;
+static const uint32_t ZIP_CENTRAL_HEADER_SIG = 0x02014b50;
+static const uint32_t ZIP_END_OF_DIRECTORY_SIG = 0x06054b50;
+
+// 1980-01-01 00:00, the earliest MS-DOS date; fixed so that identical input makes identical zips
+static const uint16_t ZIP_DOS_TIME = 0;
+static const uint16_t ZIP_DOS_DATE = (1 << 5) | 1;
+
+static const size_t TAR_BLOCK_SIZE = 512;
+
+static void PutU16(std::vector<uint8_t>& out, uint16_t v) {
+  out.push_back(v & 0xFF);
+  out.push_back((v >> 8) & 0xFF);
+}
+
+static void PutU32(std::vector<uint8_t>& out, uint32_t v) {
+  PutU16(out, v & 0xFFFF);
+  PutU16(out, (v >> 16) & 0xFFFF);
+}
+
+// images are compressed already; deflating them again would only cost time
+static bool IsCompressedAlready(const std::string& name) {
+  const auto& suffix = FileUtils::GetFileSuffix(name);
+  if (!suffix.has_value()) {
+    return false;
+  }
+  const std::string lower = StringUtils::ToLower(suffix.value());
+  return lower == "png" || lower == "jpg" || lower == "jpeg" || lower == "ktx2" ||
+      lower == "webp";
+}
+
+static bool Deflate(const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // negative window bits: raw deflate data, as zip wants it
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) !=
+      Z_OK) {
+    return false;
+  }
+  out.resize(deflateBound(&stream, in.size()));
+  stream.next_in = const_cast<Bytef*>(in.data());
+  stream.avail_in = (uInt)in.size();
+  stream.next_out = out.data();
+  stream.avail_out = (uInt)out.size();
+  const int status = deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return status == Z_STREAM_END;
+}
+
+ArchiveWriter::ArchiveWriter(Format format, const std::string& path)
+    : format(format), maxPending(std::max(1u, std::thread::hardware_concurrency())), fp(nullptr) {
+  if (path == "-") {
+    // claim the real stdout for the archive, and send everything we print to stderr instead
+    fflush(stdout);
+    const int archiveFd = dup(fileno(stdout));
+    if (archiveFd >= 0 && dup2(fileno(stderr), fileno(stdout)) >= 0) {
+#ifdef _WIN32
+      _setmode(archiveFd, _O_BINARY);
+#endif
+      fp = fdopen(archiveFd, "wb");
+    }
+  } else {
+    fp = fopen(path.c_str(), "wb");
+  }
+}
+
+ArchiveWriter::~ArchiveWriter() {
+  Close();
+}
+
+void ArchiveWriter::AddFile(const std::string& name, std::vector<uint8_t>&& bytes) {
+  if (fp == nullptr || !names.insert(name).second) {
+    return;
+  }
+  const bool compress = (format == ZIP) && !IsCompressedAlready(name);
+  // C++11 lambdas can't capture by move, so the bytes travel to the worker in a shared holder
+  auto holder = std::make_shared<std::vector<uint8_t>>(std::move(bytes));
+  WritePending(maxPending - 1);
+  pending.push_back(std::async(std::launch::async, [name, holder, compress]() {
+    Entry entry;
+    entry.name = name;
+    entry.size = holder->size();
+    entry.crc = crc32(0L, holder->data(), (uInt)holder->size());
+    entry.deflated = false;
+    entry.headerOffset = 0;
+    if (compress && Deflate(*holder, entry.bytes) && entry.bytes.size() < holder->size()) {
+      entry.deflated = true;
+    } else {
+      entry.bytes.swap(*holder);
+    }
+    entry.storedSize = entry.bytes.size();
+    return entry;
+  }));
+  WritePending(maxPending);
+}
+
+void ArchiveWriter::WritePending(size_t keep) {
+  while (!pending.empty()) {
+    if (pending.size() <= keep &&
+        pending.front().wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return;
+    }
+    Entry entry = pending.front().get();
+    pending.pop_front();
+    WriteEntry(entry);
+  }
+}
+
+bool ArchiveWriter::WriteEntry(Entry& entry) {
+  entry.headerOffset = bytesWritten;
+  if (format == TAR) {
+    char header[TAR_BLOCK_SIZE];
+    memset(header, 0, sizeof(header));
+    std::string name = entry.name;
+    std::string prefix;
+    if (name.size() > 99) {
+      // ustar can split long names at a slash into a 155-char prefix and a 100-char name
+      const size_t slash = name.rfind('/', 155);
+      if (slash == std::string::npos || name.size() - slash - 1 > 99) {
+        fmt::printf("Warning: Name too long for tar archive, skipping: %s\n", name);
+        return false;
+      }
+      prefix = name.substr(0, slash);
+      name = name.substr(slash + 1);
+    }
+    memcpy(header, name.data(), name.size());
+    snprintf(header + 100, 8, "%07o", 0644);
+    snprintf(header + 108, 8, "%07o", 0);
+    snprintf(header + 116, 8, "%07o", 0);
+    snprintf(header + 124, 12, "%011llo", (unsigned long long)entry.size);
+    snprintf(header + 136, 12, "%011o", 0);
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    memcpy(header + 345, prefix.data(), prefix.size());
+    // the checksum is computed with its own field filled with spaces
+    memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (size_t ii = 0; ii < sizeof(header); ii++) {
+      checksum += (uint8_t)header[ii];
+    }
+    snprintf(header + 148, 8, "%06o", checksum);
+
+    static const char zeroes[TAR_BLOCK_SIZE] = {};
+    const size_t padding = (TAR_BLOCK_SIZE - (entry.bytes.size() % TAR_BLOCK_SIZE)) % TAR_BLOCK_SIZE;
+    const bool ok = WriteBytes(header, sizeof(header)) &&
+        WriteBytes(entry.bytes.data(), entry.bytes.size()) && WriteBytes(zeroes, padding);
+    entry.bytes.clear();
+    return ok;
+  }
+
+  if (entry.bytes.size() > UINT32_MAX || entry.size > UINT32_MAX || bytesWritten > UINT32_MAX) {
+    fmt::printf("Warning: Zip64 isn't supported, skipping oversized file: %s\n", entry.name);
+    return false;
+  }
+  std::vector<uint8_t> header;
+  PutU32(header, ZIP_LOCAL_HEADER_SIG);
+  PutU16(header, 20); // version needed to extract: 2.0, for deflate
+  PutU16(header, 0); // flags
+  PutU16(header, entry.deflated ? 8 : 0);
+  PutU16(header, ZIP_DOS_TIME);
+  PutU16(header, ZIP_DOS_DATE);
+  PutU32(header, entry.crc);
+  PutU32(header, (uint32_t)entry.storedSize);
+  PutU32(header, (uint32_t)entry.size);
+  PutU16(header, (uint16_t)entry.name.size());
+  PutU16(header, 0); // extra field length
+  header.insert(header.end(), entry.name.begin(), entry.name.end());
+
+  const bool ok = WriteBytes(header.data(), header.size()) &&
+      WriteBytes(entry.bytes.data(), entry.bytes.size());
+  // the central directory only needs the metadata; let go of the data itself
+  entry.bytes = std::vector<uint8_t>();
+  written.push_back(std::move(entry));
+  return ok;
+}
+
+bool ArchiveWriter::WriteZipDirectory() {
+  std::vector<uint8_t> directory;
+  for (const Entry& entry : written) {
+    PutU32(directory, ZIP_CENTRAL_HEADER_SIG);
+    PutU16(directory, 20); // version made by
+    PutU16(directory, 20); // version needed to extract
+    PutU16(directory, 0); // flags
+    PutU16(directory, entry.deflated ? 8 : 0);
+    PutU16(directory, ZIP_DOS_TIME);
+    PutU16(directory, ZIP_DOS_DATE);
+    PutU32(directory, entry.crc);
+    PutU32(directory, (uint32_t)entry.storedSize);
+    PutU32(directory, (uint32_t)entry.size);
+    PutU16(directory, (uint16_t)entry.name.size());
+    PutU16(directory, 0); // extra field length
+    PutU16(directory, 0); // comment length
+    PutU16(directory, 0); // disk number
+    PutU16(directory, 0); // internal attributes
+    PutU32(directory, 0); // external attributes
+    PutU32(directory, (uint32_t)entry.headerOffset);
+    directory.insert(directory.end(), entry.name.begin(), entry.name.end());
+  }
+  if (written.size() > UINT16_MAX || bytesWritten > UINT32_MAX) {
+    fmt::printf("Warning: Zip64 isn't supported; the zip archive will be broken.\n");
+  }
+  const uint32_t directoryOffset = (uint32_t)bytesWritten;
+  const uint32_t directorySize = (uint32_t)directory.size();
+  PutU32(directory, ZIP_END_OF_DIRECTORY_SIG);
+  PutU16(directory, 0); // this disk
+  PutU16(directory, 0); // disk with the directory
+  PutU16(directory, (uint16_t)written.size());
+  PutU16(directory, (uint16_t)written.size());
+  PutU32(directory, directorySize);
+  PutU32(directory, directoryOffset);
+  PutU16(directory, 0); // comment length
+  return WriteBytes(directory.data(), directory.size());
+}
+
+bool ArchiveWriter::WriteBytes(const void* data, size_t size) {
+  if (failed) {
+    return false;
+  }
+  if (size > 0 && fwrite(data, size, 1, fp) != 1) {
+    fmt::printf("Warning: Failed to write %lu bytes to archive.\n", (unsigned long)size);
+    failed = true;
+    return false;
+  }
+  bytesWritten += size;
+  return true;
+}
+
+bool ArchiveWriter::Close() {
+  if (fp == nullptr) {
+    return false;
+  }
+  WritePending(0);
+  if (format == ZIP) {
+    WriteZipDirectory();
+  } else {
+    // a tar archive ends with two empty blocks
+    static const char zeroes[2 * TAR_BLOCK_SIZE] = {};
+    WriteBytes(zeroes, sizeof(zeroes));
+  }
+  if (fclose(fp) != 0) {
+    failed = true;
+  }
+  fp = nullptr;
+  return !failed;
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Writes a zip or tar archive, one file at a time, straight to its destination; a path of "-"
+ * means stdout. For zip archives, each file is deflated on a thread of its own as soon as it's
+ * added, except for images that are compressed already, which are simply stored; with as many
+ * files in flight as there are cores, adding another waits for the oldest. Files are still written
+ * out in the order they were added, as soon as all the files before them are done.
+ */
+class ArchiveWriter {
+ public:
+  enum Format { ZIP, TAR };
+
+  ArchiveWriter(Format format, const std::string& path);
+  ~ArchiveWriter();
+
+  bool IsOpen() const {
+    return fp != nullptr;
+  }
+
+  // add a file to the archive under the given name; names already added are quietly ignored
+  void AddFile(const std::string& name, std::vector<uint8_t>&& bytes);
+  bool HasFile(const std::string& name) const {
+    return names.find(name) != names.end();
+  }
+
+  // write out whatever's still pending and the archive trailer, and close it
+  bool Close();
+
+  uint64_t GetBytesWritten() const {
+    return bytesWritten;
+  }
+
+ private:
+  struct Entry {
+    std::string name;
+    std::vector<uint8_t> bytes; // the file as stored, i.e. possibly deflated
+    uint64_t storedSize;
+    uint64_t size; // the original size
+    uint32_t crc;
+    bool deflated;
+    uint64_t headerOffset;
+  };
+
+  // write out the finished files at the front of the queue, waiting on unfinished ones until no
+  // more than 'keep' are left
+  void WritePending(size_t keep);
+  bool WriteEntry(Entry& entry);
+  bool WriteZipDirectory();
+  bool WriteBytes(const void* data, size_t size);
+
+  const Format format;
+  const size_t maxPending;
+  FILE* fp;
+  bool failed{false};
+  uint64_t bytesWritten{0};
+
+  std::set<std::string> names;
+  std::deque<std::future<Entry>> pending;
+  // what the zip central directory needs to know about each written entry
+  std::vector<Entry> written;
+};
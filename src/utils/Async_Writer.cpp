@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Async_Writer.hpp"
+
+#include <algorithm>
+
+#include <fmt/printf.h>
+
+// writes go out in multiples of this size, except for the very last one
+static const size_t WRITE_BLOCK_BYTES = 4 * 1024 * 1024;
+// how much data may wait in the queue before the producer has to wait for the writer
+static const size_t MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+AsyncFileWriter::AsyncFileWriter(const std::string& path) : fp(fopen(path.c_str(), "wb")) {
+  if (fp != nullptr) {
+    // we do our own buffering
+    setvbuf(fp, nullptr, _IONBF, 0);
+    thread = std::thread(&AsyncFileWriter::Run, this);
+  }
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  Close();
+}
+
+void AsyncFileWriter::Write(std::vector<uint8_t>&& bytes) {
+  if (fp == nullptr || bytes.empty()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  queueChanged.wait(lock, [this] { return queuedBytes < MAX_QUEUED_BYTES; });
+  queuedBytes += bytes.size();
+  queue.emplace_back(std::move(bytes));
+  lock.unlock();
+  queueChanged.notify_all();
+}
+
+bool AsyncFileWriter::Close() {
+  if (fp == nullptr) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+  }
+  queueChanged.notify_all();
+  thread.join();
+
+  if (fclose(fp) != 0) {
+    failed = true;
+  }
+  fp = nullptr;
+  return !failed;
+}
+
+void AsyncFileWriter::Run() {
+  pending.reserve(WRITE_BLOCK_BYTES);
+  while (true) {
+    std::vector<uint8_t> chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      queueChanged.wait(lock, [this] { return closing || !queue.empty(); });
+      if (queue.empty()) {
+        break;
+      }
+      chunk = std::move(queue.front());
+      queue.pop_front();
+      queuedBytes -= chunk.size();
+    }
+    queueChanged.notify_all();
+
+    // top up the pending block, write out as many whole blocks as we can, and keep the rest
+    size_t consumed = 0;
+    if (!pending.empty()) {
+      consumed = std::min(WRITE_BLOCK_BYTES - pending.size(), chunk.size());
+      pending.insert(pending.end(), chunk.begin(), chunk.begin() + consumed);
+      if (pending.size() < WRITE_BLOCK_BYTES) {
+        continue;
+      }
+      WriteBlock(pending.data(), pending.size());
+      pending.clear();
+    }
+    const size_t wholeBlocks = (chunk.size() - consumed) / WRITE_BLOCK_BYTES;
+    if (wholeBlocks > 0) {
+      WriteBlock(&chunk[consumed], wholeBlocks * WRITE_BLOCK_BYTES);
+      consumed += wholeBlocks * WRITE_BLOCK_BYTES;
+    }
+    pending.insert(pending.end(), chunk.begin() + consumed, chunk.end());
+  }
+  if (!pending.empty()) {
+    WriteBlock(pending.data(), pending.size());
+    pending.clear();
+  }
+}
+
+bool AsyncFileWriter::WriteBlock(const uint8_t* data, size_t size) {
+  if (failed) {
+    return false;
+  }
+  if (fwrite(data, size, 1, fp) != 1) {
+    fmt::fprintf(stderr, "ERROR: Failed to write %lu bytes.\n", (unsigned long)size);
+    failed = true;
+    return false;
+  }
+  bytesWritten += size;
+  return true;
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes chunks of data to a file on a background thread, in the order they were handed over,
+ * so that producing the data and writing it to disk can overlap. Small chunks are gathered up
+ * into large block-sized writes; if the writer falls too far behind, Write() blocks.
+ */
+class AsyncFileWriter {
+ public:
+  explicit AsyncFileWriter(const std::string& path);
+  ~AsyncFileWriter();
+
+  bool IsOpen() const {
+    return fp != nullptr;
+  }
+
+  void Write(std::vector<uint8_t>&& bytes);
+
+  // wait for all outstanding data to hit the file, and close it; returns false on any failure
+  bool Close();
+
+  size_t GetBytesWritten() const {
+    return bytesWritten;
+  }
+
+ private:
+  void Run();
+  bool WriteBlock(const uint8_t* data, size_t size);
+
+  FILE* fp;
+  std::thread thread;
+
+  std::mutex mutex;
+  std::condition_variable queueChanged;
+  std::deque<std::vector<uint8_t>> queue;
+  size_t queuedBytes{0};
+  bool closing{false};
+
+  // only touched by the writer thread until it's been joined
+  std::vector<uint8_t> pending;
+  size_t bytesWritten{0};
+  bool failed{false};
+};
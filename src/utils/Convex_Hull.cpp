@@ -0,0 +1,256 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Convex_Hull.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+namespace ConvexHull {
+
+namespace {
+struct Face {
+  uint32_t v[3];
+  Vec3f normal;
+  float offset; // the face's plane is dot(normal, p) == offset
+  std::vector<uint32_t> outside; // points in front of this face, and no earlier one
+  bool alive;
+};
+} // namespace
+
+static Face makeFace(const std::vector<Vec3f>& points, uint32_t a, uint32_t b, uint32_t c) {
+  Face face;
+  face.v[0] = a;
+  face.v[1] = b;
+  face.v[2] = c;
+  const Vec3f normal = Vec3f::CrossProduct(points[b] - points[a], points[c] - points[a]);
+  const float length = normal.Length();
+  face.normal = (length > 0.0f) ? normal / length : Vec3f(0.0f);
+  face.offset = Vec3f::DotProduct(face.normal, points[a]);
+  face.alive = true;
+  return face;
+}
+
+static float distance(const Face& face, const Vec3f& p) {
+  return Vec3f::DotProduct(face.normal, p) - face.offset;
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+  return ((uint64_t)a << 32) | b;
+}
+
+bool Build(
+    const std::vector<Vec3f>& points,
+    int maxVertices,
+    std::vector<Vec3f>& positions,
+    std::vector<uint32_t>& indices) {
+  positions.clear();
+  indices.clear();
+  if (points.size() < 4) {
+    return false;
+  }
+
+  // the extreme points along each axis seed the initial tetrahedron
+  uint32_t extremes[6] = {0, 0, 0, 0, 0, 0};
+  for (uint32_t ii = 1; ii < points.size(); ii++) {
+    for (int axis = 0; axis < 3; axis++) {
+      if (points[ii][axis] < points[extremes[2 * axis]][axis]) {
+        extremes[2 * axis] = ii;
+      }
+      if (points[ii][axis] > points[extremes[2 * axis + 1]][axis]) {
+        extremes[2 * axis + 1] = ii;
+      }
+    }
+  }
+  float scale = 0.0f;
+  for (int axis = 0; axis < 3; axis++) {
+    scale = std::max(
+        scale, fabsf(points[extremes[2 * axis + 1]][axis] - points[extremes[2 * axis]][axis]));
+  }
+  const float epsilon = 1e-5f * scale;
+  if (scale <= 0.0f) {
+    return false;
+  }
+
+  uint32_t i0 = 0, i1 = 0;
+  float best = -1.0f;
+  for (int ii = 0; ii < 6; ii++) {
+    for (int jj = ii + 1; jj < 6; jj++) {
+      const float d = (points[extremes[ii]] - points[extremes[jj]]).LengthSquared();
+      if (d > best) {
+        best = d;
+        i0 = extremes[ii];
+        i1 = extremes[jj];
+      }
+    }
+  }
+  const Vec3f axis = (points[i1] - points[i0]).Normalized();
+  uint32_t i2 = 0;
+  best = -1.0f;
+  for (uint32_t ii = 0; ii < points.size(); ii++) {
+    const float d = Vec3f::CrossProduct(points[ii] - points[i0], axis).Length();
+    if (d > best) {
+      best = d;
+      i2 = ii;
+    }
+  }
+  if (best <= epsilon) {
+    return false;
+  }
+  const Face base = makeFace(points, i0, i1, i2);
+  uint32_t i3 = 0;
+  best = -1.0f;
+  for (uint32_t ii = 0; ii < points.size(); ii++) {
+    const float d = fabsf(distance(base, points[ii]));
+    if (d > best) {
+      best = d;
+      i3 = ii;
+    }
+  }
+  if (best <= epsilon) {
+    return false;
+  }
+
+  std::vector<Face> faces;
+  std::unordered_map<uint64_t, int> faceByEdge;
+  auto addFace = [&](uint32_t a, uint32_t b, uint32_t c) {
+    faces.push_back(makeFace(points, a, b, c));
+    faceByEdge[edgeKey(a, b)] = (int)faces.size() - 1;
+    faceByEdge[edgeKey(b, c)] = (int)faces.size() - 1;
+    faceByEdge[edgeKey(c, a)] = (int)faces.size() - 1;
+  };
+  if (distance(base, points[i3]) > 0.0f) {
+    addFace(i0, i2, i1);
+    addFace(i0, i1, i3);
+    addFace(i1, i2, i3);
+    addFace(i2, i0, i3);
+  } else {
+    addFace(i0, i1, i2);
+    addFace(i0, i3, i1);
+    addFace(i1, i3, i2);
+    addFace(i2, i3, i0);
+  }
+
+  for (uint32_t ii = 0; ii < points.size(); ii++) {
+    if (ii == i0 || ii == i1 || ii == i2 || ii == i3) {
+      continue;
+    }
+    for (Face& face : faces) {
+      if (distance(face, points[ii]) > epsilon) {
+        face.outside.push_back(ii);
+        break;
+      }
+    }
+  }
+
+  int vertexCount = 4;
+  std::vector<int> visible, stack;
+  std::vector<std::pair<uint32_t, uint32_t>> horizon;
+  while (vertexCount < maxVertices) {
+    int eyeFace = -1;
+    uint32_t eye = 0;
+    float eyeDistance = epsilon;
+    for (int faceIx = 0; faceIx < (int)faces.size(); faceIx++) {
+      if (!faces[faceIx].alive) {
+        continue;
+      }
+      for (uint32_t pointIx : faces[faceIx].outside) {
+        const float d = distance(faces[faceIx], points[pointIx]);
+        if (d > eyeDistance) {
+          eyeDistance = d;
+          eyeFace = faceIx;
+          eye = pointIx;
+        }
+      }
+    }
+    if (eyeFace < 0) {
+      break;
+    }
+
+    // flood out from the face the eye point is furthest from, to every face that can see it
+    visible.clear();
+    horizon.clear();
+    stack.assign(1, eyeFace);
+    faces[eyeFace].alive = false;
+    while (!stack.empty()) {
+      const int faceIx = stack.back();
+      stack.pop_back();
+      visible.push_back(faceIx);
+      for (int edge = 0; edge < 3; edge++) {
+        const uint32_t a = faces[faceIx].v[edge], b = faces[faceIx].v[(edge + 1) % 3];
+        const int neighbour = faceByEdge[edgeKey(b, a)];
+        if (!faces[neighbour].alive) {
+          continue;
+        }
+        if (distance(faces[neighbour], points[eye]) > epsilon) {
+          faces[neighbour].alive = false;
+          stack.push_back(neighbour);
+        }
+      }
+    }
+    // a visible face's edge is on the horizon if the face across it stays
+    for (int faceIx : visible) {
+      for (int edge = 0; edge < 3; edge++) {
+        const uint32_t a = faces[faceIx].v[edge], b = faces[faceIx].v[(edge + 1) % 3];
+        if (faces[faceByEdge[edgeKey(b, a)]].alive) {
+          horizon.emplace_back(a, b);
+        }
+      }
+    }
+
+    const size_t firstNewFace = faces.size();
+    for (const auto& edge : horizon) {
+      addFace(edge.first, edge.second, eye);
+    }
+    for (int faceIx : visible) {
+      for (uint32_t pointIx : faces[faceIx].outside) {
+        if (pointIx == eye) {
+          continue;
+        }
+        for (size_t newIx = firstNewFace; newIx < faces.size(); newIx++) {
+          if (distance(faces[newIx], points[pointIx]) > epsilon) {
+            faces[newIx].outside.push_back(pointIx);
+            break;
+          }
+        }
+      }
+      std::vector<uint32_t>().swap(faces[faceIx].outside);
+    }
+    vertexCount++;
+  }
+
+  std::unordered_map<uint32_t, uint32_t> compactIndex;
+  for (const Face& face : faces) {
+    if (!face.alive) {
+      continue;
+    }
+    for (uint32_t pointIx : face.v) {
+      auto inserted = compactIndex.emplace(pointIx, (uint32_t)positions.size());
+      if (inserted.second) {
+        positions.push_back(points[pointIx]);
+      }
+      indices.push_back(inserted.first->second);
+    }
+  }
+  return true;
+}
+
+float Volume(const std::vector<Vec3f>& positions, const std::vector<uint32_t>& indices) {
+  float volume = 0.0f;
+  for (size_t ii = 0; ii + 2 < indices.size(); ii += 3) {
+    const Vec3f& a = positions[indices[ii]];
+    const Vec3f& b = positions[indices[ii + 1]];
+    const Vec3f& c = positions[indices[ii + 2]];
+    volume += Vec3f::DotProduct(a, Vec3f::CrossProduct(b, c));
+  }
+  return volume / 6.0f;
+}
+
+} // namespace ConvexHull
@@ -0,0 +1,35 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mathfu.hpp"
+
+namespace ConvexHull {
+
+/**
+ * Build the convex hull of a point cloud by quickhull, as an outward-facing triangle list over its
+ * own compact vertex array. The hull grows by the furthest outside point first, so when it's capped
+ * at 'maxVertices' the result is the best approximation quickhull found on the way, slightly inside
+ * the true hull.
+ *
+ * Returns false, and leaves the output empty, if the points are (nearly) flat.
+ */
+bool Build(
+    const std::vector<Vec3f>& points,
+    int maxVertices,
+    std::vector<Vec3f>& positions,
+    std::vector<uint32_t>& indices);
+
+/** The volume enclosed by a closed, outward-facing triangle list. */
+float Volume(const std::vector<Vec3f>& positions, const std::vector<uint32_t>& indices);
+
+} // namespace ConvexHull
@@ -90,4 +90,31 @@ bool CopyFile(const std::string& srcFilename, const std::string& dstFilename, bo
       srcSize);
   return false;
 }
+
+bool WriteFileAtomically(const std::string& path, const std::vector<uint8_t>& bytes) {
+  const boost::filesystem::path tempPath =
+      boost::filesystem::unique_path(path + ".%%%%-%%%%-%%%%.tmp");
+  {
+    std::ofstream file(tempPath.string(), std::ios::binary | std::ios::trunc);
+    if (!file) {
+      fmt::printf("Warning: Couldn't open file %s for writing.\n", tempPath.string());
+      return false;
+    }
+    file.write((const char*)bytes.data(), bytes.size());
+    if (!file) {
+      fmt::printf("Warning: Failed to write %lu bytes to %s.\n", bytes.size(), tempPath.string());
+      file.close();
+      boost::filesystem::remove(tempPath);
+      return false;
+    }
+  }
+  boost::system::error_code error;
+  boost::filesystem::rename(tempPath, path, error);
+  if (error) {
+    fmt::printf("Warning: Couldn't move %s into place: %s\n", path, error.message());
+    boost::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
 } // namespace FileUtils
@@ -37,10 +37,22 @@ bool CopyFile(
     const std::string& dstFilename,
     bool createPath = false);
 
+// write to a temporary file beside the destination and rename it into place, so that concurrent
+// conversions writing the same file never leave, or read, a partial one
+bool WriteFileAtomically(const std::string& path, const std::vector<uint8_t>& bytes);
+
 inline std::string GetAbsolutePath(const std::string& filePath) {
   return boost::filesystem::absolute(filePath).string();
 }
 
+// the path of 'path' from the folder 'base', with forward slashes as in a URI; or "" if there is
+// no such path (say, on another drive)
+inline std::string GetRelativePath(const std::string& path, const std::string& base) {
+  const auto relativePath = boost::filesystem::relative(
+      boost::filesystem::absolute(path), boost::filesystem::absolute(base));
+  return relativePath.generic_string();
+}
+
 inline std::string GetCurrentFolder() {
   return boost::filesystem::current_path().string();
 }
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Hash_Utils.hpp"
+
+#include <cstring>
+
+namespace HashUtils {
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static uint32_t rotateRight(uint32_t value, int bits) {
+  return (value >> bits) | (value << (32 - bits));
+}
+
+static void compressBlock(uint32_t state[8], const uint8_t block[64]) {
+  uint32_t w[64];
+  for (int ii = 0; ii < 16; ii++) {
+    w[ii] = ((uint32_t)block[4 * ii] << 24) | ((uint32_t)block[4 * ii + 1] << 16) |
+        ((uint32_t)block[4 * ii + 2] << 8) | (uint32_t)block[4 * ii + 3];
+  }
+  for (int ii = 16; ii < 64; ii++) {
+    const uint32_t s0 =
+        rotateRight(w[ii - 15], 7) ^ rotateRight(w[ii - 15], 18) ^ (w[ii - 15] >> 3);
+    const uint32_t s1 =
+        rotateRight(w[ii - 2], 17) ^ rotateRight(w[ii - 2], 19) ^ (w[ii - 2] >> 10);
+    w[ii] = w[ii - 16] + s0 + w[ii - 7] + s1;
+  }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int ii = 0; ii < 64; ii++) {
+    const uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+    const uint32_t choice = (e & f) ^ (~e & g);
+    const uint32_t t1 = h + s1 + choice + SHA256_K[ii] + w[ii];
+    const uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+    const uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+    const uint32_t t2 = s0 + majority;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+std::string Sha256(const uint8_t* bytes, size_t length) {
+  uint32_t state[8] = {
+      0x6a09e667,
+      0xbb67ae85,
+      0x3c6ef372,
+      0xa54ff53a,
+      0x510e527f,
+      0x9b05688c,
+      0x1f83d9ab,
+      0x5be0cd19,
+  };
+  size_t offset = 0;
+  for (; offset + 64 <= length; offset += 64) {
+    compressBlock(state, bytes + offset);
+  }
+
+  // the tail, a one bit, zeroes up to 56 bytes into a block, and the length in bits, big-endian
+  uint8_t tail[128] = {};
+  const size_t tailLength = length - offset;
+  if (tailLength > 0) {
+    memcpy(tail, bytes + offset, tailLength);
+  }
+  tail[tailLength] = 0x80;
+  const size_t tailBlocks = (tailLength + 1 + 8 <= 64) ? 1 : 2;
+  const uint64_t bitLength = (uint64_t)length * 8;
+  for (int ii = 0; ii < 8; ii++) {
+    tail[tailBlocks * 64 - 1 - ii] = (uint8_t)(bitLength >> (8 * ii));
+  }
+  for (size_t block = 0; block < tailBlocks; block++) {
+    compressBlock(state, tail + 64 * block);
+  }
+
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  std::string result;
+  for (const uint32_t word : state) {
+    for (int shift = 28; shift >= 0; shift -= 4) {
+      result += HEX_DIGITS[(word >> shift) & 0xF];
+    }
+  }
+  return result;
+}
+
+} // namespace HashUtils
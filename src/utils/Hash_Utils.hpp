@@ -0,0 +1,21 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace HashUtils {
+
+// The SHA-256 digest of the bytes, as 64 lowercase hex digits; for names that have to stay unique
+// however many files share them, and that nobody should be able to collide on purpose.
+std::string Sha256(const uint8_t* bytes, size_t length);
+
+} // namespace HashUtils
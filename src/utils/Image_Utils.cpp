@@ -9,7 +9,13 @@
 #include "Image_Utils.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <string>
+#include <vector>
+
+#include "Archive_Utils.hpp"
+#include "Texture_Cache.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 
@@ -21,20 +27,21 @@
 
 namespace ImageUtils {
 
-static bool imageHasTransparentPixels(FILE* f) {
+static bool imageHasTransparentPixels(const std::vector<uint8_t>& bytes) {
   int width, height, channels;
   // RGBA: we have to load the pixels to figure out if the image is fully opaque
-  uint8_t* pixels = stbi_load_from_file(f, &width, &height, &channels, 0);
+  uint8_t* pixels =
+      stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &channels, 0);
+  bool result = false;
   if (pixels != nullptr) {
     int pixelCount = width * height;
-    for (int ix = 0; ix < pixelCount; ix++) {
+    for (int ix = 0; ix < pixelCount && !result; ix++) {
       // test fourth byte (alpha); 255 is 1.0
-      if (pixels[4 * ix + 3] != 255) {
-        return true;
-      }
+      result = (pixels[4 * ix + 3] != 255);
     }
+    stbi_image_free(pixels);
   }
-  return false;
+  return result;
 }
 
 ImageProperties GetImageProperties(char const* filePath) {
@@ -44,22 +51,236 @@ ImageProperties GetImageProperties(char const* filePath) {
       IMAGE_OPAQUE,
   };
 
-  FILE* f = fopen(filePath, "rb");
-  if (f == nullptr) {
+  // the file may live on disk or inside a zip bundle
+  std::vector<uint8_t> bytes;
+  if (!ArchiveUtils::ReadFile(filePath, bytes) || bytes.empty()) {
     return result;
   }
 
+  // decoding every pixel to look for transparency is slow; remember the answer across runs
+  TextureCache* cache = TextureCache::Get();
+  std::string cacheKey;
+  if (cache != nullptr) {
+    cacheKey = "properties|" + TextureCache::HashBytes(bytes.data(), bytes.size());
+    std::vector<uint8_t> cached;
+    if (cache->Load(cacheKey, cached) && cached.size() == sizeof(result)) {
+      memcpy(&result, cached.data(), sizeof(result));
+      return result;
+    }
+  }
+
   int channels;
-  int success = stbi_info_from_file(f, &result.width, &result.height, &channels);
+  int success = stbi_info_from_memory(
+      bytes.data(), (int)bytes.size(), &result.width, &result.height, &channels);
 
-  if (success && channels == 4 && imageHasTransparentPixels(f)) {
+  if (success && channels == 4 && imageHasTransparentPixels(bytes)) {
     result.occlusion = IMAGE_TRANSPARENT;
   }
 
-  fclose(f);
+  if (!cacheKey.empty()) {
+    std::vector<uint8_t> cached(sizeof(result));
+    memcpy(cached.data(), &result, sizeof(result));
+    cache->Store(cacheKey, cached);
+  }
   return result;
 }
 
+bool GetUniformColor(const std::string& filePath, float tolerance, std::array<float, 4>& color) {
+  std::vector<uint8_t> bytes;
+  if (!ArchiveUtils::ReadFile(filePath, bytes) || bytes.empty()) {
+    return false;
+  }
+  int width, height, channels;
+  uint8_t* pixels =
+      stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &channels, 4);
+  if (pixels == nullptr) {
+    return false;
+  }
+
+  const int maxSpread = (int)(tolerance * 255.0f + 0.5f);
+  uint8_t lo[4], hi[4];
+  memcpy(lo, pixels, 4);
+  memcpy(hi, pixels, 4);
+  bool uniform = true;
+  const int pixelCount = width * height;
+  for (int ix = 1; ix < pixelCount && uniform; ix++) {
+    for (int jj = 0; jj < 4; jj++) {
+      const uint8_t v = pixels[4 * ix + jj];
+      lo[jj] = std::min(lo[jj], v);
+      hi[jj] = std::max(hi[jj], v);
+      uniform = uniform && (hi[jj] - lo[jj] <= maxSpread);
+    }
+  }
+  stbi_image_free(pixels);
+
+  if (uniform) {
+    for (int jj = 0; jj < 4; jj++) {
+      color[jj] = (lo[jj] + hi[jj]) / (2.0f * 255.0f);
+    }
+  }
+  return uniform;
+}
+
+/** Write 8-bit pixels as JPEG if the file name says so, and as PNG otherwise. */
+static bool writeImage(
+    const std::string& path,
+    int width,
+    int height,
+    int channels,
+    const std::vector<uint8_t>& pixels) {
+  std::string suffix = path.substr(path.find_last_of('.') + 1);
+  std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
+  if (suffix == "jpg" || suffix == "jpeg") {
+    return stbi_write_jpg(path.c_str(), width, height, channels, pixels.data(), 95) != 0;
+  }
+  return stbi_write_png(path.c_str(), width, height, channels, pixels.data(), width * channels) !=
+      0;
+}
+
+bool CropImage(
+    const std::string& srcPath,
+    const std::string& dstPath,
+    int x,
+    int y,
+    int width,
+    int height) {
+  std::vector<uint8_t> bytes;
+  if (!ArchiveUtils::ReadFile(srcPath, bytes) || bytes.empty() ||
+      stbi_is_16_bit_from_memory(bytes.data(), (int)bytes.size())) {
+    return false;
+  }
+  int srcWidth, srcHeight, channels;
+  uint8_t* pixels =
+      stbi_load_from_memory(bytes.data(), (int)bytes.size(), &srcWidth, &srcHeight, &channels, 0);
+  if (pixels == nullptr) {
+    return false;
+  }
+  if (x < 0 || y < 0 || width <= 0 || height <= 0 || x + width > srcWidth ||
+      y + height > srcHeight) {
+    stbi_image_free(pixels);
+    return false;
+  }
+
+  std::vector<uint8_t> cropped((size_t)width * height * channels);
+  for (int row = 0; row < height; row++) {
+    memcpy(
+        &cropped[(size_t)row * width * channels],
+        &pixels[((size_t)(y + row) * srcWidth + x) * channels],
+        (size_t)width * channels);
+  }
+  stbi_image_free(pixels);
+
+  return writeImage(dstPath, width, height, channels, cropped);
+}
+
+bool ReadPixels(const std::string& path, int& width, int& height, std::vector<uint8_t>& rgba) {
+  std::vector<uint8_t> bytes;
+  if (!ArchiveUtils::ReadFile(path, bytes) || bytes.empty()) {
+    return false;
+  }
+  int channels;
+  uint8_t* pixels =
+      stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &channels, 4);
+  if (pixels == nullptr) {
+    return false;
+  }
+  rgba.assign(pixels, pixels + (size_t)width * height * 4);
+  stbi_image_free(pixels);
+  return true;
+}
+
+bool WritePixels(
+    const std::string& path,
+    int width,
+    int height,
+    const std::vector<uint8_t>& rgba) {
+  return writeImage(path, width, height, 4, rgba);
+}
+
+static float srgbToLinear(float value) {
+  return (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value) {
+  return (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+bool DownsampleImage(
+    const std::string& srcPath,
+    const std::string& dstPath,
+    int width,
+    int height,
+    ImageEncoding encoding) {
+  std::vector<uint8_t> bytes;
+  if (!ArchiveUtils::ReadFile(srcPath, bytes) || bytes.empty() ||
+      stbi_is_16_bit_from_memory(bytes.data(), (int)bytes.size())) {
+    return false;
+  }
+  int srcWidth, srcHeight, channels;
+  uint8_t* pixels =
+      stbi_load_from_memory(bytes.data(), (int)bytes.size(), &srcWidth, &srcHeight, &channels, 0);
+  if (pixels == nullptr) {
+    return false;
+  }
+  if (width <= 0 || height <= 0 || width > srcWidth || height > srcHeight) {
+    stbi_image_free(pixels);
+    return false;
+  }
+
+  // alpha is never colour, and greyscale normal maps make no sense
+  const int colorChannels = (channels == 2 || channels == 4) ? channels - 1 : channels;
+  float toLinear[256];
+  for (int ii = 0; ii < 256; ii++) {
+    toLinear[ii] = (encoding == IMAGE_SRGB) ? srgbToLinear(ii / 255.0f) : ii / 255.0f;
+  }
+
+  std::vector<uint8_t> scaled((size_t)width * height * channels);
+  std::vector<float> sum(channels);
+  for (int yy = 0; yy < height; yy++) {
+    const int sy0 = (int)((int64_t)yy * srcHeight / height);
+    const int sy1 = std::max(sy0 + 1, (int)((int64_t)(yy + 1) * srcHeight / height));
+    for (int xx = 0; xx < width; xx++) {
+      const int sx0 = (int)((int64_t)xx * srcWidth / width);
+      const int sx1 = std::max(sx0 + 1, (int)((int64_t)(xx + 1) * srcWidth / width));
+      std::fill(sum.begin(), sum.end(), 0.0f);
+      for (int sy = sy0; sy < sy1; sy++) {
+        for (int sx = sx0; sx < sx1; sx++) {
+          const uint8_t* p = &pixels[((size_t)sy * srcWidth + sx) * channels];
+          for (int cc = 0; cc < channels; cc++) {
+            sum[cc] += (cc < colorChannels) ? toLinear[p[cc]] : p[cc] / 255.0f;
+          }
+        }
+      }
+      const float count = (float)((sy1 - sy0) * (sx1 - sx0));
+      for (int cc = 0; cc < channels; cc++) {
+        sum[cc] /= count;
+      }
+      if (encoding == IMAGE_SRGB) {
+        for (int cc = 0; cc < colorChannels; cc++) {
+          sum[cc] = linearToSrgb(sum[cc]);
+        }
+      } else if (encoding == IMAGE_NORMAL_MAP && colorChannels == 3) {
+        float n[3], length = 0;
+        for (int cc = 0; cc < 3; cc++) {
+          n[cc] = sum[cc] * 2.0f - 1.0f;
+          length += n[cc] * n[cc];
+        }
+        length = sqrtf(length);
+        for (int cc = 0; cc < 3 && length > 0; cc++) {
+          sum[cc] = n[cc] / length * 0.5f + 0.5f;
+        }
+      }
+      uint8_t* out = &scaled[((size_t)yy * width + xx) * channels];
+      for (int cc = 0; cc < channels; cc++) {
+        out[cc] = (uint8_t)std::max(0.0f, std::min(255.0f, sum[cc] * 255.0f + 0.5f));
+      }
+    }
+  }
+  stbi_image_free(pixels);
+
+  return writeImage(dstPath, width, height, channels, scaled);
+}
+
 std::string suffixToMimeType(std::string suffix) {
   std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
 
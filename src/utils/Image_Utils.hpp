@@ -8,7 +8,10 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace ImageUtils {
 
@@ -22,6 +25,52 @@ struct ImageProperties {
 
 ImageProperties GetImageProperties(char const* filePath);
 
+/**
+ * Determine whether every pixel of the image is the same colour, give or take the tolerance (in
+ * [0, 1] units per channel). If so, return true and the colour, as stored, in [0, 1] RGBA.
+ */
+bool GetUniformColor(const std::string& filePath, float tolerance, std::array<float, 4>& color);
+
+/**
+ * Write the given pixel rectangle of an 8-bit image to a new file, as JPEG if the destination
+ * name says so and PNG otherwise. Returns false if the source can't be decoded (this includes
+ * 16-bit images, which we won't narrow) or the destination can't be written.
+ */
+bool CropImage(
+    const std::string& srcPath,
+    const std::string& dstPath,
+    int x,
+    int y,
+    int width,
+    int height);
+
+/**
+ * Decode an image as 8-bit RGBA, narrowing 16-bit channels. Returns false if it can't be decoded.
+ */
+bool ReadPixels(const std::string& path, int& width, int& height, std::vector<uint8_t>& rgba);
+
+/** Write 8-bit RGBA pixels to a new file, like CropImage() does. */
+bool WritePixels(
+    const std::string& path,
+    int width,
+    int height,
+    const std::vector<uint8_t>& rgba);
+
+/** How pixel values should be treated when filtering. */
+enum ImageEncoding { IMAGE_LINEAR, IMAGE_SRGB, IMAGE_NORMAL_MAP };
+
+/**
+ * Shrink an 8-bit image to the given size by averaging the source pixels under each destination
+ * pixel, and write it like CropImage() does. sRGB colours are averaged in linear space, and normal
+ * map texels are renormalised.
+ */
+bool DownsampleImage(
+    const std::string& srcPath,
+    const std::string& dstPath,
+    int width,
+    int height,
+    ImageEncoding encoding);
+
 /**
  * Very simple method for mapping filename suffix to mime type. The glTF 2.0 spec only accepts
  * values "image/jpeg" and "image/png" so we don't need to get too fancy.
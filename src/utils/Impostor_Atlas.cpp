@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Impostor_Atlas.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "Parallel_Utils.hpp"
+
+namespace ImpostorAtlas {
+
+static float srgbToLinear(float value) {
+  return (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value) {
+  return (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static uint8_t toByte(float value) {
+  return (uint8_t)std::max(0.0f, std::min(255.0f, value * 255.0f + 0.5f));
+}
+
+Vec3f FrameDirection(int x, int y, int frames) {
+  const float u = (x + 0.5f) / frames * 2.0f - 1.0f;
+  const float v = (y + 0.5f) / frames * 2.0f - 1.0f;
+  float dx = u, dz = v;
+  const float dy = 1.0f - fabsf(u) - fabsf(v);
+  if (dy < 0.0f) {
+    // the lower half of the octahedron is folded out over the corners
+    dx = (1.0f - fabsf(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+    dz = (1.0f - fabsf(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+  }
+  return Vec3f(dx, dy, dz).Normalized();
+}
+
+// bilinear, wrapping, in linear colour
+static Vec4f sampleTexture(const Material& material, const float toLinear[256], const Vec2f& uv) {
+  const int width = material.width, height = material.height;
+  const float x = (uv[0] - floorf(uv[0])) * width - 0.5f;
+  const float y = (uv[1] - floorf(uv[1])) * height - 0.5f;
+  const int x0 = (int)floorf(x), y0 = (int)floorf(y);
+  const float fx = x - x0, fy = y - y0;
+  Vec4f result(0.0f);
+  for (int corner = 0; corner < 4; corner++) {
+    const int cx = ((x0 + (corner & 1)) % width + width) % width;
+    const int cy = ((y0 + (corner >> 1)) % height + height) % height;
+    const float weight = ((corner & 1) ? fx : 1.0f - fx) * ((corner & 2) ? fy : 1.0f - fy);
+    const uint8_t* texel = &material.texels[((size_t)cy * width + cx) * 4];
+    result = result +
+        Vec4f(toLinear[texel[0]], toLinear[texel[1]], toLinear[texel[2]], texel[3] / 255.0f) *
+            weight;
+  }
+  return result;
+}
+
+void Bake(
+    const std::vector<Vertex>& vertices,
+    const std::vector<Triangle>& triangles,
+    const std::vector<Material>& materials,
+    const Vec3f& center,
+    float radius,
+    int frames,
+    int frameSize,
+    std::vector<uint8_t>& albedo,
+    std::vector<uint8_t>& normalDepth) {
+  const int atlasSize = frames * frameSize;
+  albedo.assign((size_t)atlasSize * atlasSize * 4, 0);
+  normalDepth.assign((size_t)atlasSize * atlasSize * 4, 0);
+  if (radius <= 0.0f) {
+    return;
+  }
+  float toLinear[256];
+  for (int ii = 0; ii < 256; ii++) {
+    toLinear[ii] = srgbToLinear(ii / 255.0f);
+  }
+
+  auto renderFrame = [&](int cellX, int cellY) {
+    const Vec3f dir = FrameDirection(cellX, cellY, frames);
+    const Vec3f reference = (fabsf(dir[1]) < 0.999f) ? Vec3f(0, 1, 0) : Vec3f(0, 0, -1);
+    const Vec3f right = Vec3f::CrossProduct(reference, dir).Normalized();
+    const Vec3f up = Vec3f::CrossProduct(dir, right);
+
+    // pixel column, pixel row, and depth from 0 (far) to 1 (near)
+    const float scale = frameSize / (2.0f * radius);
+    std::vector<Vec3f> projected(vertices.size());
+    for (size_t ii = 0; ii < vertices.size(); ii++) {
+      const Vec3f offset = vertices[ii].position - center;
+      projected[ii] = Vec3f(
+          (Vec3f::DotProduct(offset, right) + radius) * scale,
+          (radius - Vec3f::DotProduct(offset, up)) * scale,
+          Vec3f::DotProduct(offset, dir) / (2.0f * radius) + 0.5f);
+    }
+
+    const size_t pixelCount = (size_t)frameSize * frameSize;
+    std::vector<float> depth(pixelCount, -FLT_MAX);
+    std::vector<uint8_t> color(pixelCount * 4, 0), normal(pixelCount * 4, 0);
+    for (const Triangle& triangle : triangles) {
+      const Vec3f& a = projected[triangle.verts[0]];
+      const Vec3f& b = projected[triangle.verts[1]];
+      const Vec3f& c = projected[triangle.verts[2]];
+      const float area = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+      if (area == 0.0f) {
+        continue;
+      }
+      const int x0 = std::max(0, (int)floorf(std::min(a[0], std::min(b[0], c[0]))));
+      const int x1 = std::min(frameSize - 1, (int)floorf(std::max(a[0], std::max(b[0], c[0]))));
+      const int y0 = std::max(0, (int)floorf(std::min(a[1], std::min(b[1], c[1]))));
+      const int y1 = std::min(frameSize - 1, (int)floorf(std::max(a[1], std::max(b[1], c[1]))));
+      if (x0 > x1 || y0 > y1) {
+        continue;
+      }
+
+      const Vertex& va = vertices[triangle.verts[0]];
+      const Vertex& vb = vertices[triangle.verts[1]];
+      const Vertex& vc = vertices[triangle.verts[2]];
+      const Material* material =
+          (triangle.material >= 0 && triangle.material < (int)materials.size())
+          ? &materials[triangle.material]
+          : nullptr;
+      const Vec3f faceNormal =
+          Vec3f::CrossProduct(vb.position - va.position, vc.position - va.position);
+
+      for (int yy = y0; yy <= y1; yy++) {
+        for (int xx = x0; xx <= x1; xx++) {
+          const float px = xx + 0.5f, py = yy + 0.5f;
+          const float wa = ((b[0] - px) * (c[1] - py) - (c[0] - px) * (b[1] - py)) / area;
+          const float wb = ((c[0] - px) * (a[1] - py) - (a[0] - px) * (c[1] - py)) / area;
+          const float wc = 1.0f - wa - wb;
+          if (wa < 0.0f || wb < 0.0f || wc < 0.0f) {
+            continue;
+          }
+          const size_t pixel = (size_t)yy * frameSize + xx;
+          const float z = wa * a[2] + wb * b[2] + wc * c[2];
+          if (z <= depth[pixel]) {
+            continue;
+          }
+
+          Vec4f rgba = va.color * wa + vb.color * wb + vc.color * wc;
+          if (material != nullptr) {
+            rgba = rgba * material->color;
+            if (material->texels != nullptr) {
+              const Vec2f uv = va.uv * wa + vb.uv * wb + vc.uv * wc;
+              rgba = rgba * sampleTexture(*material, toLinear, uv);
+            }
+            if (!material->cutout) {
+              rgba[3] = 1.0f;
+            } else if (rgba[3] < 0.5f) {
+              continue;
+            }
+          }
+
+          Vec3f n = va.normal * wa + vb.normal * wb + vc.normal * wc;
+          if (n.LengthSquared() < 1e-12f) {
+            n = faceNormal;
+          }
+          n = n.Normalized();
+          if (Vec3f::DotProduct(n, dir) < 0.0f) {
+            n = -n; // a back face, showing through a hole or on a double-sided card
+          }
+
+          depth[pixel] = z;
+          for (int cc = 0; cc < 3; cc++) {
+            color[4 * pixel + cc] = toByte(linearToSrgb(std::min(1.0f, rgba[cc])));
+            normal[4 * pixel + cc] = toByte(n[cc] * 0.5f + 0.5f);
+          }
+          color[4 * pixel + 3] = 255;
+          normal[4 * pixel + 3] = toByte(z);
+        }
+      }
+    }
+
+    // grow the covered pixels out over the empty ones, a ring at a time, leaving alpha at zero
+    std::vector<uint8_t> filled(pixelCount), grown;
+    for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+      filled[pixel] = (color[4 * pixel + 3] != 0) ? 1 : 0;
+    }
+    bool changed = std::find(filled.begin(), filled.end(), 1) != filled.end();
+    while (changed) {
+      changed = false;
+      grown = filled;
+      for (int yy = 0; yy < frameSize; yy++) {
+        for (int xx = 0; xx < frameSize; xx++) {
+          const size_t pixel = (size_t)yy * frameSize + xx;
+          if (filled[pixel] != 0) {
+            continue;
+          }
+          int sum[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+          int count = 0;
+          const int neighbours[4][2] = {{xx - 1, yy}, {xx + 1, yy}, {xx, yy - 1}, {xx, yy + 1}};
+          for (const auto& neighbour : neighbours) {
+            if (neighbour[0] < 0 || neighbour[0] >= frameSize || neighbour[1] < 0 ||
+                neighbour[1] >= frameSize) {
+              continue;
+            }
+            const size_t other = (size_t)neighbour[1] * frameSize + neighbour[0];
+            if (filled[other] == 0) {
+              continue;
+            }
+            for (int cc = 0; cc < 4; cc++) {
+              sum[cc] += color[4 * other + cc];
+              sum[4 + cc] += normal[4 * other + cc];
+            }
+            count++;
+          }
+          if (count == 0) {
+            continue;
+          }
+          for (int cc = 0; cc < 3; cc++) {
+            color[4 * pixel + cc] = (uint8_t)((sum[cc] + count / 2) / count);
+          }
+          for (int cc = 0; cc < 4; cc++) {
+            normal[4 * pixel + cc] = (uint8_t)((sum[4 + cc] + count / 2) / count);
+          }
+          grown[pixel] = 1;
+          changed = true;
+        }
+      }
+      filled.swap(grown);
+    }
+
+    for (int yy = 0; yy < frameSize; yy++) {
+      const size_t row = ((size_t)(cellY * frameSize + yy) * atlasSize + cellX * frameSize) * 4;
+      std::copy_n(&color[(size_t)yy * frameSize * 4], frameSize * 4, &albedo[row]);
+      std::copy_n(&normal[(size_t)yy * frameSize * 4], frameSize * 4, &normalDepth[row]);
+    }
+  };
+
+  // every view writes only its own cell, so they can go in any order
+  ParallelUtils::ParallelFor((size_t)frames * frames, [&](size_t cell) {
+    renderFrame((int)cell % frames, (int)cell / frames);
+  });
+}
+
+} // namespace ImpostorAtlas
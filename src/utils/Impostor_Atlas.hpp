@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mathfu.hpp"
+
+namespace ImpostorAtlas {
+
+struct Vertex {
+  Vec3f position;
+  Vec3f normal; // zero to use the triangle's own
+  Vec2f uv;
+  Vec4f color; // linear, multiplies the material's
+};
+
+struct Triangle {
+  uint32_t verts[3];
+  int material;
+};
+
+struct Material {
+  Vec4f color; // linear, multiplies the texture
+  bool cutout; // whether texels with alpha under one half are holes; otherwise alpha is ignored
+  int width{0};
+  int height{0};
+  const uint8_t* texels{nullptr}; // sRGB RGBA, not owned; null if untextured
+};
+
+/**
+ * The direction, from the centre of the object towards the camera, of the view in cell (x, y) of a
+ * frames x frames octahedral atlas; rows run downwards. The cell centres are decoded as points on
+ * the octahedron |x| + |y| + |z| = 1 unfolded over the square: +Y (looking straight down onto the
+ * object) is in the middle, -Y in the corners, and columns and rows run along +X and +Z.
+ */
+Vec3f FrameDirection(int x, int y, int frames);
+
+/**
+ * Render the triangles orthographically, into the sphere around 'center' of the given radius, from
+ * every direction of a frames x frames octahedral atlas of frameSize pixel square cells. Each view
+ * has -direction as its forward and, as its up, world +Y projected onto the view plane (or -Z when
+ * looking along Y), so its right is cross(up, direction).
+ *
+ * 'albedo' gets sRGB colour with coverage in alpha; 'normalDepth' gets the object-space normal of
+ * the surface facing the camera in RGB (as n * 0.5 + 0.5) and its depth in alpha, from 0 at the far
+ * side of the sphere to 1 at the near side. Empty pixels are filled from their neighbours within
+ * their cell, so filtering doesn't pull in black. Views are rendered in parallel, but the result
+ * doesn't depend on the thread count.
+ */
+void Bake(
+    const std::vector<Vertex>& vertices,
+    const std::vector<Triangle>& triangles,
+    const std::vector<Material>& materials,
+    const Vec3f& center,
+    float radius,
+    int frames,
+    int frameSize,
+    std::vector<uint8_t>& albedo,
+    std::vector<uint8_t>& normalDepth);
+
+} // namespace ImpostorAtlas
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace ParallelUtils {
+
+// The number of threads ParallelFor() runs 'count' items on: one per core, but never more than
+// there are items, nor fewer than one.
+inline size_t GetWorkerCount(size_t count) {
+  const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  return std::max((size_t)1, std::min(count, cores));
+}
+
+// Calls fn(index, worker) for every index below count, handing the indices out in order to
+// GetWorkerCount(count) threads as they come free; 'worker' numbers the thread that makes the call,
+// for scratch space or totals of its own. Returns once every call has, rethrowing the first
+// exception any of them threw.
+template <typename Fn>
+void ParallelForWorkers(size_t count, Fn fn) {
+  const size_t workerCount = GetWorkerCount(count);
+  if (workerCount == 1) {
+    for (size_t ii = 0; ii < count; ii++) {
+      fn(ii, (size_t)0);
+    }
+    return;
+  }
+  std::atomic<size_t> next(0);
+  std::vector<std::future<void>> workers;
+  for (size_t worker = 0; worker < workerCount; worker++) {
+    workers.push_back(std::async(std::launch::async, [&next, &fn, count, worker]() {
+      for (size_t ii = next++; ii < count; ii = next++) {
+        fn(ii, worker);
+      }
+    }));
+  }
+  for (auto& future : workers) {
+    future.get();
+  }
+}
+
+// As ParallelForWorkers(), for calls that don't care which thread they're on: fn(index).
+template <typename Fn>
+void ParallelFor(size_t count, Fn fn) {
+  ParallelForWorkers(count, [&fn](size_t ii, size_t) { fn(ii); });
+}
+
+} // namespace ParallelUtils
@@ -0,0 +1,366 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Png_Optimizer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include <stb_image.h>
+#include <zlib.h>
+
+#include "Parallel_Utils.hpp"
+
+namespace PngOptimizer {
+
+static const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+enum PngColorType {
+  COLOR_GRAY = 0,
+  COLOR_RGB = 2,
+  COLOR_PALETTE = 3,
+  COLOR_GRAY_ALPHA = 4,
+  COLOR_RGBA = 6,
+};
+
+// the five filters of the PNG spec, plus a per-row heuristic choice between them
+static const int FILTER_ADAPTIVE = 5;
+static const int FILTER_STRATEGY_COUNT = 6;
+
+/** One candidate encoding: unfiltered scanlines plus whatever header data it needs. */
+struct Candidate {
+  int colorType;
+  int bitDepth;
+  size_t rowBytes;
+  int bytesPerPixel; // for filtering; at least 1, even for sub-byte depths
+  std::vector<uint8_t> rows;
+  std::vector<uint8_t> palette; // RGB triplets
+  std::vector<uint8_t> alphas; // tRNS entries for the palette
+};
+
+static inline uint8_t paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return (uint8_t)a;
+  }
+  return (uint8_t)(pb <= pc ? b : c);
+}
+
+static void filterRow(
+    int filter,
+    const uint8_t* row,
+    const uint8_t* prior,
+    size_t rowBytes,
+    int bpp,
+    uint8_t* out) {
+  for (size_t ii = 0; ii < rowBytes; ii++) {
+    const int a = (ii >= (size_t)bpp) ? row[ii - bpp] : 0;
+    const int b = (prior != nullptr) ? prior[ii] : 0;
+    const int c = (prior != nullptr && ii >= (size_t)bpp) ? prior[ii - bpp] : 0;
+    switch (filter) {
+      case 0:
+        out[ii] = row[ii];
+        break;
+      case 1:
+        out[ii] = (uint8_t)(row[ii] - a);
+        break;
+      case 2:
+        out[ii] = (uint8_t)(row[ii] - b);
+        break;
+      case 3:
+        out[ii] = (uint8_t)(row[ii] - ((a + b) >> 1));
+        break;
+      default:
+        out[ii] = (uint8_t)(row[ii] - paeth(a, b, c));
+        break;
+    }
+  }
+}
+
+/** Filter every scanline with the given strategy and deflate the lot into IDAT payload. */
+static std::vector<uint8_t> compressCandidate(const Candidate& cand, size_t height, int strategy) {
+  const size_t stride = cand.rowBytes + 1;
+  std::vector<uint8_t> filtered(stride * height);
+  std::vector<uint8_t> trial(cand.rowBytes);
+  for (size_t yy = 0; yy < height; yy++) {
+    const uint8_t* row = &cand.rows[yy * cand.rowBytes];
+    const uint8_t* prior = (yy > 0) ? row - cand.rowBytes : nullptr;
+    uint8_t* out = &filtered[yy * stride];
+    int filter = strategy;
+    if (strategy == FILTER_ADAPTIVE) {
+      // the usual minimum-sum-of-absolute-differences heuristic
+      uint64_t bestSum = UINT64_MAX;
+      for (int ff = 0; ff < 5; ff++) {
+        filterRow(ff, row, prior, cand.rowBytes, cand.bytesPerPixel, trial.data());
+        uint64_t sum = 0;
+        for (uint8_t v : trial) {
+          sum += (v < 128) ? v : 256 - v;
+        }
+        if (sum < bestSum) {
+          bestSum = sum;
+          filter = ff;
+        }
+      }
+    }
+    out[0] = (uint8_t)filter;
+    filterRow(filter, row, prior, cand.rowBytes, cand.bytesPerPixel, out + 1);
+  }
+
+  uLongf compressedSize = compressBound((uLong)filtered.size());
+  std::vector<uint8_t> compressed(compressedSize);
+  if (compress2(compressed.data(), &compressedSize, filtered.data(), (uLong)filtered.size(), 9) !=
+      Z_OK) {
+    return std::vector<uint8_t>();
+  }
+  compressed.resize(compressedSize);
+  return compressed;
+}
+
+static void writeUint32(std::vector<uint8_t>& out, uint32_t value) {
+  out.push_back((uint8_t)(value >> 24));
+  out.push_back((uint8_t)(value >> 16));
+  out.push_back((uint8_t)(value >> 8));
+  out.push_back((uint8_t)value);
+}
+
+static void
+writeChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+  writeUint32(out, (uint32_t)data.size());
+  const size_t typeStart = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  const uLong crc = crc32(0L, &out[typeStart], (uInt)(out.size() - typeStart));
+  writeUint32(out, (uint32_t)crc);
+}
+
+static std::vector<uint8_t> encodePng(
+    const Candidate& cand,
+    uint32_t width,
+    uint32_t height,
+    const std::vector<uint8_t>& idat) {
+  std::vector<uint8_t> png(PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+
+  std::vector<uint8_t> header;
+  writeUint32(header, width);
+  writeUint32(header, height);
+  header.push_back((uint8_t)cand.bitDepth);
+  header.push_back((uint8_t)cand.colorType);
+  header.push_back(0); // deflate
+  header.push_back(0); // adaptive filtering
+  header.push_back(0); // no interlace
+  writeChunk(png, "IHDR", header);
+
+  if (cand.colorType == COLOR_PALETTE) {
+    writeChunk(png, "PLTE", cand.palette);
+    if (!cand.alphas.empty()) {
+      writeChunk(png, "tRNS", cand.alphas);
+    }
+  }
+  writeChunk(png, "IDAT", idat);
+  writeChunk(png, "IEND", std::vector<uint8_t>());
+  return png;
+}
+
+/** Build the palette candidate, if the image has few enough distinct colours. */
+static bool buildPaletteCandidate(
+    const std::vector<uint16_t>& samples,
+    int channels,
+    size_t width,
+    size_t height,
+    Candidate& cand) {
+  const size_t pixelCount = width * height;
+  std::map<uint32_t, int> colorCounts;
+  std::vector<uint32_t> packed(pixelCount);
+  for (size_t ii = 0; ii < pixelCount; ii++) {
+    const uint16_t* p = &samples[ii * channels];
+    uint32_t r, g, b, a = 255;
+    if (channels < 3) {
+      r = g = b = p[0];
+      if (channels == 2) {
+        a = p[1];
+      }
+    } else {
+      r = p[0];
+      g = p[1];
+      b = p[2];
+      if (channels == 4) {
+        a = p[3];
+      }
+    }
+    packed[ii] = (r << 24) | (g << 16) | (b << 8) | a;
+    if (++colorCounts[packed[ii]] == 1 && colorCounts.size() > 256) {
+      return false;
+    }
+  }
+
+  // translucent entries first, so the tRNS chunk can stop at the last of them
+  std::vector<uint32_t> colors;
+  for (const auto& entry : colorCounts) {
+    colors.push_back(entry.first);
+  }
+  std::stable_sort(colors.begin(), colors.end(), [](uint32_t x, uint32_t y) {
+    return ((x & 0xFF) != 0xFF) > ((y & 0xFF) != 0xFF);
+  });
+
+  std::map<uint32_t, uint8_t> indexOf;
+  for (size_t ii = 0; ii < colors.size(); ii++) {
+    const uint32_t c = colors[ii];
+    indexOf[c] = (uint8_t)ii;
+    cand.palette.push_back((uint8_t)(c >> 24));
+    cand.palette.push_back((uint8_t)(c >> 16));
+    cand.palette.push_back((uint8_t)(c >> 8));
+    if ((c & 0xFF) != 0xFF) {
+      cand.alphas.push_back((uint8_t)c);
+    }
+  }
+
+  const size_t count = colors.size();
+  cand.colorType = COLOR_PALETTE;
+  cand.bitDepth = (count <= 2) ? 1 : (count <= 4) ? 2 : (count <= 16) ? 4 : 8;
+  cand.bytesPerPixel = 1;
+  cand.rowBytes = (width * cand.bitDepth + 7) / 8;
+  cand.rows.assign(cand.rowBytes * height, 0);
+  const int perByte = 8 / cand.bitDepth;
+  for (size_t yy = 0; yy < height; yy++) {
+    uint8_t* row = &cand.rows[yy * cand.rowBytes];
+    for (size_t xx = 0; xx < width; xx++) {
+      const uint8_t index = indexOf[packed[yy * width + xx]];
+      const int shift = 8 - cand.bitDepth * (1 + (int)(xx % perByte));
+      row[xx / perByte] |= (uint8_t)(index << shift);
+    }
+  }
+  return true;
+}
+
+bool Optimize(const std::vector<uint8_t>& png, std::vector<uint8_t>& optimized) {
+  if (png.size() < sizeof(PNG_SIGNATURE) ||
+      memcmp(png.data(), PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0) {
+    return false;
+  }
+
+  // decode to samples at the file's own depth, so that nothing is lost up front
+  int width, height, channels;
+  std::vector<uint16_t> samples;
+  int bitDepth = 8;
+  if (stbi_is_16_bit_from_memory(png.data(), (int)png.size())) {
+    stbi_us* pixels =
+        stbi_load_16_from_memory(png.data(), (int)png.size(), &width, &height, &channels, 0);
+    if (pixels == nullptr) {
+      return false;
+    }
+    samples.assign(pixels, pixels + (size_t)width * height * channels);
+    stbi_image_free(pixels);
+    bitDepth = 16;
+  } else {
+    stbi_uc* pixels =
+        stbi_load_from_memory(png.data(), (int)png.size(), &width, &height, &channels, 0);
+    if (pixels == nullptr) {
+      return false;
+    }
+    samples.assign(pixels, pixels + (size_t)width * height * channels);
+    stbi_image_free(pixels);
+  }
+  const size_t pixelCount = (size_t)width * height;
+
+  // 16-bit exports of 8-bit art store each value twice over
+  if (bitDepth == 16 && std::all_of(samples.begin(), samples.end(), [](uint16_t v) {
+        return (v >> 8) == (v & 0xFF);
+      })) {
+    for (uint16_t& v : samples) {
+      v >>= 8;
+    }
+    bitDepth = 8;
+  }
+  const uint16_t maxValue = (bitDepth == 16) ? 0xFFFF : 0xFF;
+
+  const bool hasColor = channels >= 3;
+  const bool hasAlpha = channels == 2 || channels == 4;
+  bool isGray = true;
+  bool usesAlpha = false;
+  for (size_t ii = 0; ii < pixelCount; ii++) {
+    const uint16_t* p = &samples[ii * channels];
+    if (hasColor && (p[0] != p[1] || p[1] != p[2])) {
+      isGray = false;
+    }
+    if (hasAlpha && p[channels - 1] != maxValue) {
+      usesAlpha = true;
+    }
+  }
+
+  std::vector<Candidate> candidates;
+
+  // the minimal truecolour or greyscale form
+  Candidate direct;
+  const int outChannels = (isGray ? 1 : 3) + (usesAlpha ? 1 : 0);
+  const int bytesPerSample = bitDepth / 8;
+  direct.colorType = isGray ? (usesAlpha ? COLOR_GRAY_ALPHA : COLOR_GRAY)
+                            : (usesAlpha ? COLOR_RGBA : COLOR_RGB);
+  direct.bitDepth = bitDepth;
+  direct.bytesPerPixel = outChannels * bytesPerSample;
+  direct.rowBytes = (size_t)width * direct.bytesPerPixel;
+  direct.rows.reserve(direct.rowBytes * height);
+  for (size_t ii = 0; ii < pixelCount; ii++) {
+    const uint16_t* p = &samples[ii * channels];
+    uint16_t out[4];
+    int kk = 0;
+    out[kk++] = p[0];
+    if (!isGray) {
+      out[kk++] = p[1];
+      out[kk++] = p[2];
+    }
+    if (usesAlpha) {
+      out[kk++] = p[channels - 1];
+    }
+    for (int jj = 0; jj < kk; jj++) {
+      if (bytesPerSample == 2) {
+        direct.rows.push_back((uint8_t)(out[jj] >> 8));
+      }
+      direct.rows.push_back((uint8_t)out[jj]);
+    }
+  }
+  candidates.push_back(std::move(direct));
+
+  // an indexed form, for images with few colours
+  if (bitDepth == 8) {
+    Candidate palette;
+    if (buildPaletteCandidate(samples, channels, width, height, palette)) {
+      candidates.push_back(std::move(palette));
+    }
+  }
+  samples.clear();
+  samples.shrink_to_fit();
+
+  std::vector<uint8_t> best;
+  for (const Candidate& cand : candidates) {
+    std::vector<std::vector<uint8_t>> trials(FILTER_STRATEGY_COUNT);
+    ParallelUtils::ParallelFor(trials.size(), [&](size_t strategy) {
+      trials[strategy] = compressCandidate(cand, (size_t)height, (int)strategy);
+    });
+    for (const std::vector<uint8_t>& idat : trials) {
+      if (idat.empty()) {
+        continue;
+      }
+      std::vector<uint8_t> encoded = encodePng(cand, (uint32_t)width, (uint32_t)height, idat);
+      if (best.empty() || encoded.size() < best.size()) {
+        best = std::move(encoded);
+      }
+    }
+  }
+
+  if (best.empty() || best.size() >= png.size()) {
+    return false;
+  }
+  optimized = std::move(best);
+  return true;
+}
+
+} // namespace PngOptimizer
@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace PngOptimizer {
+
+/**
+ * Re-encode a PNG in the smallest lossless form we can find: 16-bit samples that only hold 8 bits
+ * of information are narrowed, colour that is really grey becomes greyscale, alpha that is opaque
+ * everywhere is dropped, and images with at most 256 colours are tried as palettes. Each candidate
+ * is compressed with every PNG filter strategy in parallel, and the smallest wins.
+ *
+ * Only pixel data survives; ancillary chunks (gamma, colour profiles, text) are discarded, which is
+ * harmless for glTF as it defines images to be sRGB anyway.
+ *
+ * Returns true and fills in 'optimized' only if the result is smaller than the original.
+ */
+bool Optimize(const std::vector<uint8_t>& png, std::vector<uint8_t>& optimized);
+
+} // namespace PngOptimizer
@@ -30,4 +30,28 @@ inline int CompareNoCase(const std::string& s1, const std::string& s2) {
   return strncasecmp(s1.c_str(), s2.c_str(), std::max(s1.length(), s2.length()));
 }
 
+// shell-style wildcards: '*' matches any run of characters, '?' any single one
+inline bool MatchGlob(const std::string& pattern, const std::string& text) {
+  size_t p = 0, t = 0, starP = std::string::npos, starT = 0;
+  while (t < text.length()) {
+    if (p < pattern.length() && (pattern[p] == '?' || pattern[p] == text[t])) {
+      p++;
+      t++;
+    } else if (p < pattern.length() && pattern[p] == '*') {
+      starP = p++;
+      starT = t;
+    } else if (starP != std::string::npos) {
+      // let the last star swallow one more character and try again
+      p = starP + 1;
+      t = ++starT;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.length() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.length();
+}
+
 } // namespace StringUtils
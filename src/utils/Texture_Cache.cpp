@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Texture_Cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include <boost/filesystem.hpp>
+
+#include "Archive_Utils.hpp"
+#include "FBX2glTF.h"
+
+// bump this whenever the processing behind any cached result changes
+static const char* const CACHE_VERSION = "1";
+static const char* const CACHE_SUFFIX = ".texcache";
+
+static std::unique_ptr<TextureCache> instance;
+
+TextureCache* TextureCache::Get() {
+  return instance.get();
+}
+
+void TextureCache::Configure(const std::string& folder, uint64_t maxBytes) {
+  instance.reset(new TextureCache(folder, maxBytes));
+}
+
+void TextureCache::Shutdown() {
+  if (instance) {
+    instance->Report();
+    instance->Evict();
+    instance.reset();
+  }
+}
+
+TextureCache::TextureCache(const std::string& folder, uint64_t maxBytes)
+    : folder(folder), maxBytes(maxBytes) {
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(folder, ec);
+}
+
+static uint64_t Mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+std::string TextureCache::HashBytes(const uint8_t* bytes, size_t length) {
+  // two independent 64-bit lanes over 8-byte words; not cryptographic, but wide enough that
+  // accidental collisions between texture files aren't a concern
+  uint64_t h1 = 0x9e3779b97f4a7c15ULL ^ length;
+  uint64_t h2 = 0x6a09e667f3bcc909ULL ^ (length * 0x100000001b3ULL);
+  size_t ii = 0;
+  for (; ii + 8 <= length; ii += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + ii, 8);
+    h1 = Mix(h1 ^ word);
+    h2 = (h2 ^ Mix(word + 0x632be59bd9b4e019ULL)) * 0x100000001b3ULL;
+  }
+  uint64_t tail = 0;
+  if (ii < length) {
+    memcpy(&tail, bytes + ii, length - ii);
+  }
+  h1 = Mix(h1 ^ tail ^ 0x80);
+  h2 = Mix(h2 ^ tail ^ h1);
+  return fmt::format("{:016x}{:016x}", h1, h2);
+}
+
+std::string TextureCache::HashFile(const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = fileHashes.find(path);
+    if (iter != fileHashes.end()) {
+      return iter->second;
+    }
+  }
+  std::vector<uint8_t> bytes;
+  const std::string hash =
+      ArchiveUtils::ReadFile(path, bytes) ? HashBytes(bytes.data(), bytes.size()) : "";
+  std::lock_guard<std::mutex> lock(mutex);
+  fileHashes[path] = hash;
+  return hash;
+}
+
+std::string TextureCache::GetEntryPath(const std::string& key) const {
+  const std::string versionedKey = std::string(CACHE_VERSION) + "|" + key;
+  return folder + "/" +
+      HashBytes((const uint8_t*)versionedKey.data(), versionedKey.size()) + CACHE_SUFFIX;
+}
+
+bool TextureCache::Load(const std::string& key, std::vector<uint8_t>& bytes) {
+  const std::string path = GetEntryPath(key);
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  bool found = false;
+  if (file) {
+    const std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    bytes.resize(size);
+    found = (size == 0 || file.read((char*)bytes.data(), size));
+  }
+  if (found) {
+    // note the use, for least-recently-used eviction
+    boost::system::error_code ec;
+    boost::filesystem::last_write_time(path, std::time(nullptr), ec);
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  (found ? hits : misses)++;
+  return found;
+}
+
+void TextureCache::Store(const std::string& key, const std::vector<uint8_t>& bytes) {
+  // write to a private name first, so a concurrent conversion never sees a partial entry
+  const std::string path = GetEntryPath(key);
+  const std::string tmpPath =
+      path + "." + boost::filesystem::unique_path("%%%%%%%%").string() + ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write((const char*)bytes.data(), bytes.size())) {
+      if (verboseOutput) {
+        fmt::printf("Warning: Couldn't write texture cache entry %s.\n", tmpPath);
+      }
+      file.close();
+      boost::system::error_code ec;
+      boost::filesystem::remove(tmpPath, ec);
+      return;
+    }
+  }
+  boost::system::error_code ec;
+  boost::filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    boost::filesystem::remove(tmpPath, ec);
+  }
+}
+
+void TextureCache::Evict() {
+  struct CacheFile {
+    std::time_t lastUse;
+    uint64_t size;
+    boost::filesystem::path path;
+  };
+  std::vector<CacheFile> files;
+  uint64_t totalBytes = 0;
+
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator iter(folder, ec), end; !ec && iter != end;
+       iter.increment(ec)) {
+    const auto& path = iter->path();
+    if (path.extension() != CACHE_SUFFIX || !boost::filesystem::is_regular_file(path, ec)) {
+      continue;
+    }
+    const uint64_t size = boost::filesystem::file_size(path, ec);
+    files.push_back({boost::filesystem::last_write_time(path, ec), size, path});
+    totalBytes += size;
+  }
+  if (totalBytes <= maxBytes) {
+    return;
+  }
+  std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) {
+    return a.lastUse < b.lastUse;
+  });
+  for (const auto& file : files) {
+    if (totalBytes <= maxBytes) {
+      break;
+    }
+    if (boost::filesystem::remove(file.path, ec)) {
+      totalBytes -= file.size;
+      evictions++;
+    }
+  }
+  if (verboseOutput) {
+    fmt::printf(
+        "Texture cache: evicted %d entries, %3.1f MB remain.\n",
+        evictions,
+        (float)totalBytes * 1e-6f);
+  }
+}
+
+void TextureCache::Report() const {
+  const int lookups = hits + misses;
+  if (lookups > 0) {
+    fmt::printf(
+        "Texture cache: %d hits, %d misses (%d%% hit rate).\n",
+        hits,
+        misses,
+        hits * 100 / lookups);
+  }
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * A persistent on-disk cache for the results of texture processing, shared between conversion
+ * runs. Entries are keyed by a description of the work done, which should include content hashes
+ * of the source images along with every parameter of the processing, so that a key never refers
+ * to two different results. When the cache grows beyond its size bound, the least recently used
+ * entries are evicted at the end of the run.
+ */
+class TextureCache {
+ public:
+  // the process-wide cache, or nullptr if none was configured
+  static TextureCache* Get();
+  static void Configure(const std::string& folder, uint64_t maxBytes);
+  // report the hit rate, evict down to the size bound, and disable the cache
+  static void Shutdown();
+
+  // a hex digest of the given bytes, for use in keys
+  static std::string HashBytes(const uint8_t* bytes, size_t length);
+  // the content hash of the file at this path (which may run through a zip bundle), or "" if it
+  // can't be read; memoised for the duration of the run
+  std::string HashFile(const std::string& path);
+
+  bool Load(const std::string& key, std::vector<uint8_t>& bytes);
+  void Store(const std::string& key, const std::vector<uint8_t>& bytes);
+
+ private:
+  TextureCache(const std::string& folder, uint64_t maxBytes);
+
+  std::string GetEntryPath(const std::string& key) const;
+  void Evict();
+  void Report() const;
+
+  const std::string folder;
+  const uint64_t maxBytes;
+
+  std::mutex mutex;
+  std::map<std::string, std::string> fileHashes;
+  int hits{0};
+  int misses{0};
+  int evictions{0};
+};
@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Triangle_Bvh.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+static const int MAX_LEAF_TRIANGLES = 4;
+
+TriangleBvh::TriangleBvh(const std::vector<Triangle>& triangles) : triangles(triangles) {
+  if (triangles.empty()) {
+    return;
+  }
+  std::vector<Vec3f> centroids(triangles.size());
+  order.resize(triangles.size());
+  for (size_t ii = 0; ii < triangles.size(); ii++) {
+    centroids[ii] = (triangles[ii][0] + triangles[ii][1] + triangles[ii][2]) / 3.0f;
+    order[ii] = (int)ii;
+  }
+  nodes.reserve(2 * triangles.size() / MAX_LEAF_TRIANGLES + 1);
+  build(0, (int)triangles.size(), centroids);
+}
+
+int TriangleBvh::build(int start, int end, const std::vector<Vec3f>& centroids) {
+  const int nodeIx = (int)nodes.size();
+  nodes.push_back(Node());
+
+  Vec3f min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  Vec3f centroidMin = min, centroidMax = max;
+  for (int ii = start; ii < end; ii++) {
+    for (const Vec3f& p : triangles[order[ii]]) {
+      min = Vec3f::Min(min, p);
+      max = Vec3f::Max(max, p);
+    }
+    centroidMin = Vec3f::Min(centroidMin, centroids[order[ii]]);
+    centroidMax = Vec3f::Max(centroidMax, centroids[order[ii]]);
+  }
+  nodes[nodeIx].min = min;
+  nodes[nodeIx].max = max;
+
+  if (end - start <= MAX_LEAF_TRIANGLES) {
+    nodes[nodeIx].start = start;
+    nodes[nodeIx].count = end - start;
+    nodes[nodeIx].right = -1;
+    return nodeIx;
+  }
+
+  const Vec3f extent = centroidMax - centroidMin;
+  int axis = 2;
+  if (extent[0] >= extent[1] && extent[0] >= extent[2]) {
+    axis = 0;
+  } else if (extent[1] >= extent[2]) {
+    axis = 1;
+  }
+  const int middle = (start + end) / 2;
+  // ties broken by index, so the tree doesn't depend on the sort implementation
+  std::nth_element(
+      order.begin() + start, order.begin() + middle, order.begin() + end, [&](int a, int b) {
+        return centroids[a][axis] < centroids[b][axis] ||
+            (centroids[a][axis] == centroids[b][axis] && a < b);
+      });
+
+  nodes[nodeIx].start = start;
+  nodes[nodeIx].count = 0;
+  build(start, middle, centroids);
+  const int right = build(middle, end, centroids);
+  nodes[nodeIx].right = right;
+  return nodeIx;
+}
+
+static bool rayHitsBox(
+    const Vec3f& origin,
+    const Vec3f& invDir,
+    float tMax,
+    const Vec3f& min,
+    const Vec3f& max) {
+  float t0 = 0.0f, t1 = tMax;
+  for (int axis = 0; axis < 3; axis++) {
+    float tNear = (min[axis] - origin[axis]) * invDir[axis];
+    float tFar = (max[axis] - origin[axis]) * invDir[axis];
+    if (tNear > tFar) {
+      std::swap(tNear, tFar);
+    }
+    t0 = std::max(t0, tNear);
+    t1 = std::min(t1, tFar);
+    if (t0 > t1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Möller–Trumbore, counting hits from either side
+static bool rayHitsTriangle(
+    const Vec3f& origin,
+    const Vec3f& dir,
+    float tMax,
+    const TriangleBvh::Triangle& triangle) {
+  const Vec3f e1 = triangle[1] - triangle[0];
+  const Vec3f e2 = triangle[2] - triangle[0];
+  const Vec3f p = Vec3f::CrossProduct(dir, e2);
+  const float det = Vec3f::DotProduct(e1, p);
+  if (fabsf(det) < 1e-12f) {
+    return false;
+  }
+  const float invDet = 1.0f / det;
+  const Vec3f s = origin - triangle[0];
+  const float u = Vec3f::DotProduct(s, p) * invDet;
+  if (u < 0.0f || u > 1.0f) {
+    return false;
+  }
+  const Vec3f q = Vec3f::CrossProduct(s, e1);
+  const float v = Vec3f::DotProduct(dir, q) * invDet;
+  if (v < 0.0f || u + v > 1.0f) {
+    return false;
+  }
+  const float t = Vec3f::DotProduct(e2, q) * invDet;
+  return t > 0.0f && t < tMax;
+}
+
+bool TriangleBvh::IsOccluded(const Vec3f& origin, const Vec3f& dir, float tMax, int ignore) const {
+  if (nodes.empty()) {
+    return false;
+  }
+  const Vec3f invDir(
+      (dir[0] != 0.0f) ? 1.0f / dir[0] : FLT_MAX,
+      (dir[1] != 0.0f) ? 1.0f / dir[1] : FLT_MAX,
+      (dir[2] != 0.0f) ? 1.0f / dir[2] : FLT_MAX);
+
+  int stack[64];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    const int nodeIx = stack[--stackSize];
+    const Node& node = nodes[nodeIx];
+    if (!rayHitsBox(origin, invDir, tMax, node.min, node.max)) {
+      continue;
+    }
+    if (node.count > 0) {
+      for (int ii = node.start; ii < node.start + node.count; ii++) {
+        if (order[ii] != ignore && rayHitsTriangle(origin, dir, tMax, triangles[order[ii]])) {
+          return true;
+        }
+      }
+    } else {
+      // median splits keep the depth near log2(n), far below the stack size
+      stack[stackSize++] = node.right;
+      stack[stackSize++] = nodeIx + 1;
+    }
+  }
+  return false;
+}
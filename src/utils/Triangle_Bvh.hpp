@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "mathfu.hpp"
+
+/**
+ * A bounding volume hierarchy over a fixed set of triangles, for occlusion queries. It's built
+ * once, by median splits along the longest axis, and is read-only (and so thread-safe) after.
+ */
+class TriangleBvh {
+ public:
+  using Triangle = std::array<Vec3f, 3>;
+
+  explicit TriangleBvh(const std::vector<Triangle>& triangles);
+
+  /**
+   * Whether any triangle other than the one at index 'ignore' crosses the ray from 'origin' in the
+   * (normalised) direction 'dir', closer than 'tMax'.
+   */
+  bool IsOccluded(const Vec3f& origin, const Vec3f& dir, float tMax, int ignore = -1) const;
+
+  size_t GetTriangleCount() const {
+    return triangles.size();
+  }
+
+ private:
+  struct Node {
+    Vec3f min;
+    Vec3f max;
+    int start; // first entry in 'order', for leaves
+    int count; // zero for interior nodes, whose left child follows them directly
+    int right; // index of the right child, for interior nodes
+  };
+
+  int build(int start, int end, const std::vector<Vec3f>& centroids);
+
+  std::vector<Triangle> triangles;
+  std::vector<int> order;
+  std::vector<Node> nodes;
+};